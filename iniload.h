@@ -5,6 +5,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(_WIN32) || defined(__unix__) || defined(__APPLE__)
+#define INILOAD_HAS_FD
+#endif
+
+/* Atomic operations, without which ini_live is not available */
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define INILOAD_HAS_ATOMICS
+#endif
+
 #ifndef INILOAD_NAME_MAXLEN
 #define INILOAD_NAME_MAXLEN 128
 #endif
@@ -13,8 +22,138 @@
 #define INILOAD_INITIAL_CAP 8
 #endif
 
-/* Forward declaration */
+#ifndef INILOAD_ARENA_BLOCK_SIZE
+#define INILOAD_ARENA_BLOCK_SIZE 65536
+#endif
+
+#ifndef INILOAD_THREADS
+#define INILOAD_THREADS 4
+#endif
+
+#ifndef INILOAD_PARALLEL_MIN_CHUNK
+#define INILOAD_PARALLEL_MIN_CHUNK (1 << 20)
+#endif
+
+#ifndef INILOAD_WRITE_BUFFER_SIZE
+#define INILOAD_WRITE_BUFFER_SIZE (1 << 20)
+#endif
+
+/* Forward declarations */
 typedef struct ini_file ini_file;
+typedef struct ini_key *ini_key_handle;
+typedef struct ini_live ini_live;
+typedef struct ini_parser ini_parser;
+typedef struct ini_shared ini_shared;
+typedef struct ini_stack ini_stack;
+typedef struct ini_async ini_async;
+
+/**
+ * @brief Flags changing how ini_load_ex() loads an INI file.
+ */
+typedef enum ini_load_flags {
+  INI_LOAD_ARENA = 1,    /**< Allocate the whole parsed file from one arena */
+  INI_LOAD_ZERO_COPY = 2, /**< Keep the file's text and point into it */
+  INI_LOAD_MMAP = 4,      /**< Parse a memory mapping of the file */
+  INI_LOAD_PARALLEL = 8,  /**< Parse large files on several threads */
+  INI_LOAD_LAZY = 16      /**< Convert values when they are first read */
+} ini_load_flags;
+
+/**
+ * @brief Options for ini_load_ex(). Unused fields must be zero.
+ */
+typedef struct ini_options {
+  unsigned int flags; /**< Combination of ini_load_flags */
+  void *arena_buf;    /**< Memory to use as the arena or NULL to allocate it */
+  size_t arena_size;  /**< Size of arena_buf in bytes */
+  unsigned int num_threads; /**< Threads for INI_LOAD_PARALLEL, 0 for
+                                 INILOAD_THREADS */
+  size_t num_sections_hint; /**< Expected number of sections, 0 to count
+                                 them before parsing */
+  size_t num_keys_hint;     /**< Expected number of keys in all sections, 0
+                                 to count them before parsing */
+} ini_options;
+
+/**
+ * @brief Signed 64-bit integer of the values read by ini_get_int64().
+ */
+#if defined(_MSC_VER)
+typedef __int64 ini_int64;
+typedef unsigned __int64 ini_uint64;
+#elif defined(__GNUC__)
+__extension__ typedef long long ini_int64;
+__extension__ typedef unsigned long long ini_uint64;
+#else
+typedef long long ini_int64;
+typedef unsigned long long ini_uint64;
+#endif
+
+/**
+ * @brief Supported INI key types.
+ *
+ * Every number is kept at full width. Integers that fit into an int and
+ * floating point numbers in the range of a float get the narrow types, which
+ * the wide getters read as well.
+ */
+typedef enum ini_key_type {
+  INI_KEY_INT,    /**< Signed integer key */
+  INI_KEY_FLOAT,  /**< Single-precision floating point number key */
+  INI_KEY_STRING, /**< String key */
+  INI_KEY_INT64,  /**< Integer key that does not fit into an int */
+  INI_KEY_DOUBLE, /**< Finite floating point number key that overflows a
+                       float */
+  INI_KEY_LAZY    /**< Used internally for values not converted yet */
+} ini_key_type;
+
+/**
+ * @brief A key to retrieve with ini_get_batch().
+ */
+typedef struct ini_batch_key {
+  const char *section_name; /**< Name of the section, NULL for the section of
+                                 the previous key */
+  const char *key_name;     /**< Name of the key */
+  ini_key_type type; /**< INI_KEY_INT, INI_KEY_FLOAT, INI_KEY_STRING,
+                          INI_KEY_INT64 or INI_KEY_DOUBLE */
+  void *out; /**< int, float, char *, ini_int64 or double holding the default
+                  value, receives the key's value */
+} ini_batch_key;
+
+/**
+ * @brief Counters of the work done to load and read an INI file.
+ *
+ * The time, allocation and lookup counters are only kept if
+ * INILOAD_ENABLE_STATS is defined with the implementation, otherwise they
+ * stay zero.
+ */
+typedef struct ini_stats {
+  size_t bytes_read;    /**< Bytes of text read, mapped or parsed */
+  double read_seconds;  /**< Time spent reading the text */
+  double parse_seconds; /**< Time spent parsing the text */
+  size_t num_allocs;    /**< Allocations from the heap or the arena */
+  size_t alloc_bytes;   /**< Bytes requested by these allocations */
+  size_t num_grows;     /**< Allocations that enlarged an array */
+  size_t num_sections;  /**< Number of sections */
+  size_t num_keys;      /**< Number of keys in all sections */
+  size_t get_int_calls;   /**< Calls of ini_get_int() and ini_get_int64() */
+  size_t get_int_misses;  /**< Of which were on a missing key */
+  size_t get_float_calls; /**< Calls of ini_get_float() and
+                               ini_get_double() */
+  size_t get_float_misses; /**< Of which were on a missing key */
+  size_t get_string_calls; /**< Calls of ini_get_string() */
+  size_t get_string_misses; /**< Calls of ini_get_string() on a missing
+                                 key */
+  size_t lookup_calls;  /**< Keys looked up by ini_lookup(),
+                             ini_lookup_hash() and ini_get_batch() */
+  size_t lookup_misses; /**< Of which were missing */
+} ini_stats;
+
+/**
+ * @brief A key and the number of times it was looked up by name.
+ */
+typedef struct ini_key_stats {
+  const char *section_name; /**< Name of the section */
+  const char *key_name;     /**< Name of the key */
+  size_t lookups;           /**< Number of lookups */
+} ini_key_stats;
 
 /* Functions */
 #ifdef __cplusplus
@@ -30,9 +169,235 @@ extern "C" {
  * there was an error parsing or dynamically allocating the memory.
  * @note Keys without a section are assigned to a section with an empty name
  * ("\0").
+ * @note A section header that appears again adds its keys to the section of
+ * the same name, and a key that is set twice in a section keeps the place of
+ * the first and the value of the last.
  */
 ini_file *ini_load(const char *path);
 
+/**
+ * @brief Parses an INI file like ini_load(), with additional options.
+ *
+ * @param path Path to the INI file
+ * @param options Pointer to the load options or NULL for the defaults.
+ * @return Pointer to an ini_file struct containing the parsed data or NULL if
+ * there was an error parsing or dynamically allocating the memory.
+ * @note With INI_LOAD_ARENA, the sections, keys and strings are all placed in
+ * one arena which ini_free() releases at once. The arena grows by blocks of at
+ * least INILOAD_ARENA_BLOCK_SIZE bytes, unless arena_buf is set: the parsed
+ * file then lives entirely in that buffer, loading fails if it is too small,
+ * and the buffer must stay valid until ini_free() is called.
+ * @note With INI_LOAD_ZERO_COPY, the text of the file is kept in memory until
+ * ini_free() and names and string values are NUL-terminated in place instead
+ * of being copied, ini_get_string() then returns pointers into that text.
+ * @note With INI_LOAD_MMAP, a regular file is memory-mapped and parsed in
+ * place instead of being read into a buffer first, which halves the peak
+ * memory usage for large files. Only the names and values are copied and the
+ * mapping is removed before returning, so INI_LOAD_ZERO_COPY has no effect.
+ * Files that can not be mapped are read as usual.
+ * @note With INI_LOAD_PARALLEL, the text is split before section headers
+ * that start a line into chunks of at least INILOAD_PARALLEL_MIN_CHUNK bytes,
+ * which are parsed on up to num_threads threads and then joined in file order.
+ * This requires INILOAD_ENABLE_THREADS to be defined where the implementation
+ * is compiled, otherwise, and together with INI_LOAD_ARENA, the file is parsed
+ * on the calling thread.
+ * @note Before parsing, the section headers and the lines with a key after
+ * each are counted so that the arrays holding the sections and keys and the
+ * hash indexes are allocated at their final size. Setting num_sections_hint
+ * or num_keys_hint skips the counting and uses the hints instead, the keys
+ * of each section are then expected to be equally many.
+ * @note With INI_LOAD_LAZY, unquoted values are stored as text and are only
+ * converted to an integer, a float or a string by the first ini_get_int(),
+ * ini_get_float() or ini_get_string() call on their key, which caches the
+ * result. The getters then modify the key, so the loaded file must not be
+ * read from several threads at once without a lock.
+ */
+ini_file *ini_load_ex(const char *path, const ini_options *options);
+
+/**
+ * @brief Parses INI data held in memory.
+ *
+ * @param data Pointer to the INI data, it does not have to be NUL-terminated.
+ * @param len Length of the data in bytes.
+ * @return Pointer to an ini_file struct containing the parsed data or NULL if
+ * there was an error parsing or dynamically allocating the memory.
+ * @note The data is parsed where it is, without being copied or modified, and
+ * is not needed anymore once the function returns.
+ */
+ini_file *ini_load_mem(const char *data, size_t len);
+
+/**
+ * @brief Parses INI data held in memory like ini_load_mem(), with additional
+ * options.
+ *
+ * @param data Pointer to the INI data, it does not have to be NUL-terminated.
+ * @param len Length of the data in bytes.
+ * @param options Pointer to the load options or NULL for the defaults.
+ * @return Pointer to an ini_file struct containing the parsed data or NULL if
+ * there was an error parsing or dynamically allocating the memory.
+ * @note INI_LOAD_ZERO_COPY is ignored since the data belongs to the caller.
+ */
+ini_file *ini_load_mem_ex(const char *data, size_t len,
+                          const ini_options *options);
+
+#ifdef INILOAD_HAS_FD
+/**
+ * @brief Reads INI data from a file descriptor until end of file and parses
+ * it.
+ *
+ * @param fd Open file descriptor, e.g. of a file, pipe or socket. It is not
+ * closed.
+ * @return Pointer to an ini_file struct containing the parsed data or NULL if
+ * there was an error reading, parsing or dynamically allocating the memory.
+ */
+ini_file *ini_load_fd(int fd);
+
+/**
+ * @brief Reads INI data from a file descriptor like ini_load_fd(), with
+ * additional options.
+ *
+ * @param fd Open file descriptor, e.g. of a file, pipe or socket. It is not
+ * closed.
+ * @param options Pointer to the load options or NULL for the defaults.
+ * @return Pointer to an ini_file struct containing the parsed data or NULL if
+ * there was an error reading, parsing or dynamically allocating the memory.
+ * @note INI_LOAD_MMAP maps the file if fd refers to a regular file.
+ */
+ini_file *ini_load_fd_ex(int fd, const ini_options *options);
+#endif
+
+/**
+ * @brief Parses a new version of INI data, reusing the sections of the
+ * previous version whose text did not change.
+ *
+ * The text is split before the lines that start with '['. Each piece is hashed
+ * and, if the same piece was parsed for the previous version, its section and
+ * its keys are taken over instead of being parsed again.
+ *
+ * @param old Pointer to the previous version or NULL for the first one.
+ * @param data Pointer to the new INI data, it does not have to be
+ * NUL-terminated.
+ * @param len Length of the data in bytes.
+ * @return Pointer to the new version or NULL if there was an error parsing or
+ * dynamically allocating the memory. On success old is freed, otherwise it
+ * stays valid and unchanged.
+ * @note Only files returned by ini_reload_mem() or ini_reload() are reused,
+ * any other file is parsed in full the first time (with its INI_LOAD_LAZY
+ * flag, other flags are not kept). Strings of replaced sections are dropped
+ * from memory once they make up half of it, by parsing in full again. Text
+ * with a repeated section header is parsed in full, as is the next version.
+ */
+ini_file *ini_reload_mem(ini_file *old, const char *data, size_t len);
+
+/**
+ * @brief Reads an INI file and parses it like ini_reload_mem().
+ *
+ * @param old Pointer to the previous version or NULL for the first one.
+ * @param path Path to the INI file.
+ * @return Pointer to the new version or NULL if there was an error reading,
+ * parsing or dynamically allocating the memory. On success old is freed,
+ * otherwise it stays valid and unchanged.
+ */
+ini_file *ini_reload(ini_file *old, const char *path);
+
+/**
+ * @brief Compacts a loaded INI file that is only read from now on.
+ *
+ * The keys of all sections are moved into one array in section order, the
+ * spare capacity of the arrays and of the string pool is given back and the
+ * hash index of the keys is rebuilt at the smallest size for their number.
+ *
+ * @param ini Pointer to a loaded INI file.
+ * @return 1 on success, 0 if there was an error dynamically allocating the
+ * memory, in which case the file is unchanged.
+ * @note Handles returned by ini_lookup() before the call are invalidated.
+ * Sections and keys keep their order. Files attached from a snapshot or
+ * shared memory are already compact and are left as they are, as are files
+ * that were frozen before. ini_reload() of a frozen file parses the whole
+ * text.
+ */
+int ini_freeze(ini_file *ini);
+
+#ifdef INILOAD_HAS_FD
+/**
+ * @brief Saves a loaded INI file as a binary snapshot, which
+ * ini_load_snapshot() uses in place instead of parsing the INI file again.
+ *
+ * @param ini Pointer to a loaded INI file.
+ * @param source_path Path to the INI file that ini was loaded from. Its size,
+ * modification time and a hash of its text are recorded to notice changes.
+ * @param path Path of the snapshot, a previous snapshot is replaced
+ * atomically.
+ * @return 1 on success, 0 if there was an error reading the INI file, writing
+ * the snapshot or dynamically allocating the memory.
+ * @note Snapshots can only be read by the same version of iniload on a
+ * platform with the same type sizes and byte order.
+ */
+int ini_save_snapshot(ini_file *ini, const char *source_path,
+                      const char *path);
+
+/**
+ * @brief Loads an INI file from its snapshot, or parses it if the snapshot is
+ * missing or stale.
+ *
+ * A snapshot that was saved from the current text of the INI file is mapped
+ * into memory and read in place: loading it costs one pass of hashing over
+ * the INI file and a copy of the sections, whatever the number of keys.
+ * Otherwise the INI file is parsed and saved to path as the new snapshot;
+ * errors saving it are ignored.
+ *
+ * @param source_path Path to the INI file.
+ * @param path Path to the snapshot.
+ * @return Pointer to an ini_file struct or NULL if there was an error reading,
+ * parsing or dynamically allocating the memory.
+ * @note Lazy keys are converted when the snapshot is saved. ini_reload() of a
+ * file loaded from a snapshot parses the whole text.
+ */
+ini_file *ini_load_snapshot(const char *source_path, const char *path);
+
+/**
+ * @brief Copies a loaded INI file into a named shared memory segment, which
+ * other processes map read-only with ini_attach() instead of loading the
+ * file themselves.
+ *
+ * @param ini Pointer to a loaded INI file.
+ * @param name Name of the segment, on POSIX systems it starts with a slash
+ * (see shm_open()). On POSIX systems a previous segment of the same name is
+ * replaced, the processes that attached it keep reading it, and of
+ * concurrent calls with the same name the last one to create its segment
+ * wins. On Windows a name can not be replaced while any process still has
+ * its segment open, the call then fails.
+ * @return Pointer to the owner of the segment or NULL if there was an error
+ * creating the segment or dynamically allocating the memory.
+ * @note The segment holds the same image as a snapshot, see
+ * ini_save_snapshot().
+ */
+ini_shared *ini_share(ini_file *ini, const char *name);
+
+/**
+ * @brief Maps a segment created by ini_share() and reads it in place.
+ *
+ * @param name Name of the segment.
+ * @return Pointer to an ini_file struct, which only owns a copy of the
+ * sections, or NULL if there is no complete segment of that name, its image
+ * is malformed or there was an error dynamically allocating the memory.
+ * @note Every offset and position of the image is checked when it is
+ * attached. The segment is only read afterwards, so only processes that are
+ * trusted not to write to it may have write access to it.
+ */
+ini_file *ini_attach(const char *name);
+
+/**
+ * @brief Removes the name of a segment created by ini_share() and frees its
+ * owner.
+ *
+ * The processes that attached the segment keep it until they call ini_free().
+ *
+ * @param shared Pointer to the owner of the segment.
+ */
+void ini_unshare(ini_shared *shared);
+#endif
+
 /**
  * @brief Returns the total number of sections in the INI file.
  *
@@ -62,6 +427,49 @@ int ini_has_section(ini_file *ini, const char *section_name);
  */
 size_t ini_num_keys(ini_file *ini, const char *section_name);
 
+/**
+ * @brief Returns the name of a section by its position, for walking over all
+ * sections without looking them up by name.
+ *
+ * @param ini Pointer to a loaded INI file.
+ * @param section Position of the section in file order, from 0 to
+ * ini_num_sections() - 1.
+ * @return Name of the section ("" for the keys before the first section
+ * header) or NULL if there is no section at this position.
+ */
+const char *ini_section_at(ini_file *ini, size_t section);
+
+/**
+ * @brief Returns the number of keys of a section by its position.
+ *
+ * @param ini Pointer to a loaded INI file.
+ * @param section Position of the section in file order.
+ * @return Number of keys of the section, 0 if there is no section at this
+ * position.
+ */
+size_t ini_num_keys_at(ini_file *ini, size_t section);
+
+/**
+ * @brief Returns a key of a section by their positions.
+ *
+ * Together with ini_section_at(), ini_get_name_h() and the handle getters,
+ * this walks over all keys in one pass:
+ * @code
+ * for (s = 0; s < ini_num_sections(ini); s++) {
+ *   for (k = 0; k < ini_num_keys_at(ini, s); k++) {
+ *     key = ini_key_at(ini, s, k);
+ *     ...
+ *   }
+ * }
+ * @endcode
+ *
+ * @param ini Pointer to a loaded INI file.
+ * @param section Position of the section in file order.
+ * @param key Position of the key in the section, in file order.
+ * @return Handle of the key or NULL if there is no key at these positions.
+ */
+ini_key_handle ini_key_at(ini_file *ini, size_t section, size_t key);
+
 /**
  * @brief Checks if a section with a given has a key with a given name.
  *
@@ -114,514 +522,5779 @@ char *ini_get_string(ini_file *ini, const char *section_name,
                      const char *key_name, char *default_val);
 
 /**
- * @brief Frees all dynamically allocated memory that is used by the parsed
- * INI file.
+ * @brief Retrieves an integer-typed key's value at full width.
  *
  * @param ini Pointer to a loaded INI file.
+ * @param section_name Name of the section.
+ * @param key_name Name of the key.
+ * @param default_val Default value that is returned if the key's value is not
+ * an integer or if the key or the section doesn't exist.
+ * @return The key's value or the default value.
+ * @note ini_get_int() returns the default value for integers that do not fit
+ * into an int (INI_KEY_INT64).
  */
-void ini_free(ini_file *ini);
+ini_int64 ini_get_int64(ini_file *ini, const char *section_name,
+                        const char *key_name, ini_int64 default_val);
 
-#ifdef __cplusplus
-}
-#endif
+/**
+ * @brief Retrieves a floating point key's value in double precision.
+ *
+ * @param ini Pointer to a loaded INI file.
+ * @param section_name Name of the section.
+ * @param key_name Name of the key.
+ * @param default_val Default value that is returned if the key's value is not
+ * a floating point number or if the key or the section doesn't exist.
+ * @return The key's value or the default value.
+ * @note ini_get_float() returns the default value for finite numbers that
+ * overflow a float (INI_KEY_DOUBLE). Numbers up to FLT_MAX and the ones that
+ * round to it are floats, as are infinities, NaN and tiny numbers, which
+ * ini_get_float() rounds to a subnormal float or zero.
+ */
+double ini_get_double(ini_file *ini, const char *section_name,
+                      const char *key_name, double default_val);
 
-#endif /* INILOAD_H */
+/**
+ * @brief Resolves a key once so that its value can be read repeatedly without
+ * looking the names up again.
+ *
+ * @param ini Pointer to a loaded INI file.
+ * @param section_name Name of the section.
+ * @param key_name Name of the key.
+ * @return Handle of the key or NULL if either the key or the section doesn't
+ * exist.
+ * @note The handle may be invalidated by the ini_set_*() functions and
+ * ini_freeze(), and it is invalidated when the file is freed by ini_free()
+ * or replaced by a new version from ini_reload() or ini_reload_mem().
+ */
+ini_key_handle ini_lookup(ini_file *ini, const char *section_name,
+                          const char *key_name);
 
-/******************
- * Implementation *
- ******************/
-#ifdef INILOAD_IMPLEMENTATION
+/**
+ * @brief Resolves a key like ini_lookup() with a hash of the names that was
+ * computed beforehand, e.g. at compile time.
+ *
+ * @param ini Pointer to a loaded INI file.
+ * @param section_name Name of the section.
+ * @param section_len Length of the section name.
+ * @param key_name Name of the key.
+ * @param key_len Length of the key name.
+ * @param hash 32-bit FNV-1a hash of the section name, a ']' character and the
+ * key name.
+ * @return Handle of the key or NULL if either the key or the section doesn't
+ * exist.
+ */
+ini_key_handle ini_lookup_hash(ini_file *ini, const char *section_name,
+                               size_t section_len, const char *key_name,
+                               size_t key_len, unsigned long hash);
 
-#ifdef __cplusplus
-extern "C" {
-#endif
+/**
+ * @brief Returns the type of a key's value.
+ *
+ * @param ini Pointer to the loaded INI file the handle belongs to.
+ * @param key Handle returned by ini_lookup(), must not be NULL.
+ * @return INI_KEY_INT, INI_KEY_FLOAT, INI_KEY_STRING, INI_KEY_INT64 or
+ * INI_KEY_DOUBLE.
+ */
+ini_key_type ini_get_type_h(ini_file *ini, ini_key_handle key);
 
 /**
- * @brief Supported INI key types.
+ * @brief Retrieves an integer-typed key's value through a handle.
+ *
+ * @param ini Pointer to the loaded INI file the handle belongs to.
+ * @param key Handle returned by ini_lookup(), may be NULL.
+ * @param default_val Default value that is returned if the key's value is of a
+ * different type or if the handle is NULL.
+ * @return The key's value or the default value.
  */
-typedef enum ini_key_type {
-  INI_KEY_INT,   /**< Signed integer key */
-  INI_KEY_FLOAT, /**< Single-precision floating point number key */
-  INI_KEY_STRING /**< String key */
-} ini_key_type;
+int ini_get_int_h(ini_file *ini, ini_key_handle key, int default_val);
 
 /**
- * @brief Represents a single INI key (its name, data type and value).
+ * @brief Retrieves an float-typed key's value through a handle.
+ *
+ * @param ini Pointer to the loaded INI file the handle belongs to.
+ * @param key Handle returned by ini_lookup(), may be NULL.
+ * @param default_val Default value that is returned if the key's value is of a
+ * different type or if the handle is NULL.
+ * @return The key's value or the default value.
  */
-typedef struct ini_key {
-  char name[INILOAD_NAME_MAXLEN + 1]; /**< Name of the key */
-  ini_key_type type;                  /**< Data type of the key's value */
-  union value {                       /**< Value of the key */
-    int int_val;
-    float float_val;
-    char *string_val;
-  } value;
-} ini_key;
+float ini_get_float_h(ini_file *ini, ini_key_handle key, float default_val);
 
 /**
- * @brief Represents a single INI section (a collection of keys).
+ * @brief Retrieves an string-typed key's value through a handle.
+ *
+ * @param ini Pointer to the loaded INI file the handle belongs to.
+ * @param key Handle returned by ini_lookup(), may be NULL.
+ * @param default_val Default value that is returned if the key's value is of a
+ * different type or if the handle is NULL.
+ * @return The key's value or the default value.
  */
-typedef struct ini_section {
-  char name[INILOAD_NAME_MAXLEN + 1]; /**< Name of the section */
-  size_t num_keys;                    /**< Number of keys in the section */
-  size_t cap_keys;   /**< Capacity of the array holding the keys */
-  ini_key *ptr_keys; /**< Pointer to the array holding the keys */
-} ini_section;
+char *ini_get_string_h(ini_file *ini, ini_key_handle key, char *default_val);
 
 /**
- * @brief Represents a collection of sections.
+ * @brief Retrieves an integer-typed key's value at full width through a
+ * handle.
+ *
+ * @param ini Pointer to the loaded INI file the handle belongs to.
+ * @param key Handle returned by ini_lookup(), may be NULL.
+ * @param default_val Default value that is returned if the key's value is not
+ * an integer or if the handle is NULL.
+ * @return The key's value or the default value.
  */
-struct ini_file {
-  size_t num_sections;       /**< Number of sections */
-  size_t cap_sections;       /**< Capacity of the array holding the sections */
-  ini_section *ptr_sections; /**< Pointer to the array holding the sections */
-};
+ini_int64 ini_get_int64_h(ini_file *ini, ini_key_handle key,
+                          ini_int64 default_val);
 
-ini_section *__ini_add_section(ini_file *ini, const char *section_name) {
-  ini_key *ptr_keys = NULL;
-  if (ini->num_sections == ini->cap_sections) {
-    /* Allocate more memory to add a new section */
-    ini_section *ptr_sec_new = (ini_section *)realloc(
-        ini->ptr_sections, sizeof(ini_section) * (ini->cap_sections * 2));
-    if (ptr_sec_new == NULL) {
-      return NULL;
-    }
-    ini->ptr_sections = ptr_sec_new;
-    ini->cap_sections = ini->cap_sections * 2;
-  }
+/**
+ * @brief Retrieves a floating point key's value in double precision through a
+ * handle.
+ *
+ * @param ini Pointer to the loaded INI file the handle belongs to.
+ * @param key Handle returned by ini_lookup(), may be NULL.
+ * @param default_val Default value that is returned if the key's value is not
+ * a floating point number or if the handle is NULL.
+ * @return The key's value or the default value.
+ */
+double ini_get_double_h(ini_file *ini, ini_key_handle key,
+                        double default_val);
 
-  strcpy(ini->ptr_sections[ini->num_sections].name, section_name);
-  ini->ptr_sections[ini->num_sections].num_keys = 0;
-  ini->ptr_sections[ini->num_sections].cap_keys = INILOAD_INITIAL_CAP;
-  ptr_keys = (ini_key *)malloc(sizeof(ini_key) * INILOAD_INITIAL_CAP);
-  if (ptr_keys == NULL) {
-    return NULL;
-  }
-  ini->ptr_sections[ini->num_sections].ptr_keys = ptr_keys;
-  ini->num_sections++;
-  return &(ini->ptr_sections[ini->num_sections - 1]);
-}
+/**
+ * @brief Returns the name of a key through a handle.
+ *
+ * @param ini Pointer to the loaded INI file the handle belongs to.
+ * @param key Handle returned by ini_lookup() or ini_key_at(), must not be
+ * NULL.
+ * @return Name of the key.
+ */
+const char *ini_get_name_h(ini_file *ini, ini_key_handle key);
 
-int __ini_add_key(ini_section *section, const char *key_name, const char *value,
-                  size_t value_len, int quotes) {
-  ini_key *ptr_keys_new;
-  double float_val;
-  long int int_val;
-  char *endptr;
-  char *copy = NULL;
-  if (section->num_keys == section->cap_keys) {
-    /* Allocate more memory to add a new key */
-    ptr_keys_new = (ini_key *)realloc(
-        section->ptr_keys, sizeof(ini_key) * (section->cap_keys * 2));
-    if (ptr_keys_new == NULL) {
-      return 0;
-    }
-    section->cap_keys = section->cap_keys * 2;
-    section->ptr_keys = ptr_keys_new;
-  }
+/**
+ * @brief Retrieves the values of many keys at once, e.g. to fill a struct
+ * with the settings of a program.
+ *
+ * Consecutive keys of the same section share one lookup of the section, the
+ * keys of a missing section are not looked up at all.
+ *
+ * @param ini Pointer to a loaded INI file.
+ * @param keys Keys to retrieve. The value of every key that exists with the
+ * requested type is stored to its out pointer, the others keep the default
+ * value that out points to.
+ * @param num_keys Number of keys.
+ * @return Number of values that were stored.
+ */
+size_t ini_get_batch(ini_file *ini, const ini_batch_key *keys,
+                     size_t num_keys);
 
-  strcpy(section->ptr_keys[section->num_keys].name, key_name);
+/**
+ * @brief Creates an empty INI file that keys can be set in and saved from.
+ *
+ * @return Pointer to an empty ini_file struct or NULL if there was an error
+ * dynamically allocating the memory.
+ */
+ini_file *ini_create(void);
 
-  /* Guess the data type of the key */
-  if (quotes) {
-    /* Definitely a string if it is quoted */
-    copy = (char *)malloc(value_len + 1);
-    if (copy == NULL) {
-      return 0;
-    }
-    strcpy(copy, value);
-    section->ptr_keys[section->num_keys].value.string_val = copy;
-    section->ptr_keys[section->num_keys].type = INI_KEY_STRING;
-  } else {
-    int_val = strtol(value, &endptr, 0);
-    if (*endptr == '\0') {
-      /* This is an integer */
-      section->ptr_keys[section->num_keys].value.int_val = int_val;
-      section->ptr_keys[section->num_keys].type = INI_KEY_INT;
-    } else {
-      /* Have to use strtod instead of the (yet) unsupported strtof */
-      float_val = strtod(value, &endptr);
-      if (*endptr == '\0') {
-        /* This is a float */
-        section->ptr_keys[section->num_keys].value.float_val = (float)float_val;
-        section->ptr_keys[section->num_keys].type = INI_KEY_FLOAT;
-      } else {
-        /* Must be a string then */
-        copy = (char *)malloc(value_len + 1);
-        if (copy == NULL) {
-          return 0;
-        }
-        strcpy(copy, value);
-        section->ptr_keys[section->num_keys].value.string_val = copy;
-        section->ptr_keys[section->num_keys].type = INI_KEY_STRING;
-      }
-    }
-  }
+/**
+ * @brief Sets a key to an integer value, adding the section and the key if
+ * they do not exist.
+ *
+ * @param ini Pointer to a loaded or created INI file.
+ * @param section_name Name of the section, "" for the keys before the first
+ * section header.
+ * @param key_name Name of the key.
+ * @param value New value of the key.
+ * @return 1 on success, 0 if a name can not be written in an INI file, the
+ * file was attached from a snapshot or shared memory, or there was an error
+ * dynamically allocating the memory.
+ * @note A key that exists keeps its place. Strings returned by
+ * ini_get_string() and handles returned by ini_lookup() before the call may
+ * be invalidated. ini_reload() of a file that was set parses the whole text,
+ * and a frozen file gets one key array per section again.
+ */
+int ini_set_int(ini_file *ini, const char *section_name, const char *key_name,
+                int value);
 
-  section->num_keys++;
-  return 1;
-}
+/**
+ * @brief Sets a key to a floating point value like ini_set_int().
+ *
+ * @param ini Pointer to a loaded or created INI file.
+ * @param section_name Name of the section.
+ * @param key_name Name of the key.
+ * @param value New value of the key.
+ * @return 1 on success, 0 on the errors of ini_set_int().
+ */
+int ini_set_float(ini_file *ini, const char *section_name,
+                  const char *key_name, float value);
 
-ini_key *__ini_get_key_ptr(ini_file *ini, const char *section_name,
+/**
+ * @brief Sets a key to a 64-bit integer value like ini_set_int().
+ *
+ * @param ini Pointer to a loaded or created INI file.
+ * @param section_name Name of the section.
+ * @param key_name Name of the key.
+ * @param value New value of the key.
+ * @return 1 on success, 0 on the errors of ini_set_int().
+ */
+int ini_set_int64(ini_file *ini, const char *section_name,
+                  const char *key_name, ini_int64 value);
+
+/**
+ * @brief Sets a key to a double precision value like ini_set_int().
+ *
+ * @param ini Pointer to a loaded or created INI file.
+ * @param section_name Name of the section.
+ * @param key_name Name of the key.
+ * @param value New value of the key.
+ * @return 1 on success, 0 on the errors of ini_set_int().
+ */
+int ini_set_double(ini_file *ini, const char *section_name,
+                   const char *key_name, double value);
+
+/**
+ * @brief Sets a key to a string value like ini_set_int().
+ *
+ * @param ini Pointer to a loaded or created INI file.
+ * @param section_name Name of the section.
+ * @param key_name Name of the key.
+ * @param value New value of the key, which is copied.
+ * @return 1 on success, 0 on the errors of ini_set_int() or if the value can
+ * not be written in an INI file: it contains a line break, or it contains a
+ * double quote and needs quotes (it is empty, looks like a number, starts
+ * with white space or contains one of "[]=").
+ */
+int ini_set_string(ini_file *ini, const char *section_name,
+                   const char *key_name, const char *value);
+
+/**
+ * @brief Writes an INI file to a path as text that ini_load() reads back to
+ * the same sections, keys and values.
+ *
+ * The text is formatted into one large buffer (INILOAD_WRITE_BUFFER_SIZE
+ * bytes) that is written whenever it is full, so files that fit into it are
+ * written at once.
+ *
+ * @param ini Pointer to a loaded or created INI file.
+ * @param path Path of the file, which is created or overwritten.
+ * @return 1 on success, 0 if the file could not be written or there was an
+ * error dynamically allocating the memory.
+ * @note Comments and the layout of the loaded text are not kept. Floats are
+ * written with the fewest digits that read back to the same value.
+ */
+int ini_save(ini_file *ini, const char *path);
+
+/**
+ * @brief Writes an INI file to memory as ini_save() would write it to a file.
+ *
+ * @param ini Pointer to a loaded or created INI file.
+ * @param buf Buffer receiving the text and a NUL character, NULL to only get
+ * the length.
+ * @param size Size of the buffer in bytes; the text is cut if it is too small.
+ * @return Length of the whole text without the NUL character, which is size
+ * or more if the text was cut.
+ */
+size_t ini_save_mem(ini_file *ini, char *buf, size_t size);
+
+/**
+ * @brief Reads the counters of a loaded INI file.
+ *
+ * @param ini Pointer to a loaded INI file.
+ * @param stats Receives the counters.
+ * @return 1 if the counters are kept, 0 if only the numbers of sections and
+ * keys are set because INILOAD_ENABLE_STATS is not defined.
+ * @note Threads that read the same file at once, e.g. the readers of an
+ * ini_live, count their lookups with atomic increments, and the counters
+ * can be read while they do.
+ */
+int ini_get_stats(ini_file *ini, ini_stats *stats);
+
+/**
+ * @brief Lists the keys that were looked up by name most often, which are
+ * the ones worth resolving once with ini_lookup().
+ *
+ * @param ini Pointer to a loaded INI file.
+ * @param keys Receives the keys, most looked up first.
+ * @param max_keys Capacity of keys.
+ * @return Number of keys stored, only keys that were looked up at least once
+ * are listed.
+ * @note Lookups by ini_get_int(), ini_get_float(), ini_get_string(),
+ * ini_lookup(), ini_lookup_hash() and ini_get_batch() are counted. Nothing
+ * is listed without INILOAD_ENABLE_STATS or for files attached from a
+ * snapshot or shared memory, whose keys are read-only.
+ */
+size_t ini_hot_keys(ini_file *ini, ini_key_stats *keys, size_t max_keys);
+
+/**
+ * @brief Frees all dynamically allocated memory that is used by the parsed
+ * INI file.
+ *
+ * @param ini Pointer to a loaded INI file.
+ */
+void ini_free(ini_file *ini);
+
+#ifdef INILOAD_HAS_ATOMICS
+/**
+ * @brief Loads an INI file that can be reloaded while other threads read it.
+ *
+ * @param path Path to the INI file, it is loaded again by ini_live_reload().
+ * @param options Pointer to the load options or NULL for the defaults.
+ * @return Pointer to the live file or NULL if there was an error loading the
+ * file or dynamically allocating the memory.
+ * @note arena_buf can not be used since two versions of the file may exist at
+ * the same time, and INI_LOAD_LAZY has no effect since the getters would
+ * otherwise modify a file that several threads read.
+ */
+ini_live *ini_live_create(const char *path, const ini_options *options);
+
+/**
+ * @brief Pins the current version of a live file for reading.
+ *
+ * Never blocks: readers only increment a counter and read a pointer.
+ *
+ * @param live Pointer to a live file.
+ * @param slot Receives the value to pass to ini_live_release().
+ * @return The current version, which can be read with all the getters and
+ * stays valid until ini_live_release() is called.
+ * @note Handles returned by ini_lookup() belong to one version, they must not
+ * be used after the version is released.
+ */
+ini_file *ini_live_acquire(ini_live *live, size_t *slot);
+
+/**
+ * @brief Unpins a version returned by ini_live_acquire().
+ *
+ * @param live Pointer to a live file.
+ * @param slot Value received from ini_live_acquire().
+ */
+void ini_live_release(ini_live *live, size_t slot);
+
+/**
+ * @brief Loads the INI file again with the same options and publishes it.
+ *
+ * @param live Pointer to a live file.
+ * @return 1 if the new version was published, 0 if there was an error loading
+ * the file, in which case the current version stays in place.
+ * @note See ini_live_publish() for how the previous version is retired.
+ */
+int ini_live_reload(ini_live *live);
+
+/**
+ * @brief Publishes an already loaded INI file as the new version of a live
+ * file and frees the previous version.
+ *
+ * Readers that acquire the live file afterwards see the new version. The call
+ * waits until the readers that may still use the previous version release it
+ * before freeing it; concurrent reloads and publishes are serialized.
+ *
+ * @param live Pointer to a live file.
+ * @param ini Pointer to a loaded INI file, the live file takes ownership of it.
+ */
+void ini_live_publish(ini_live *live, ini_file *ini);
+
+/**
+ * @brief Frees a live file and its current version.
+ *
+ * @param live Pointer to a live file, no thread may be reading it anymore.
+ */
+void ini_live_free(ini_live *live);
+#endif
+
+/**
+ * @brief Creates a view of several loaded INI files in which the keys of a
+ * file override those of the files before it, e.g. a base file and its
+ * overlays, without merging them into a copy.
+ *
+ * @param files Files from the lowest to the highest priority, NULL for a
+ * layer that is empty for now. The stack does not take ownership of them.
+ * @param num_files Number of files.
+ * @return Pointer to the stack or NULL if there was an error dynamically
+ * allocating the memory.
+ * @note Lookups remember where each key was found, so a stack must not be
+ * used by several threads at once.
+ */
+ini_stack *ini_stack_create(ini_file *const *files, size_t num_files);
+
+/**
+ * @brief Replaces one layer of a stack, e.g. with a reloaded overlay.
+ *
+ * @param stack Pointer to a stack.
+ * @param layer Position of the file given to ini_stack_create().
+ * @param ini New file of the layer or NULL to leave it empty.
+ * @return The previous file of the layer, which the caller still owns.
+ * @note Keys added with ini_set_int() and the like are seen by the stack
+ * without replacing their file.
+ */
+ini_file *ini_stack_replace(ini_stack *stack, size_t layer, ini_file *ini);
+
+/**
+ * @brief Resolves a key to the file of the highest priority that has it.
+ *
+ * @param stack Pointer to a stack.
+ * @param section_name Name of the section.
+ * @param key_name Name of the key.
+ * @param file Receives the file the key belongs to, which is passed to the
+ * handle getters, may be NULL.
+ * @return Handle of the key or NULL if no file has it.
+ */
+ini_key_handle ini_stack_lookup(ini_stack *stack, const char *section_name,
+                                const char *key_name, ini_file **file);
+
+/**
+ * @brief Retrieves an integer-typed key's value from the file of the highest
+ * priority that has the key.
+ *
+ * @param stack Pointer to a stack.
+ * @param section_name Name of the section.
+ * @param key_name Name of the key.
+ * @param default_val Default value that is returned if no file has the key or
+ * if its value is of a different type.
+ * @return The key's value or the default value.
+ */
+int ini_stack_get_int(ini_stack *stack, const char *section_name,
+                      const char *key_name, int default_val);
+
+/**
+ * @brief Retrieves a float-typed key's value like ini_stack_get_int().
+ *
+ * @param stack Pointer to a stack.
+ * @param section_name Name of the section.
+ * @param key_name Name of the key.
+ * @param default_val Default value.
+ * @return The key's value or the default value.
+ */
+float ini_stack_get_float(ini_stack *stack, const char *section_name,
+                          const char *key_name, float default_val);
+
+/**
+ * @brief Retrieves a string-typed key's value like ini_stack_get_int().
+ *
+ * @param stack Pointer to a stack.
+ * @param section_name Name of the section.
+ * @param key_name Name of the key.
+ * @param default_val Default value.
+ * @return The key's value or the default value.
+ */
+char *ini_stack_get_string(ini_stack *stack, const char *section_name,
+                           const char *key_name, char *default_val);
+
+/**
+ * @brief Retrieves an integer-typed key's value at full width like
+ * ini_stack_get_int().
+ *
+ * @param stack Pointer to a stack.
+ * @param section_name Name of the section.
+ * @param key_name Name of the key.
+ * @param default_val Default value.
+ * @return The key's value or the default value.
+ */
+ini_int64 ini_stack_get_int64(ini_stack *stack, const char *section_name,
+                              const char *key_name, ini_int64 default_val);
+
+/**
+ * @brief Retrieves a floating point key's value in double precision like
+ * ini_stack_get_int().
+ *
+ * @param stack Pointer to a stack.
+ * @param section_name Name of the section.
+ * @param key_name Name of the key.
+ * @param default_val Default value.
+ * @return The key's value or the default value.
+ */
+double ini_stack_get_double(ini_stack *stack, const char *section_name,
+                            const char *key_name, double default_val);
+
+/**
+ * @brief Frees a stack, but not its files.
+ *
+ * @param stack Pointer to a stack.
+ */
+void ini_stack_free(ini_stack *stack);
+
+/**
+ * @brief Called by an asynchronous load for every file that is loaded.
+ *
+ * @param user Pointer given to ini_load_async().
+ * @param index Position of the file's path in the paths given to
+ * ini_load_async().
+ * @param ini The loaded file, which belongs to the caller, or NULL if there
+ * was an error loading it.
+ */
+typedef void (*ini_load_cb)(void *user, size_t index, ini_file *ini);
+
+/**
+ * @brief Loads several INI files on worker threads without blocking the
+ * calling thread, e.g. from an event loop.
+ *
+ * Every worker takes the next path that is not loaded yet, then reads and
+ * parses it with ini_load_ex(). A program can be told of the files that are
+ * loaded by the callback, by polling ini_async_fd() or ini_async_done(), or
+ * by waiting with ini_async_wait().
+ *
+ * @param paths Paths of the INI files, which are copied.
+ * @param num_paths Number of paths.
+ * @param options Pointer to the load options or NULL for the defaults. Up to
+ * num_threads files (INILOAD_THREADS if 0) are loaded at once.
+ * @param on_load Function that is called on a worker thread for every file
+ * that is loaded, may be NULL.
+ * @param user Pointer passed to the callback.
+ * @return Pointer to the pending load or NULL if there was an error starting
+ * it or dynamically allocating the memory.
+ * @note This requires INILOAD_ENABLE_THREADS to be defined where the
+ * implementation is compiled, otherwise the files are loaded before the call
+ * returns. arena_buf can not be used since the files are loaded at the same
+ * time.
+ */
+ini_async *ini_load_async(const char *const *paths, size_t num_paths,
+                          const ini_options *options, ini_load_cb on_load,
+                          void *user);
+
+/**
+ * @brief Returns a file descriptor that becomes readable once all files of
+ * an asynchronous load are loaded, to be watched with poll() or an event
+ * loop. It belongs to the load and is closed by ini_async_free().
+ *
+ * @param async Pointer to a pending load.
+ * @return The file descriptor, -1 on platforms without pipes (Windows).
+ */
+int ini_async_fd(ini_async *async);
+
+/**
+ * @brief Checks if all files of an asynchronous load are loaded, without
+ * blocking.
+ *
+ * @param async Pointer to a pending load.
+ * @return 1 if all callbacks have returned, 0 otherwise.
+ */
+int ini_async_done(ini_async *async);
+
+/**
+ * @brief Blocks until all files of an asynchronous load are loaded.
+ *
+ * @param async Pointer to a pending load.
+ */
+void ini_async_wait(ini_async *async);
+
+/**
+ * @brief Returns a file of an asynchronous load.
+ *
+ * @param async Pointer to a pending load.
+ * @param index Position of the file's path in the paths.
+ * @return The loaded file, NULL until all files are loaded or if there was
+ * an error loading it. This is the same file that the callback received and
+ * it belongs to the caller.
+ */
+ini_file *ini_async_result(ini_async *async, size_t index);
+
+/**
+ * @brief Waits for an asynchronous load and frees it, but not its files.
+ *
+ * @param async Pointer to a pending load.
+ */
+void ini_async_free(ini_async *async);
+
+/**
+ * @brief Called by a streaming parser for every section header.
+ *
+ * @param user Pointer given to ini_parser_create().
+ * @param section NUL-terminated name of the section, only valid during the
+ * call.
+ * @return 1 to continue parsing, 0 to stop with an error.
+ */
+typedef int (*ini_section_cb)(void *user, const char *section);
+
+/**
+ * @brief Called by a streaming parser for every key.
+ *
+ * @param user Pointer given to ini_parser_create().
+ * @param section NUL-terminated name of the section the key is in.
+ * @param key NUL-terminated name of the key.
+ * @param value NUL-terminated value of the key, without the quotes.
+ * @param quoted 1 if the value was quoted, in which case ini_load() would
+ * keep it as a string, 0 otherwise.
+ * @return 1 to continue parsing, 0 to stop with an error.
+ * @note The strings are only valid during the call.
+ */
+typedef int (*ini_key_cb)(void *user, const char *section, const char *key,
+                          const char *value, int quoted);
+
+/**
+ * @brief Creates a parser that reads INI text in chunks of any size and
+ * reports sections and keys as soon as they are complete.
+ *
+ * @param on_section Function called for every section header or NULL.
+ * @param on_key Function called for every key or NULL.
+ * @param user Pointer passed to the callbacks.
+ * @return Pointer to the parser or NULL if there was an error dynamically
+ * allocating the memory.
+ * @note The syntax is the one of ini_load(). Sections are reported every time
+ * their header appears and keys every time they are set; keys that come
+ * before the first header are reported after a section with an empty name.
+ */
+ini_parser *ini_parser_create(ini_section_cb on_section, ini_key_cb on_key,
+                              void *user);
+
+/**
+ * @brief Parses the next chunk of the text.
+ *
+ * A name or value may be split at any byte between two chunks. The parser
+ * only keeps the name of the current section and the key that is being read,
+ * so its memory is bounded by the longest value.
+ *
+ * @param parser Pointer to a streaming parser.
+ * @param chunk Next bytes of the text, they are not kept after the call.
+ * @param len Number of bytes in chunk.
+ * @return 1 on success, 0 if there was a syntax error, an error dynamically
+ * allocating the memory or a callback stopped the parser, in which case the
+ * following calls fail as well.
+ */
+int ini_parser_feed(ini_parser *parser, const char *chunk, size_t len);
+
+/**
+ * @brief Ends the text, which reports a last key that is not followed by a
+ * newline, and resets the parser to read a new text.
+ *
+ * @param parser Pointer to a streaming parser.
+ * @return 1 if the whole text was parsed successfully, 0 otherwise.
+ */
+int ini_parser_finish(ini_parser *parser);
+
+/**
+ * @brief Frees a streaming parser.
+ *
+ * @param parser Pointer to a streaming parser.
+ */
+void ini_parser_free(ini_parser *parser);
+
+#ifdef __cplusplus
+}
+#endif
+
+#if defined(__cplusplus) && !defined(INILOAD_NO_CPP) &&                        \
+    (__cplusplus >= 201103L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201103L))
+#include <cstddef>
+
+/**
+ * @brief C++ binding of the keys of an INI file to the members of a struct.
+ *
+ * The names of a schema are hashed at compile time, binding it looks every
+ * key up with ini_lookup_hash() and reports all the keys whose value has
+ * another type than their member:
+ *
+ *   constexpr auto schema = iniload::make_schema(
+ *       iniload::key("net", "port", &config::port, 8080),
+ *       iniload::key("net", "host", &config::host, "localhost"));
+ *   config cfg;
+ *   auto report = schema.bind(ini, cfg);
+ */
+namespace iniload {
+
+/* 32-bit FNV-1a of the C part */
+constexpr unsigned long hash(const char *str,
+                             unsigned long hash_val = 2166136261UL) {
+  return *str == '\0'
+             ? hash_val
+             : hash(str + 1,
+                    ((hash_val ^ static_cast<unsigned char>(*str)) *
+                     16777619UL) &
+                        0xffffffffUL);
+}
+
+/* Hash of a key in the key index: the section name, ']' and the key name */
+constexpr unsigned long key_hash(const char *section_name,
+                                 const char *key_name) {
+  return hash(key_name, ((hash(section_name) ^ ']') * 16777619UL) &
+                            0xffffffffUL);
+}
+
+constexpr std::size_t length(const char *str) {
+  return *str == '\0' ? 0 : 1 + length(str + 1);
+}
+
+/* Type of the INI value that a member of type T is bound to, wide members
+ * also take the values of the narrow type */
+template <class T> struct value_type;
+
+template <> struct value_type<int> {
+  static constexpr ini_key_type type() { return INI_KEY_INT; }
+  static constexpr bool accepts(ini_key_type t) { return t == INI_KEY_INT; }
+  static int get(ini_file *ini, ini_key_handle key, int default_val) {
+    return ini_get_int_h(ini, key, default_val);
+  }
+};
+
+template <> struct value_type<float> {
+  static constexpr ini_key_type type() { return INI_KEY_FLOAT; }
+  static constexpr bool accepts(ini_key_type t) { return t == INI_KEY_FLOAT; }
+  static float get(ini_file *ini, ini_key_handle key, float default_val) {
+    return ini_get_float_h(ini, key, default_val);
+  }
+};
+
+template <> struct value_type<ini_int64> {
+  static constexpr ini_key_type type() { return INI_KEY_INT64; }
+  static constexpr bool accepts(ini_key_type t) {
+    return t == INI_KEY_INT64 || t == INI_KEY_INT;
+  }
+  static ini_int64 get(ini_file *ini, ini_key_handle key,
+                       ini_int64 default_val) {
+    return ini_get_int64_h(ini, key, default_val);
+  }
+};
+
+template <> struct value_type<double> {
+  static constexpr ini_key_type type() { return INI_KEY_DOUBLE; }
+  static constexpr bool accepts(ini_key_type t) {
+    return t == INI_KEY_DOUBLE || t == INI_KEY_FLOAT;
+  }
+  static double get(ini_file *ini, ini_key_handle key, double default_val) {
+    return ini_get_double_h(ini, key, default_val);
+  }
+};
+
+template <> struct value_type<const char *> {
+  static constexpr ini_key_type type() { return INI_KEY_STRING; }
+  static constexpr bool accepts(ini_key_type t) {
+    return t == INI_KEY_STRING;
+  }
+  static const char *get(ini_file *ini, ini_key_handle key,
+                         const char *default_val) {
+    return ini_get_string_h(ini, key, const_cast<char *>(default_val));
+  }
+};
+
+/**
+ * @brief A key bound to a member of S of type T.
+ */
+template <class S, class T> struct field {
+  const char *section_name; /**< Name of the section */
+  std::size_t section_len;  /**< Length of the section name */
+  const char *key_name;     /**< Name of the key */
+  std::size_t key_len;      /**< Length of the key name */
+  unsigned long hash;       /**< key_hash() of the names */
+  T S::*member;             /**< Member receiving the value */
+  T default_val;            /**< Value of the member if the key is missing */
+};
+
+template <class S, class T>
+constexpr field<S, T> key(const char *section_name, const char *key_name,
+                          T S::*member, T default_val) {
+  return field<S, T>{section_name, length(section_name),
+                     key_name,     length(key_name),
+                     key_hash(section_name, key_name), member,
+                     default_val};
+}
+
+/* String members take string literals as their default */
+template <class S>
+constexpr field<S, const char *> key(const char *section_name,
+                                     const char *key_name,
+                                     const char *S::*member,
+                                     const char *default_val) {
+  return field<S, const char *>{section_name, length(section_name),
+                                key_name,     length(key_name),
+                                key_hash(section_name, key_name), member,
+                                default_val};
+}
+
+/**
+ * @brief A key whose value has another type than its member.
+ */
+struct mismatch {
+  const char *section_name; /**< Name of the section */
+  const char *key_name;     /**< Name of the key */
+  ini_key_type expected;    /**< Type of the member */
+  ini_key_type found;       /**< Type of the value */
+};
+
+/**
+ * @brief Result of binding a schema of N keys.
+ */
+template <std::size_t N> struct report {
+  std::size_t num_found;      /**< Number of members set from the file */
+  std::size_t num_mismatches; /**< Number of entries in mismatches */
+  mismatch mismatches[N];     /**< Keys that kept their default value because
+                                   of their type */
+
+  bool ok() const { return num_mismatches == 0; }
+};
+
+template <class S, class T, class R>
+void bind_field(ini_file *ini, S &out, const field<S, T> &f, R &result) {
+  ini_key_handle key = ini_lookup_hash(ini, f.section_name, f.section_len,
+                                       f.key_name, f.key_len, f.hash);
+  ini_key_type found;
+  out.*f.member = f.default_val;
+  if (key == NULL) {
+    return;
+  }
+  found = ini_get_type_h(ini, key);
+  if (!value_type<T>::accepts(found)) {
+    mismatch &m = result.mismatches[result.num_mismatches++];
+    m.section_name = f.section_name;
+    m.key_name = f.key_name;
+    m.expected = value_type<T>::type();
+    m.found = found;
+    return;
+  }
+  out.*f.member = value_type<T>::get(ini, key, f.default_val);
+  result.num_found++;
+}
+
+/**
+ * @brief The keys bound to the members of S, of types T...
+ */
+template <class S, class... T> class schema;
+
+template <class S> class schema<S> {
+public:
+  constexpr schema() {}
+
+  template <class R> void bind_into(ini_file *, S &, R &) const {}
+};
+
+template <class S, class T, class... R> class schema<S, T, R...> {
+public:
+  constexpr schema(const field<S, T> &first, const field<S, R> &... rest)
+      : first_(first), rest_(rest...) {}
+
+  /**
+   * @brief Sets every member to the value of its key or to its default.
+   *
+   * @param ini Pointer to a loaded INI file.
+   * @param out Struct receiving the values.
+   * @return The number of members set from the file and the keys whose
+   * value has another type.
+   */
+  report<1 + sizeof...(R)> bind(ini_file *ini, S &out) const {
+    report<1 + sizeof...(R)> result = report<1 + sizeof...(R)>();
+    bind_into(ini, out, result);
+    return result;
+  }
+
+  template <class P> void bind_into(ini_file *ini, S &out, P &result) const {
+    bind_field(ini, out, first_, result);
+    rest_.bind_into(ini, out, result);
+  }
+
+private:
+  field<S, T> first_;
+  schema<S, R...> rest_;
+};
+
+template <class S, class... T>
+constexpr schema<S, T...> make_schema(const field<S, T> &... fields) {
+  return schema<S, T...>(fields...);
+}
+
+} /* namespace iniload */
+#endif
+
+#endif /* INILOAD_H */
+
+/******************
+ * Implementation *
+ ******************/
+#ifdef INILOAD_IMPLEMENTATION
+
+#include <float.h>
+#include <limits.h>
+
+/* All three can be defined to use another allocator */
+#ifndef INILOAD_MALLOC
+#define INILOAD_MALLOC(size) malloc(size)
+#define INILOAD_REALLOC(ptr, size) realloc(ptr, size)
+#define INILOAD_FREE(ptr) free(ptr)
+#endif
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <windows.h>
+#define INILOAD_WIN32
+#elif defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define INILOAD_POSIX
+#endif
+
+#if defined(INILOAD_ENABLE_THREADS) && !defined(INILOAD_HAS_ATOMICS)
+#error "INILOAD_ENABLE_THREADS needs the atomic operations of GCC or MSVC"
+#endif
+
+#if defined(INILOAD_ENABLE_THREADS) && defined(INILOAD_POSIX)
+#include <pthread.h>
+#endif
+
+#ifdef INILOAD_POSIX
+#include <sched.h>
+#endif
+
+#if defined(INILOAD_ENABLE_STATS) && defined(INILOAD_POSIX)
+#include <sys/time.h>
+#elif defined(INILOAD_ENABLE_STATS) && !defined(INILOAD_WIN32)
+#include <time.h>
+#endif
+
+#if !defined(INILOAD_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define INILOAD_AVX2
+#elif !defined(INILOAD_NO_SIMD) &&                                             \
+    (defined(__SSE2__) || defined(_M_X64) ||                                   \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define INILOAD_SSE2
+#elif !defined(INILOAD_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define INILOAD_NEON
+#endif
+
+#if defined(_MSC_VER) && (defined(INILOAD_AVX2) || defined(INILOAD_SSE2))
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Represents a single INI key (its name, data type and value).
+ */
+typedef struct ini_key {
+  size_t name_off;    /**< Offset of the key's name in the string pool */
+  size_t name_len;    /**< Length of the key's name */
+  ini_key_type type;  /**< Data type of the key's value */
+  union value {       /**< Value of the key */
+    ini_int64 int_val;
+    double float_val;
+    size_t string_off; /**< Offset of the string in the string pool */
+  } value;
+#ifdef INILOAD_ENABLE_STATS
+  size_t lookups; /**< Number of lookups by name, for ini_hot_keys() */
+#endif
+} ini_key;
+
+/**
+ * @brief Represents a single INI section (a collection of keys).
+ */
+typedef struct ini_section {
+  size_t name_off;    /**< Offset of the section's name in the string pool */
+  size_t name_len;    /**< Length of the section's name */
+  unsigned long hash; /**< Hash of the section's name */
+  size_t num_keys;    /**< Number of keys in the section */
+  size_t cap_keys;    /**< Capacity of the array holding the keys */
+  ini_key *ptr_keys;  /**< Pointer to the array holding the keys */
+  unsigned long span_hash[2]; /**< Hashes of the section's text, kept by
+                                   ini_reload_mem() */
+  size_t span_len;            /**< Length of the section's text */
+  size_t pool_len; /**< Bytes of the string pool added by the section */
+} ini_section;
+
+/**
+ * @brief A slot of an open-addressing hash index.
+ *
+ * Sections and keys are referenced by their position in the arrays rather
+ * than by pointers, so the index stays valid when the arrays are reallocated.
+ */
+typedef struct ini_index_entry {
+  unsigned long hash; /**< Hash of the section name (and key name) */
+  size_t section;     /**< Index of the section plus one, 0 if slot is free */
+  size_t key;         /**< Index of the key in the section */
+} ini_index_entry;
+
+/**
+ * @brief Alignment of every allocation made from an arena.
+ */
+typedef union ini_max_align {
+  long long_val;
+  double double_val;
+  void *ptr_val;
+} ini_max_align;
+
+#define INILOAD_ALIGN(size)                                                    \
+  (((size) + sizeof(ini_max_align) - 1) & ~(sizeof(ini_max_align) - 1))
+
+/**
+ * @brief A block of memory that arena allocations are carved from.
+ */
+typedef struct ini_arena_block {
+  struct ini_arena_block *next; /**< Previously filled block */
+  size_t size;                  /**< Size of the block, header included */
+  size_t used;                  /**< Number of used bytes, header included */
+  int owned;                    /**< 1 if the block was allocated by iniload */
+} ini_arena_block;
+
+/**
+ * @brief Bump allocator holding a whole parsed INI file.
+ */
+typedef struct ini_arena {
+  ini_arena_block *head; /**< Block that allocations are made from */
+  char *last;            /**< Most recent allocation, can grow in place */
+} ini_arena;
+
+/**
+ * @brief Represents a collection of sections.
+ */
+struct ini_file {
+  unsigned int flags;        /**< ini_load_flags the file was loaded with */
+  ini_arena *arena;          /**< Arena holding everything, NULL for malloc */
+  size_t num_sections;       /**< Number of sections */
+  size_t cap_sections;       /**< Capacity of the array holding the sections */
+  ini_section *ptr_sections; /**< Pointer to the array holding the sections */
+  size_t num_section_index;  /**< Number of used slots in section_index */
+  size_t cap_section_index;  /**< Number of slots in section_index */
+  ini_index_entry *section_index; /**< Section name -> section */
+  size_t num_key_index;           /**< Number of used slots in key_index */
+  size_t cap_key_index;           /**< Number of slots in key_index */
+  ini_index_entry *key_index;     /**< Section name + key name -> key */
+  size_t cap_key_filter;   /**< Number of words in key_filter */
+  unsigned long *key_filter; /**< Bloom filter of the hashes in key_index,
+                                  NULL if there is none */
+  size_t num_filter_stale; /**< Keys removed from key_index since key_filter
+                                was built, whose bits are still set */
+  size_t size_pool; /**< Number of used bytes in the string pool */
+  size_t cap_pool;  /**< Capacity of the string pool */
+  char *ptr_pool;   /**< NUL-terminated names and string values, this is the
+                       text of the file with INI_LOAD_ZERO_COPY */
+  int incremental;  /**< Whether the sections know their text, which is the
+                       case for files returned by ini_reload_mem() */
+  size_t cap_new_keys; /**< Capacity of the key arrays of new sections */
+  const size_t *key_hints; /**< Keys expected after each section header while
+                                the text is parsed, NULL otherwise */
+  size_t num_key_hints;    /**< Number of entries in key_hints */
+  size_t hint_pos;         /**< Entry of the current section header */
+  char *image;       /**< Mapped snapshot holding the keys, indexes and pool,
+                        NULL if the file was parsed */
+  size_t image_size; /**< Size of the image */
+  ini_key *frozen;   /**< Keys of all sections after ini_freeze(), NULL
+                        before */
+#ifdef INILOAD_ENABLE_STATS
+  ini_stats stats; /**< Counters returned by ini_get_stats() */
+#endif
+};
+
+#ifdef INILOAD_HAS_ATOMICS
+/**
+ * @brief INI file that is replaced by new versions while threads read it.
+ *
+ * Readers register in the counter of the current epoch before reading the
+ * current version. A writer swaps the version, moves to the next epoch and
+ * waits for the counter of the previous epoch to drop to zero, after which no
+ * reader can still hold the previous version.
+ */
+struct ini_live {
+  ini_file *volatile current; /**< Version that readers acquire */
+  volatile long epoch;        /**< Incremented by every publish */
+  volatile long readers[2];   /**< Readers registered in even and odd epochs */
+  volatile long busy;         /**< Set while a version is being published */
+  char *path;                 /**< Path for ini_live_reload() */
+  ini_options options;        /**< Options for ini_live_reload() */
+};
+#endif
+
+/**
+ * @brief A slot of the cache of a stack, where a key was found last.
+ */
+typedef struct ini_stack_entry {
+  unsigned long hash; /**< Hash of the section name and key name */
+  size_t layer;       /**< Layer of the file plus one, 0 if slot is free */
+  size_t section;     /**< Index of the section in the file */
+  size_t key;         /**< Index of the key in the section */
+} ini_stack_entry;
+
+/**
+ * @brief Layered view of several INI files.
+ *
+ * The cache holds positions rather than pointers, which stay valid when the
+ * files add keys. Since keys are never removed, a lookup can only change its
+ * result when a layer is replaced or the number of keys grows, which empties
+ * the cache.
+ */
+struct ini_stack {
+  ini_file **files;       /**< Files from the lowest to the highest priority */
+  size_t num_files;       /**< Number of layers */
+  size_t num_keys;        /**< Keys of all files when the cache was filled */
+  size_t num_cache;       /**< Number of used slots in cache */
+  size_t cap_cache;       /**< Number of slots in cache */
+  ini_stack_entry *cache; /**< Section name + key name -> layer and key */
+};
+
+/**
+ * @brief Files that are loaded on worker threads.
+ */
+struct ini_async {
+  char **paths;         /**< Copies of the paths, in one block */
+  size_t num_paths;     /**< Number of paths */
+  ini_options options;  /**< Options of every load */
+  ini_load_cb on_load;  /**< Callback for every file, may be NULL */
+  void *user;           /**< Pointer passed to the callback */
+  ini_file **results;   /**< Loaded files, NULL until loaded */
+  volatile long next;   /**< Number of paths taken by the workers */
+  volatile long done;   /**< Number of files whose callback has returned */
+  size_t num_threads;   /**< Number of started workers */
+  int joined;           /**< Set once the workers have been joined */
+#if defined(INILOAD_ENABLE_THREADS) && defined(INILOAD_WIN32)
+  HANDLE *threads; /**< Workers */
+#elif defined(INILOAD_ENABLE_THREADS)
+  pthread_t *threads; /**< Workers */
+#endif
+#ifdef INILOAD_POSIX
+  int pipe_fds[2]; /**< Pipe written to once all files are loaded */
+#endif
+};
+
+/**
+ * @brief State of the parser between two characters.
+ */
+typedef enum ini_parse_state {
+  INIPS_NONE,
+  INIPS_COMMENT,
+  INIPS_SECTION_NAME,
+  INIPS_AFTER_SECTION_NAME,
+  INIPS_KEY_NAME,
+  INIPS_AFTER_KEY_NAME,
+  INIPS_BEFORE_KEY_VALUE,
+  INIPS_QUOTED_VALUE,
+  INIPS_NON_QUOTED_VALUE,
+  INIPS_AFTER_KEY_VALUE
+} ini_parse_state;
+
+/**
+ * @brief Streaming parser, the state machine of the buffer parser with the
+ * current names and value copied out of the chunks.
+ */
+struct ini_parser {
+  ini_section_cb on_section; /**< Callback for section headers */
+  ini_key_cb on_key;         /**< Callback for keys */
+  void *user;                /**< Pointer passed to the callbacks */
+  ini_parse_state state;     /**< State after the last character */
+  int failed;                /**< Set after an error until the next text */
+  int has_section;           /**< Whether a section has been reported */
+  size_t name_len;           /**< Length of the section or key name */
+  size_t value_len;          /**< Length of the value */
+  size_t value_cap;          /**< Capacity of value */
+  char *value;               /**< Value that is being read */
+  char section[INILOAD_NAME_MAXLEN + 1]; /**< Name of the current section */
+  char name[INILOAD_NAME_MAXLEN + 1];    /**< Name that is being read */
+};
+
+/**
+ * @brief Output of ini_save() and ini_save_mem(), formatted into one buffer.
+ */
+typedef struct ini_writer {
+  char *buf;   /**< Buffer receiving the text */
+  size_t size; /**< Size of the buffer, without room for a NUL character */
+  size_t pos;  /**< Number of bytes in the buffer */
+  size_t len;  /**< Length of the whole text */
+  FILE *f;     /**< File the buffer is written to when full, NULL to cut */
+  int error;   /**< Set if writing to the file failed */
+} ini_writer;
+
+/* Sequentially consistent atomic operations for the live files and the
+ * workers of ini_load_async(). Without them there is no ini_live and no
+ * worker, and the plain accesses are only made by one thread. */
+void *__ini_atomic_load_ptr(void *volatile *ptr) {
+#if defined(__GNUC__)
+  return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+#elif defined(_MSC_VER)
+  return InterlockedCompareExchangePointer(ptr, NULL, NULL);
+#else
+  return *ptr;
+#endif
+}
+
+void *__ini_atomic_swap_ptr(void *volatile *ptr, void *val) {
+#if defined(__GNUC__)
+  return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
+#elif defined(_MSC_VER)
+  return InterlockedExchangePointer(ptr, val);
+#else
+  void *old = *ptr;
+  *ptr = val;
+  return old;
+#endif
+}
+
+long __ini_atomic_load(volatile long *ptr) {
+#if defined(__GNUC__)
+  return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+#elif defined(_MSC_VER)
+  return InterlockedCompareExchange(ptr, 0, 0);
+#else
+  return *ptr;
+#endif
+}
+
+long __ini_atomic_swap(volatile long *ptr, long val) {
+#if defined(__GNUC__)
+  return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
+#elif defined(_MSC_VER)
+  return InterlockedExchange(ptr, val);
+#else
+  long old = *ptr;
+  *ptr = val;
+  return old;
+#endif
+}
+
+/* Returns the new value */
+long __ini_atomic_add(volatile long *ptr, long val) {
+#if defined(__GNUC__)
+  return __atomic_add_fetch(ptr, val, __ATOMIC_SEQ_CST);
+#elif defined(_MSC_VER)
+  return InterlockedExchangeAdd(ptr, val) + val;
+#else
+  return (*ptr += val);
+#endif
+}
+
+void __ini_yield(void) {
+#if defined(INILOAD_POSIX)
+  sched_yield();
+#elif defined(INILOAD_WIN32)
+  SwitchToThread();
+#endif
+}
+
+#ifdef INILOAD_ENABLE_STATS
+/* Wall-clock time in seconds from an arbitrary origin */
+double __ini_now(void) {
+#if defined(INILOAD_WIN32)
+  LARGE_INTEGER count, freq;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&freq);
+  return (double)count.QuadPart / (double)freq.QuadPart;
+#elif defined(INILOAD_POSIX)
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/* Increments a lookup counter, which the threads reading a file share.
+ * Relaxed atomic operations suffice since nothing is ordered by the counts;
+ * without any, there is no ini_live to read a file from several threads. */
+void __ini_count(size_t *counter) {
+#if defined(__GNUC__)
+  __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+#elif defined(_MSC_VER) && defined(_WIN64)
+  InterlockedIncrement64((volatile LONG64 *)counter);
+#elif defined(_MSC_VER)
+  InterlockedIncrement((volatile LONG *)counter);
+#else
+  (*counter)++;
+#endif
+}
+
+/* Reads a lookup counter that other threads may be incrementing */
+size_t __ini_count_read(const size_t *counter) {
+#if defined(__GNUC__)
+  return __atomic_load_n(counter, __ATOMIC_RELAXED);
+#else
+  return *(const volatile size_t *)counter;
+#endif
+}
+
+/* Counts a lookup by name and returns the key that it found */
+ini_key *__ini_count_lookup(ini_file *ini, ini_key *key, size_t *calls,
+                            size_t *misses) {
+  __ini_count(calls);
+  if (key == NULL) {
+    __ini_count(misses);
+  } else if (ini->image == NULL) {
+    __ini_count(&key->lookups);
+  }
+  return key;
+}
+
+#define INILOAD_NOW() __ini_now()
+#define INILOAD_COUNT_TIME(ini, field, start)                                  \
+  ((ini)->stats.field += __ini_now() - (start))
+#define INILOAD_COUNT_BYTES(ini, len) ((ini)->stats.bytes_read += (len))
+#define INILOAD_COUNT_ALLOC(ini, size, grow)                                   \
+  ((ini)->stats.num_allocs++, (ini)->stats.alloc_bytes += (size),              \
+   (ini)->stats.num_grows += (grow))
+#define INILOAD_COUNT_LOOKUP(ini, key, getter)                                 \
+  __ini_count_lookup(ini, key, &(ini)->stats.getter##_calls,                   \
+                     &(ini)->stats.getter##_misses)
+#else
+/* The counters compile to nothing */
+#define INILOAD_NOW() 0.0
+#define INILOAD_COUNT_TIME(ini, field, start) ((void)(start))
+#define INILOAD_COUNT_BYTES(ini, len) ((void)0)
+#define INILOAD_COUNT_ALLOC(ini, size, grow) ((void)0)
+#define INILOAD_COUNT_LOOKUP(ini, key, getter) (key)
+#endif
+
+/* Creates an arena in a caller-supplied buffer or, if buf is NULL, in a newly
+ * allocated block of the given size */
+ini_arena *__ini_arena_create(void *buf, size_t size) {
+  ini_arena_block *block;
+  ini_arena *arena;
+  size_t pad;
+  if (buf == NULL) {
+    block = (ini_arena_block *)INILOAD_MALLOC(size);
+    if (block == NULL) {
+      return NULL;
+    }
+    block->owned = 1;
+  } else {
+    /* Make sure the block starts properly aligned */
+    pad = (sizeof(ini_max_align) - (size_t)buf % sizeof(ini_max_align)) %
+          sizeof(ini_max_align);
+    if (size < pad + INILOAD_ALIGN(sizeof(ini_arena_block)) +
+                   INILOAD_ALIGN(sizeof(ini_arena))) {
+      return NULL;
+    }
+    block = (ini_arena_block *)((char *)buf + pad);
+    size -= pad;
+    block->owned = 0;
+  }
+  block->next = NULL;
+  block->size = size;
+  block->used = INILOAD_ALIGN(sizeof(ini_arena_block)) +
+                INILOAD_ALIGN(sizeof(ini_arena));
+  arena = (ini_arena *)((char *)block + INILOAD_ALIGN(sizeof(ini_arena_block)));
+  arena->head = block;
+  arena->last = NULL;
+  return arena;
+}
+
+void __ini_arena_free(ini_arena *arena) {
+  ini_arena_block *block = arena->head;
+  ini_arena_block *next;
+  /* The arena itself lives in the first block, so it is freed last */
+  while (block != NULL) {
+    next = block->next;
+    if (block->owned) {
+      INILOAD_FREE(block);
+    }
+    block = next;
+  }
+}
+
+void *__ini_malloc(ini_arena *arena, size_t size) {
+  ini_arena_block *block;
+  size_t block_size;
+  if (arena == NULL) {
+    return INILOAD_MALLOC(size);
+  }
+  size = INILOAD_ALIGN(size);
+  if (arena->head->size - arena->head->used < size) {
+    /* Only arenas that allocated their first block themselves can grow */
+    if (!arena->head->owned) {
+      return NULL;
+    }
+    block_size = arena->head->size * 2;
+    while (block_size - INILOAD_ALIGN(sizeof(ini_arena_block)) < size) {
+      block_size *= 2;
+    }
+    block = (ini_arena_block *)INILOAD_MALLOC(block_size);
+    if (block == NULL) {
+      return NULL;
+    }
+    block->next = arena->head;
+    block->size = block_size;
+    block->used = INILOAD_ALIGN(sizeof(ini_arena_block));
+    block->owned = 1;
+    arena->head = block;
+  }
+  arena->last = (char *)arena->head + arena->head->used;
+  arena->head->used += size;
+  return arena->last;
+}
+
+void *__ini_realloc(ini_arena *arena, void *ptr, size_t old_size,
+                    size_t new_size) {
+  void *ptr_new;
+  size_t used;
+  if (arena == NULL) {
+    return INILOAD_REALLOC(ptr, new_size);
+  }
+  if (ptr != NULL && ptr == arena->last) {
+    /* The most recent allocation can grow in place if the block has room */
+    used = (size_t)(arena->last - (char *)arena->head);
+    if (arena->head->size - used >= INILOAD_ALIGN(new_size)) {
+      arena->head->used = used + INILOAD_ALIGN(new_size);
+      return ptr;
+    }
+  }
+  ptr_new = __ini_malloc(arena, new_size);
+  if (ptr_new != NULL && ptr != NULL) {
+    memcpy(ptr_new, ptr, old_size < new_size ? old_size : new_size);
+  }
+  return ptr_new;
+}
+
+void __ini_mfree(ini_arena *arena, void *ptr) {
+  /* Arena memory is only released all at once */
+  if (arena == NULL) {
+    INILOAD_FREE(ptr);
+  }
+}
+
+/* Makes room for len more bytes in the string pool. Returns 1 on success and
+ * 0 on an allocation error. */
+int __ini_pool_reserve(ini_file *ini, size_t len) {
+  size_t new_cap = (ini->cap_pool == 0 ? 256 : ini->cap_pool);
+  char *ptr_pool_new;
+  while (ini->size_pool + len > new_cap) {
+    new_cap *= 2;
+  }
+  if (new_cap != ini->cap_pool) {
+    ptr_pool_new = (char *)__ini_realloc(ini->arena, ini->ptr_pool,
+                                         ini->cap_pool, new_cap);
+    if (ptr_pool_new == NULL) {
+      return 0;
+    }
+    INILOAD_COUNT_ALLOC(ini, new_cap, ini->cap_pool != 0);
+    ini->ptr_pool = ptr_pool_new;
+    ini->cap_pool = new_cap;
+  }
+  return 1;
+}
+
+/* Copies a string into the pool and returns its offset there,
+ * (size_t)-1 if there was an allocation error. With INI_LOAD_ZERO_COPY the
+ * pool is the text of the file: str must then point into it (or be empty)
+ * and is NUL-terminated in place. */
+size_t __ini_pool_add(ini_file *ini, const char *str, size_t len) {
+  size_t off;
+  if (ini->flags & INI_LOAD_ZERO_COPY) {
+    if (len == 0) {
+      /* The text is followed by a NUL character */
+      return ini->size_pool;
+    }
+    off = (size_t)(str - ini->ptr_pool);
+    ini->ptr_pool[off + len] = '\0';
+    return off;
+  }
+  if (!__ini_pool_reserve(ini, len + 1)) {
+    return (size_t)-1;
+  }
+  off = ini->size_pool;
+  memcpy(ini->ptr_pool + off, str, len);
+  ini->ptr_pool[off + len] = '\0';
+  ini->size_pool += len + 1;
+  return off;
+}
+
+#define INILOAD_HASH_SEED 2166136261UL
+
+/* 32-bit FNV-1a, continued from a given hash value */
+unsigned long __ini_hash(unsigned long hash, const char *str) {
+  while (*str != '\0') {
+    hash = ((hash ^ (unsigned char)*str++) * 16777619UL) & 0xffffffffUL;
+  }
+  return hash;
+}
+
+/* The same hash for a string of a given length */
+unsigned long __ini_hash_len(unsigned long hash, const char *str, size_t len) {
+  size_t i;
+  for (i = 0; i < len; i++) {
+    hash = ((hash ^ (unsigned char)str[i]) * 16777619UL) & 0xffffffffUL;
+  }
+  return hash;
+}
+
+/* Key hashes continue the section's hash past a ']' separator, which can not
+ * be part of a name */
+unsigned long __ini_hash_key(unsigned long section_hash, const char *key_name) {
+  section_hash = ((section_hash ^ (unsigned char)']') * 16777619UL) &
+                 0xffffffffUL;
+  return __ini_hash(section_hash, key_name);
+}
+
+unsigned long __ini_hash_key_len(unsigned long section_hash,
+                                 const char *key_name, size_t len) {
+  section_hash = ((section_hash ^ (unsigned char)']') * 16777619UL) &
+                 0xffffffffUL;
+  return __ini_hash_len(section_hash, key_name, len);
+}
+
+/* Number of slots that an index grows to for n entries */
+size_t __ini_index_size(size_t n) {
+  size_t cap = INILOAD_INITIAL_CAP * 2;
+  if (n == 0) {
+    return 0;
+  }
+  while (cap < n * 2) {
+    cap *= 2;
+  }
+  return cap;
+}
+
+/* Bits of the key filter per slot of the key index, a power of two so that
+ * the filter has a power of two words like the index has slots */
+#ifndef INILOAD_FILTER_SLOT_BITS
+#define INILOAD_FILTER_SLOT_BITS 8
+#endif
+
+#if INILOAD_FILTER_SLOT_BITS < 1 ||                                            \
+    (INILOAD_FILTER_SLOT_BITS & (INILOAD_FILTER_SLOT_BITS - 1)) != 0
+#error "INILOAD_FILTER_SLOT_BITS must be a power of two"
+#endif
+
+#define INILOAD_FILTER_WORD_BITS (sizeof(unsigned long) * CHAR_BIT)
+
+/* The low bits of a key hash select its word of the key filter. The bits it
+ * sets in the word come from the high bits of the hash multiplied by the
+ * golden ratio, which depend on all of its bits, so that they do not repeat
+ * the word's index however many words the filter has. */
+#define INILOAD_FILTER_MIX(hash) (((hash) * 2654435761UL) & 0xffffffffUL)
+#define INILOAD_FILTER_BITS(hash)                                              \
+  ((1UL << ((INILOAD_FILTER_MIX(hash) >> 26) &                                 \
+            (INILOAD_FILTER_WORD_BITS - 1))) |                                 \
+   (1UL << ((INILOAD_FILTER_MIX(hash) >> 20) &                                 \
+            (INILOAD_FILTER_WORD_BITS - 1))))
+
+/* Number of words of the key filter for a key index of cap slots */
+size_t __ini_filter_size(size_t cap) {
+  size_t words = cap * INILOAD_FILTER_SLOT_BITS / INILOAD_FILTER_WORD_BITS;
+  return (words > 0 ? words : 1);
+}
+
+/* Checks the key filter, returns 0 if no key in the index has the hash and
+ * 1 if one may have it. Most lookups of missing keys stop here without
+ * reading the index or the keys. */
+int __ini_filter_test(const ini_file *ini, unsigned long hash) {
+  unsigned long bits;
+  if (ini->key_filter == NULL) {
+    return 1;
+  }
+  bits = INILOAD_FILTER_BITS(hash);
+  return (ini->key_filter[hash & (ini->cap_key_filter - 1)] & bits) == bits;
+}
+
+/* Sizes the key filter for the key index and sets the bits of all its keys.
+ * On failure the file is left without a filter. */
+int __ini_filter_build(ini_file *ini) {
+  size_t cap = __ini_filter_size(ini->cap_key_index);
+  size_t i;
+  if (cap != ini->cap_key_filter) {
+    __ini_mfree(ini->arena, ini->key_filter);
+    ini->key_filter = (unsigned long *)__ini_malloc(
+        ini->arena, sizeof(unsigned long) * cap);
+    ini->cap_key_filter = 0;
+    if (ini->key_filter == NULL) {
+      return 0;
+    }
+    INILOAD_COUNT_ALLOC(ini, sizeof(unsigned long) * cap, 0);
+    ini->cap_key_filter = cap;
+  }
+  memset(ini->key_filter, 0, sizeof(unsigned long) * cap);
+  ini->num_filter_stale = 0;
+  for (i = 0; i < ini->cap_key_index; i++) {
+    if (ini->key_index[i].section != 0) {
+      ini->key_filter[ini->key_index[i].hash & (cap - 1)] |=
+          INILOAD_FILTER_BITS(ini->key_index[i].hash);
+    }
+  }
+  return 1;
+}
+
+/* Doubles the number of slots of an index, reinserting the used ones */
+int __ini_index_grow(ini_arena *arena, ini_index_entry **index, size_t *cap) {
+  size_t new_cap = (*cap == 0 ? INILOAD_INITIAL_CAP * 2 : *cap * 2);
+  size_t i, j;
+  ini_index_entry *new_index = (ini_index_entry *)__ini_malloc(
+      arena, sizeof(ini_index_entry) * new_cap);
+  if (new_index == NULL) {
+    return 0;
+  }
+  memset(new_index, 0, sizeof(ini_index_entry) * new_cap);
+  for (i = 0; i < *cap; i++) {
+    if ((*index)[i].section != 0) {
+      j = (*index)[i].hash & (new_cap - 1);
+      while (new_index[j].section != 0) {
+        j = (j + 1) & (new_cap - 1);
+      }
+      new_index[j] = (*index)[i];
+    }
+  }
+  __ini_mfree(arena, *index);
+  *index = new_index;
+  *cap = new_cap;
+  return 1;
+}
+
+ini_section *__ini_find_section(ini_file *ini, const char *section_name) {
+  unsigned long hash;
+  size_t i;
+  ini_section *section;
+  if (ini->cap_section_index == 0) {
+    return NULL;
+  }
+  hash = __ini_hash(INILOAD_HASH_SEED, section_name);
+  i = hash & (ini->cap_section_index - 1);
+  while (ini->section_index[i].section != 0) {
+    if (ini->section_index[i].hash == hash) {
+      section = &ini->ptr_sections[ini->section_index[i].section - 1];
+      if (strcmp(ini->ptr_pool + section->name_off, section_name) == 0) {
+        return section;
+      }
+    }
+    i = (i + 1) & (ini->cap_section_index - 1);
+  }
+  return NULL;
+}
+
+/* Returns the position plus one of the section with a name of a given length
+ * and hash, 0 if there is none */
+size_t __ini_find_section_len(ini_file *ini, const char *section_name,
+                              size_t name_len, unsigned long hash) {
+  size_t i;
+  ini_section *section;
+  if (ini->cap_section_index == 0) {
+    return 0;
+  }
+  i = hash & (ini->cap_section_index - 1);
+  while (ini->section_index[i].section != 0) {
+    if (ini->section_index[i].hash == hash) {
+      section = &ini->ptr_sections[ini->section_index[i].section - 1];
+      if (section->name_len == name_len &&
+          memcmp(ini->ptr_pool + section->name_off, section_name, name_len) ==
+              0) {
+        return ini->section_index[i].section;
+      }
+    }
+    i = (i + 1) & (ini->cap_section_index - 1);
+  }
+  return 0;
+}
+
+/* Returns the key of section s with a name of a given length and hash, NULL
+ * if there is none */
+ini_key *__ini_find_key(ini_file *ini, size_t s, const char *key_name,
+                        size_t name_len, unsigned long hash) {
+  size_t i;
+  ini_key *key;
+  if (ini->cap_key_index == 0 || !__ini_filter_test(ini, hash)) {
+    return NULL;
+  }
+  i = hash & (ini->cap_key_index - 1);
+  while (ini->key_index[i].section != 0) {
+    if (ini->key_index[i].hash == hash && ini->key_index[i].section == s + 1) {
+      key = &ini->ptr_sections[s].ptr_keys[ini->key_index[i].key];
+      if (key->name_len == name_len &&
+          memcmp(ini->ptr_pool + key->name_off, key_name, name_len) == 0) {
+        return key;
+      }
+    }
+    i = (i + 1) & (ini->cap_key_index - 1);
+  }
+  return NULL;
+}
+
+/* Adds section s with the given hash to the index unless a section with the
+ * same name is already there, the first one then keeps being found */
+int __ini_index_put_section(ini_file *ini, unsigned long hash, size_t s) {
+  size_t i;
+  ini_section *other;
+  if ((ini->num_section_index + 1) * 2 > ini->cap_section_index) {
+    if (!__ini_index_grow(ini->arena, &ini->section_index,
+                          &ini->cap_section_index)) {
+      return 0;
+    }
+    INILOAD_COUNT_ALLOC(ini, sizeof(ini_index_entry) * ini->cap_section_index,
+                        ini->cap_section_index > INILOAD_INITIAL_CAP * 2);
+  }
+  i = hash & (ini->cap_section_index - 1);
+  while (ini->section_index[i].section != 0) {
+    other = &ini->ptr_sections[ini->section_index[i].section - 1];
+    if (ini->section_index[i].hash == hash &&
+        strcmp(ini->ptr_pool + other->name_off,
+               ini->ptr_pool + ini->ptr_sections[s].name_off) == 0) {
+      return 1;
+    }
+    i = (i + 1) & (ini->cap_section_index - 1);
+  }
+  ini->section_index[i].hash = hash;
+  ini->section_index[i].section = s + 1;
+  ini->section_index[i].key = 0;
+  ini->num_section_index++;
+  return 1;
+}
+
+/* Adds key k of section s with the given hash to the index unless the same key
+ * of a section with the same name is already there, the first one then keeps
+ * being found */
+int __ini_index_put_key(ini_file *ini, unsigned long hash, size_t s,
+                        size_t k) {
+  const char *section_name = ini->ptr_pool + ini->ptr_sections[s].name_off;
+  const char *key_name =
+      ini->ptr_pool + ini->ptr_sections[s].ptr_keys[k].name_off;
+  ini_section *other;
+  size_t i;
+  if ((ini->num_key_index + 1) * 2 > ini->cap_key_index) {
+    if (!__ini_index_grow(ini->arena, &ini->key_index, &ini->cap_key_index)) {
+      return 0;
+    }
+    INILOAD_COUNT_ALLOC(ini, sizeof(ini_index_entry) * ini->cap_key_index,
+                        ini->cap_key_index > INILOAD_INITIAL_CAP * 2);
+  }
+  if (ini->cap_key_filter != __ini_filter_size(ini->cap_key_index) &&
+      !__ini_filter_build(ini)) {
+    /* The index was grown or replaced */
+    return 0;
+  }
+  i = hash & (ini->cap_key_index - 1);
+  while (ini->key_index[i].section != 0) {
+    if (ini->key_index[i].hash == hash) {
+      other = &ini->ptr_sections[ini->key_index[i].section - 1];
+      if (strcmp(ini->ptr_pool + other->name_off, section_name) == 0 &&
+          strcmp(ini->ptr_pool +
+                     other->ptr_keys[ini->key_index[i].key].name_off,
+                 key_name) == 0) {
+        return 1;
+      }
+    }
+    i = (i + 1) & (ini->cap_key_index - 1);
+  }
+  ini->key_index[i].hash = hash;
+  ini->key_index[i].section = s + 1;
+  ini->key_index[i].key = k;
+  ini->num_key_index++;
+  ini->key_filter[hash & (ini->cap_key_filter - 1)] |=
+      INILOAD_FILTER_BITS(hash);
+  return 1;
+}
+
+/* Removes key k of section s with the given hash from the index, moving the
+ * later entries of its run back so that no lookup stops at the hole. Its bits
+ * stay in the filter until the filter is rebuilt. */
+void __ini_index_remove_key(ini_file *ini, unsigned long hash, size_t s,
+                            size_t k) {
+  ini_index_entry *index = ini->key_index;
+  size_t mask = ini->cap_key_index - 1;
+  size_t i, j, home;
+  if (ini->cap_key_index == 0) {
+    return;
+  }
+  i = hash & mask;
+  while (index[i].section != 0 &&
+         (index[i].section != s + 1 || index[i].key != k)) {
+    i = (i + 1) & mask;
+  }
+  if (index[i].section == 0) {
+    return;
+  }
+  for (j = (i + 1) & mask; index[j].section != 0; j = (j + 1) & mask) {
+    /* The entry at j may fill the hole unless it is found between the two */
+    home = index[j].hash & mask;
+    if (i < j ? (home <= i || home > j) : (home <= i && home > j)) {
+      index[i] = index[j];
+      i = j;
+    }
+  }
+  index[i].section = 0;
+  ini->num_key_index--;
+  ini->num_filter_stale++;
+}
+
+/* Makes room for one more section */
+int __ini_grow_sections(ini_file *ini) {
+  ini_section *ptr_sec_new;
+  if (ini->num_sections == ini->cap_sections) {
+    /* Allocate more memory to add a new section */
+    ptr_sec_new = (ini_section *)__ini_realloc(
+        ini->arena, ini->ptr_sections, sizeof(ini_section) * ini->cap_sections,
+        sizeof(ini_section) * (ini->cap_sections * 2));
+    if (ptr_sec_new == NULL) {
+      return 0;
+    }
+    INILOAD_COUNT_ALLOC(ini, sizeof(ini_section) * (ini->cap_sections * 2), 1);
+    ini->ptr_sections = ptr_sec_new;
+    ini->cap_sections = ini->cap_sections * 2;
+  }
+  return 1;
+}
+
+/* Returns the section with the given name, which is added unless a section
+ * with the same name was seen before: repeated headers add to that one */
+ini_section *__ini_add_section(ini_file *ini, const char *section_name,
+                               size_t name_len) {
+  ini_key *ptr_keys = NULL;
+  ini_section *section;
+  size_t name_off;
+  size_t s;
+  size_t cap = ini->cap_new_keys;
+  unsigned long hash =
+      __ini_hash_len(INILOAD_HASH_SEED, section_name, name_len);
+  if (ini->hint_pos < ini->num_key_hints) {
+    /* Counted before parsing, an empty section still gets one key */
+    cap = (ini->key_hints[ini->hint_pos] > 0 ? ini->key_hints[ini->hint_pos]
+                                             : 1);
+  }
+  s = __ini_find_section_len(ini, section_name, name_len, hash);
+  if (s != 0) {
+    section = &ini->ptr_sections[s - 1];
+    if (ini->hint_pos < ini->num_key_hints &&
+        section->num_keys + cap > section->cap_keys) {
+      /* Room for the keys that the repeated header adds */
+      ptr_keys = (ini_key *)__ini_realloc(
+          ini->arena, section->ptr_keys, sizeof(ini_key) * section->cap_keys,
+          sizeof(ini_key) * (section->num_keys + cap));
+      if (ptr_keys == NULL) {
+        return NULL;
+      }
+      INILOAD_COUNT_ALLOC(ini, sizeof(ini_key) * (section->num_keys + cap), 1);
+      section->ptr_keys = ptr_keys;
+      section->cap_keys = section->num_keys + cap;
+    }
+    return section;
+  }
+  if (!__ini_grow_sections(ini)) {
+    return NULL;
+  }
+
+  name_off = __ini_pool_add(ini, section_name, name_len);
+  if (name_off == (size_t)-1) {
+    return NULL;
+  }
+  ini->ptr_sections[ini->num_sections].name_off = name_off;
+  ini->ptr_sections[ini->num_sections].name_len = name_len;
+  ini->ptr_sections[ini->num_sections].hash = hash;
+  ini->ptr_sections[ini->num_sections].num_keys = 0;
+  ini->ptr_sections[ini->num_sections].cap_keys = cap;
+  ini->ptr_sections[ini->num_sections].span_hash[0] = 0;
+  ini->ptr_sections[ini->num_sections].span_hash[1] = 0;
+  ini->ptr_sections[ini->num_sections].span_len = 0;
+  ini->ptr_sections[ini->num_sections].pool_len = 0;
+  ptr_keys = (ini_key *)__ini_malloc(ini->arena, sizeof(ini_key) * cap);
+  if (ptr_keys == NULL) {
+    return NULL;
+  }
+  INILOAD_COUNT_ALLOC(ini, sizeof(ini_key) * cap, 0);
+  ini->ptr_sections[ini->num_sections].ptr_keys = ptr_keys;
+  ini->num_sections++;
+  if (!__ini_index_put_section(ini, hash, ini->num_sections - 1)) {
+    return NULL;
+  }
+  return &(ini->ptr_sections[ini->num_sections - 1]);
+}
+
+#define INILOAD_INT64_MAX ((ini_int64)(~(ini_uint64)0 >> 1))
+#define INILOAD_INT64_MIN (-INILOAD_INT64_MAX - 1)
+
+/* Converts the magnitude of an integer the way strtol does, clamping
+ * the values that do not fit into 64 bits */
+ini_int64 __ini_clamp_int64(ini_uint64 u, int neg, int overflow) {
+  if (neg) {
+    if (overflow || u > (ini_uint64)INILOAD_INT64_MAX + 1) {
+      return INILOAD_INT64_MIN;
+    }
+    return (u == 0 ? 0 : -(ini_int64)(u - 1) - 1);
+  }
+  if (overflow || u > (ini_uint64)INILOAD_INT64_MAX) {
+    return INILOAD_INT64_MAX;
+  }
+  return (ini_int64)u;
+}
+
+ini_key_type __ini_classify(const char *str, ini_int64 *int_val,
+                            double *float_val);
+
+/* Falls back to the libc conversions for the rare forms that the fast path
+ * does not handle (hexadecimal floats, inf, nan, long mantissas, ...) */
+ini_key_type __ini_classify_slow(const char *str, ini_int64 *int_val,
+                                 double *float_val) {
+  const char *p;
+  char *endptr;
+  for (p = str; *p == ' ' || (*p >= '\t' && *p <= '\r'); p++) {
+  }
+  if (p != str && *p != '\0') {
+    /* Leading white space is skipped like strtol does, the number itself
+     * may need the full width */
+    return __ini_classify(p, int_val, float_val);
+  }
+  *int_val = strtol(str, &endptr, 0);
+  if (*endptr == '\0') {
+    return INI_KEY_INT;
+  }
+  /* Have to use strtod instead of the (yet) unsupported strtof */
+  *float_val = strtod(str, &endptr);
+  if (*endptr == '\0') {
+    return INI_KEY_FLOAT;
+  }
+  return INI_KEY_STRING;
+}
+
+/**
+ * @brief Guesses the type of an unquoted value and converts it
+ *
+ * Accepts what strtol(str, &end, 0) and then strtod accept, in a single pass
+ * over the text. Decimal floats with up to 15 significant digits and a small
+ * exponent are exact in double precision and are computed directly, with
+ * the same result as strtod; other numbers are handed to strtod.
+ *
+ * @param str NUL-terminated value
+ * @param int_val Receives the value of an integer, clamped to 64 bits
+ * @param float_val Receives the value of a floating point number
+ * @return INI_KEY_INT, INI_KEY_FLOAT or INI_KEY_STRING, before the width of
+ * the number is looked at
+ */
+ini_key_type __ini_classify(const char *str, ini_int64 *int_val,
+                            double *float_val) {
+  static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                 1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                 1e18, 1e19, 1e20, 1e21, 1e22};
+  const char *p = str;
+  const char *digits;
+  double mantissa = 0.0;
+  ini_uint64 u;
+  unsigned int d;
+  int neg = 0;
+  int overflow = 0;
+  int num_digits = 0;
+  int has_digits;
+  int is_float = 0;
+  int octal = 1;
+  long int exponent = 0;
+  long int exp_val;
+  int exp_neg;
+  double value;
+
+  if (*p == '+' || *p == '-') {
+    neg = (*p == '-');
+    p++;
+  }
+
+  if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+    /* Hexadecimal integer, anything else after the prefix is left to libc */
+    u = 0;
+    for (digits = p + 2;; digits++) {
+      if (*digits >= '0' && *digits <= '9') {
+        d = (unsigned int)(*digits - '0');
+      } else if (*digits >= 'a' && *digits <= 'f') {
+        d = (unsigned int)(*digits - 'a' + 10);
+      } else if (*digits >= 'A' && *digits <= 'F') {
+        d = (unsigned int)(*digits - 'A' + 10);
+      } else {
+        break;
+      }
+      if (u > (~(ini_uint64)0 >> 4)) {
+        overflow = 1;
+      }
+      u = (u << 4) | d;
+    }
+    if (digits == p + 2 || *digits != '\0') {
+      return __ini_classify_slow(str, int_val, float_val);
+    }
+    *int_val = __ini_clamp_int64(u, neg, overflow);
+    return INI_KEY_INT;
+  }
+
+  if (!((*p >= '0' && *p <= '9') || *p == '.')) {
+    if (*p == '\0' || *p == 'i' || *p == 'I' || *p == 'n' || *p == 'N' ||
+        *p == ' ' || (*p >= '\t' && *p <= '\r')) {
+      /* Empty, infinity, NaN or leading white space */
+      return __ini_classify_slow(str, int_val, float_val);
+    }
+    return INI_KEY_STRING;
+  }
+
+  /* Integer part, kept both as an exact integer and as a float mantissa */
+  u = 0;
+  digits = p;
+  for (; *p >= '0' && *p <= '9'; p++) {
+    d = (unsigned int)(*p - '0');
+    if (d > 7) {
+      octal = 0;
+    }
+    if (u > (~(ini_uint64)0 - d) / 10) {
+      overflow = 1;
+    }
+    u = u * 10 + d;
+    if (num_digits > 0 || d != 0) {
+      mantissa = mantissa * 10 + d;
+      num_digits++;
+    }
+  }
+  has_digits = (p != digits);
+
+  if (*p == '.') {
+    /* Fractional part, leading zeros only move the exponent */
+    is_float = 1;
+    for (p++; *p >= '0' && *p <= '9'; p++) {
+      d = (unsigned int)(*p - '0');
+      if (num_digits > 0 || d != 0) {
+        mantissa = mantissa * 10 + d;
+        num_digits++;
+      }
+      exponent--;
+      has_digits = 1;
+    }
+  }
+  if (!has_digits) {
+    /* A lone dot */
+    return INI_KEY_STRING;
+  }
+
+  if (*p == 'e' || *p == 'E') {
+    p++;
+    exp_neg = 0;
+    if (*p == '+' || *p == '-') {
+      exp_neg = (*p == '-');
+      p++;
+    }
+    if (!(*p >= '0' && *p <= '9')) {
+      return INI_KEY_STRING;
+    }
+    for (exp_val = 0; *p >= '0' && *p <= '9'; p++) {
+      if (exp_val < 100000) {
+        exp_val = exp_val * 10 + (*p - '0');
+      }
+    }
+    exponent += (exp_neg ? -exp_val : exp_val);
+    is_float = 1;
+  }
+
+  if (*p != '\0') {
+    return INI_KEY_STRING;
+  }
+
+  if (!is_float && (digits[0] != '0' || octal)) {
+    if (digits[0] == '0') {
+      /* Octal integer, the digits are reread in base 8 */
+      for (u = 0, overflow = 0; *digits != '\0'; digits++) {
+        if (u > (~(ini_uint64)0 >> 3)) {
+          overflow = 1;
+        }
+        u = (u << 3) | (unsigned int)(*digits - '0');
+      }
+    }
+    *int_val = __ini_clamp_int64(u, neg, overflow);
+    return INI_KEY_INT;
+  }
+
+  if (num_digits > 15 || exponent > 22 || exponent < -22) {
+    /* Not exact in double precision */
+    return __ini_classify_slow(str, int_val, float_val);
+  }
+  value = mantissa;
+  value = (exponent < 0 ? value / pow10[-exponent] : value * pow10[exponent]);
+  *float_val = (neg ? -value : value);
+  return INI_KEY_FLOAT;
+}
+
+/* The smallest magnitude that a float conversion rounds to infinity: half
+ * way between FLT_MAX and the next power of two, 2^128 - 2^103 */
+#define INILOAD_FLT_ROUND_MAX 3.4028235677973366e38
+
+/* Stores a converted value, integers that do not fit into an int and finite
+ * numbers that overflow a float get the wide types. Numbers that overflow a
+ * double are infinities and NaN stays NaN, both are floats. Tiny numbers
+ * stay floats too, they round to a subnormal float or zero like any other
+ * number rounds to the nearest float. */
+void __ini_store_number(ini_key *key, ini_key_type type, ini_int64 int_val,
+                        double float_val) {
+  if (type == INI_KEY_INT) {
+    key->value.int_val = int_val;
+    if (int_val < INT_MIN || int_val > INT_MAX) {
+      type = INI_KEY_INT64;
+    }
+  } else if (type == INI_KEY_FLOAT) {
+    key->value.float_val = float_val;
+    if ((float_val >= INILOAD_FLT_ROUND_MAX && float_val <= DBL_MAX) ||
+        (float_val <= -INILOAD_FLT_ROUND_MAX && float_val >= -DBL_MAX)) {
+      type = INI_KEY_DOUBLE;
+    }
+  }
+  key->type = type;
+}
+
+/* Sets a key of a section, a key that was seen before in the section gets
+ * the new value but keeps its place */
+int __ini_add_key(ini_file *ini, ini_section *section, const char *key_name,
+                  size_t name_len, const char *value, size_t value_len,
+                  int quotes) {
+  ini_key *ptr_keys_new;
+  ini_key *key;
+  size_t name_off;
+  size_t string_off;
+  double float_val;
+  ini_int64 int_val;
+  ini_key_type type;
+  size_t s = (size_t)(section - ini->ptr_sections);
+  unsigned long hash = __ini_hash_key_len(section->hash, key_name, name_len);
+  int is_new = 0;
+
+  key = __ini_find_key(ini, s, key_name, name_len, hash);
+  if (key == NULL && section->num_keys == section->cap_keys) {
+    /* Allocate more memory to add a new key */
+    ptr_keys_new = (ini_key *)__ini_realloc(
+        ini->arena, section->ptr_keys, sizeof(ini_key) * section->cap_keys,
+        sizeof(ini_key) * (section->cap_keys * 2));
+    if (ptr_keys_new == NULL) {
+      return 0;
+    }
+    INILOAD_COUNT_ALLOC(ini, sizeof(ini_key) * (section->cap_keys * 2), 1);
+    section->cap_keys = section->cap_keys * 2;
+    section->ptr_keys = ptr_keys_new;
+  }
+
+  if (key == NULL) {
+    key = &section->ptr_keys[section->num_keys];
+    name_off = __ini_pool_add(ini, key_name, name_len);
+    if (name_off == (size_t)-1) {
+      return 0;
+    }
+    key->name_off = name_off;
+    key->name_len = name_len;
+#ifdef INILOAD_ENABLE_STATS
+    key->lookups = 0;
+#endif
+    is_new = 1;
+  }
+
+  /* The value is put into the pool first, which gives the conversion
+   * functions a NUL-terminated string */
+  string_off = __ini_pool_add(ini, value, value_len);
+  if (string_off == (size_t)-1) {
+    return 0;
+  }
+  key->value.string_off = string_off;
+  key->type = INI_KEY_STRING;
+
+  /* Guess the data type of the key, definitely a string if it is quoted */
+  if (!quotes && (ini->flags & INI_LOAD_LAZY)) {
+    /* Left for the first getter */
+    key->type = INI_KEY_LAZY;
+  } else if (!quotes) {
+    type = __ini_classify(ini->ptr_pool + string_off, &int_val, &float_val);
+    __ini_store_number(key, type, int_val, float_val);
+    if (key->type != INI_KEY_STRING && !(ini->flags & INI_LOAD_ZERO_COPY)) {
+      /* Numbers do not need their text, take it back from the pool */
+      ini->size_pool = string_off;
+    }
+  }
+
+  if (!is_new) {
+    return 1;
+  }
+  section->num_keys++;
+  return __ini_index_put_key(ini, hash, s, section->num_keys - 1);
+}
+
+ini_key *__ini_get_key_ptr(ini_file *ini, const char *section_name,
                            const char *key_name) {
-  size_t s, k;
+  unsigned long section_hash, hash;
+  size_t i;
+  ini_section *section;
+  ini_key *key;
+  if (ini->cap_key_index == 0) {
+    return NULL;
+  }
+  section_hash = __ini_hash(INILOAD_HASH_SEED, section_name);
+  hash = __ini_hash_key(section_hash, key_name);
+  if (!__ini_filter_test(ini, hash)) {
+    return NULL;
+  }
+  i = hash & (ini->cap_key_index - 1);
+  while (ini->key_index[i].section != 0) {
+    if (ini->key_index[i].hash == hash) {
+      section = &ini->ptr_sections[ini->key_index[i].section - 1];
+      key = &section->ptr_keys[ini->key_index[i].key];
+      if (strcmp(ini->ptr_pool + section->name_off, section_name) == 0 &&
+          strcmp(ini->ptr_pool + key->name_off, key_name) == 0) {
+        return key;
+      }
+    }
+    i = (i + 1) & (ini->cap_key_index - 1);
+  }
+  return NULL;
+}
+
+/* Converts the value of a key before a getter reads it with INI_LOAD_LAZY.
+ * The text of numbers stays in the pool. */
+void __ini_resolve_key(ini_file *ini, ini_key *key) {
+  ini_int64 int_val;
+  double float_val;
+  ini_key_type type = __ini_classify(ini->ptr_pool + key->value.string_off,
+                                     &int_val, &float_val);
+  __ini_store_number(key, type, int_val, float_val);
+}
+
+/* Allocates an empty ini_file, in a new arena if requested */
+ini_file *__ini_create(const ini_options *options, size_t file_size) {
+  ini_arena *arena = NULL;
+  ini_file *ptr = NULL;
+  if (options != NULL && (options->flags & INI_LOAD_ARENA)) {
+    if (options->arena_buf != NULL) {
+      arena = __ini_arena_create(options->arena_buf, options->arena_size);
+    } else {
+      /* Parsed data rarely exceeds twice the size of the text */
+      arena = __ini_arena_create(NULL, file_size * 2 > INILOAD_ARENA_BLOCK_SIZE
+                                           ? file_size * 2
+                                           : INILOAD_ARENA_BLOCK_SIZE);
+    }
+    if (arena == NULL) {
+      return NULL;
+    }
+  }
+
+  /* Allocate memory for the ini file struct */
+  ptr = (ini_file *)__ini_malloc(arena, sizeof(ini_file));
+  if (ptr == NULL) {
+    if (arena != NULL) {
+      __ini_arena_free(arena);
+    }
+    return NULL;
+  }
+  ptr->flags = (options != NULL ? options->flags : 0);
+  ptr->arena = arena;
+  ptr->num_sections = 0;
+  ptr->cap_sections = 0;
+  ptr->ptr_sections = NULL;
+  ptr->num_section_index = 0;
+  ptr->cap_section_index = 0;
+  ptr->section_index = NULL;
+  ptr->num_key_index = 0;
+  ptr->cap_key_index = 0;
+  ptr->key_index = NULL;
+  ptr->cap_key_filter = 0;
+  ptr->key_filter = NULL;
+  ptr->num_filter_stale = 0;
+  ptr->size_pool = 0;
+  ptr->cap_pool = 0;
+  ptr->ptr_pool = NULL;
+  ptr->incremental = 0;
+  ptr->cap_new_keys = INILOAD_INITIAL_CAP;
+  ptr->key_hints = NULL;
+  ptr->num_key_hints = 0;
+  ptr->hint_pos = 0;
+  ptr->image = NULL;
+  ptr->image_size = 0;
+  ptr->frozen = NULL;
+#ifdef INILOAD_ENABLE_STATS
+  memset(&ptr->stats, 0, sizeof(ini_stats));
+#endif
+  INILOAD_COUNT_ALLOC(ptr, sizeof(ini_file), 0);
+
+  /* Allocate memory for the array of sections */
+  ptr->ptr_sections = (ini_section *)__ini_malloc(
+      arena, sizeof(ini_section) * INILOAD_INITIAL_CAP);
+  if (!ptr->ptr_sections) {
+    ini_free(ptr);
+    return NULL;
+  }
+  INILOAD_COUNT_ALLOC(ptr, sizeof(ini_section) * INILOAD_INITIAL_CAP, 0);
+  ptr->cap_sections = INILOAD_INITIAL_CAP;
+  return ptr;
+}
+
+/* Characters that can change the parser's state inside a comment or a value */
+#define INILOAD_IS_SPECIAL(c)                                                  \
+  (c == '\n' || c == '\r' || c == '\0' || c == '=' || c == '[' || c == ']' ||  \
+   c == '\"' || c == ';' || c == '#')
+
+#if defined(INILOAD_AVX2) || defined(INILOAD_SSE2)
+/* Index of the lowest set bit of a non-zero mask */
+unsigned int __ini_ctz(unsigned int mask) {
+#if defined(__GNUC__)
+  return (unsigned int)__builtin_ctz(mask);
+#elif defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (unsigned int)index;
+#else
+  unsigned int n = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+#endif
+
+/* Returns the position of the first special character at or after i, or len
+ * if there is none. Vector code checks 32 (AVX2) or 16 (SSE2, NEON) bytes at
+ * a time, the remaining bytes are checked one by one. */
+size_t __ini_scan(const char *buf, size_t i, size_t len) {
+  char c;
+#if defined(INILOAD_AVX2)
+  __m256i v, m;
+  unsigned int mask;
+  while (i + 32 <= len) {
+    v = _mm256_loadu_si256((const __m256i *)(buf + i));
+    m = _mm256_or_si256(
+        _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\0')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('=')))),
+        _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('[')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8(']'))),
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\"')),
+                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8(';'))),
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('#')))));
+    mask = (unsigned int)_mm256_movemask_epi8(m);
+    if (mask != 0) {
+      return i + __ini_ctz(mask);
+    }
+    i += 32;
+  }
+#elif defined(INILOAD_SSE2)
+  __m128i v, m;
+  unsigned int mask;
+  while (i + 16 <= len) {
+    v = _mm_loadu_si128((const __m128i *)(buf + i));
+    m = _mm_or_si128(
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))),
+                     _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\0')),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('=')))),
+        _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('[')),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8(']'))),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\"')),
+                                      _mm_cmpeq_epi8(v, _mm_set1_epi8(';'))),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8('#')))));
+    mask = (unsigned int)_mm_movemask_epi8(m);
+    if (mask != 0) {
+      return i + __ini_ctz(mask);
+    }
+    i += 16;
+  }
+#elif defined(INILOAD_NEON)
+  uint8x16_t v, m;
+  while (i + 16 <= len) {
+    v = vld1q_u8((const uint8_t *)(buf + i));
+    m = vorrq_u8(
+        vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')),
+                          vceqq_u8(v, vdupq_n_u8('\r'))),
+                 vorrq_u8(vceqq_u8(v, vdupq_n_u8('\0')),
+                          vceqq_u8(v, vdupq_n_u8('=')))),
+        vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('[')),
+                          vceqq_u8(v, vdupq_n_u8(']'))),
+                 vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('\"')),
+                                   vceqq_u8(v, vdupq_n_u8(';'))),
+                          vceqq_u8(v, vdupq_n_u8('#')))));
+    if (vmaxvq_u8(m) != 0) {
+      /* The scalar loop below finds the exact position */
+      break;
+    }
+    i += 16;
+  }
+#endif
+  while (i < len) {
+    c = buf[i];
+    if (INILOAD_IS_SPECIAL(c)) {
+      break;
+    }
+    i++;
+  }
+  return i;
+}
+
+/* Parse using a state machine/automaton */
+#define IS_SPACE(c) (c == ' ' || c == '\t')
+#define IS_NEWLINE(c) (c == '\r' || c == '\n')
+#define IS_EOF(c) (c == '\0')
+#define IS_NEWLINE_OR_EOF(c) (IS_NEWLINE(c) || IS_EOF(c))
+#define IS_COMMENT(c) (c == ';' || c == '#')
+
+/* Parses len bytes of text. The text is only read, except with
+ * INI_LOAD_ZERO_COPY where it is the string pool and gets NUL-terminated in
+ * place. Returns 1 on success and 0 on a syntax or allocation error. */
+int __ini_parse(ini_file *ini, const char *buf, size_t len) {
+  size_t name_pos = 0;
+  size_t name_len = 0;
+  size_t value_pos = 0;
+  size_t value_len = 0;
+
+  size_t i = 0;
+  size_t skip = 0;
+  char c = 0;
+
+  int alloc_error = 0;
+  int bad_syntax = 0;
+
+  ini_section *curr_section = NULL;
+
+  ini_parse_state state = INIPS_NONE;
+
+  for (i = 0; i < len + 1 && !bad_syntax && !alloc_error; i++) {
+    if (state == INIPS_COMMENT || state == INIPS_QUOTED_VALUE ||
+        state == INIPS_NON_QUOTED_VALUE) {
+      /* Jump over the characters that would not change the state */
+      skip = __ini_scan(buf, i, len) - i;
+      i += skip;
+      if (state != INIPS_COMMENT) {
+        value_len += skip;
+      }
+    }
+    /* The end of the text reads as a NUL character */
+    c = (i < len ? buf[i] : '\0');
+    /*printf("%c <--- %d\n", c, state);*/
+    switch (state) {
+    case INIPS_NONE:
+      if (IS_SPACE(c) || IS_NEWLINE_OR_EOF(c)) {
+        /* Do nothing */
+      } else if (IS_COMMENT(c)) {
+        state = INIPS_COMMENT;
+      } else if (c == '[') {
+        name_pos = i + 1;
+        name_len = 0;
+        state = INIPS_SECTION_NAME;
+      } else {
+        /* Everything else could be a key name */
+        name_pos = i;
+        name_len = 1;
+        state = INIPS_KEY_NAME;
+      }
+      break;
+
+    case INIPS_COMMENT:
+      if (IS_NEWLINE_OR_EOF(c)) {
+        state = INIPS_NONE;
+      } else {
+        /* Do nothing, read the comment */
+      }
+      break;
+
+    case INIPS_SECTION_NAME:
+      if (c == ']') {
+        /* Add the new section */
+        if (name_len > INILOAD_NAME_MAXLEN) {
+          /* Name is too long */
+          bad_syntax = 1;
+          break;
+        }
+        ini->hint_pos++;
+        curr_section = __ini_add_section(ini, buf + name_pos, name_len);
+        if (curr_section == NULL) {
+          alloc_error = 1;
+          break;
+        }
+        state = INIPS_AFTER_SECTION_NAME;
+      } else if (c == '[' || c == '=' || IS_NEWLINE_OR_EOF(c) ||
+                 IS_COMMENT(c)) {
+        bad_syntax = 1;
+      } else {
+        name_len++;
+      }
+      break;
+
+    case INIPS_AFTER_SECTION_NAME:
+      if (IS_NEWLINE_OR_EOF(c)) {
+        state = INIPS_NONE;
+      } else if (IS_SPACE(c)) {
+      } else {
+        bad_syntax = 1;
+      }
+      break;
+
+    case INIPS_KEY_NAME:
+      if (IS_SPACE(c)) {
+        state = INIPS_AFTER_KEY_NAME;
+      } else if (c == '=') {
+        state = INIPS_BEFORE_KEY_VALUE;
+      } else if (c == '[' || c == ']' || IS_NEWLINE_OR_EOF(c)) {
+        bad_syntax = 1;
+      } else {
+        name_len++;
+      }
+      if (name_len > INILOAD_NAME_MAXLEN) {
+        bad_syntax = 1;
+        break;
+      }
+      break;
+
+    case INIPS_AFTER_KEY_NAME:
+      if (IS_SPACE(c)) {
+      } else if (c == '=') {
+        state = INIPS_BEFORE_KEY_VALUE;
+      } else {
+        bad_syntax = 1;
+      }
+      break;
+
+    case INIPS_BEFORE_KEY_VALUE:
+      if (IS_SPACE(c)) {
+      } else if (IS_NEWLINE_OR_EOF(c) || c == '=' || c == '[' || c == ']') {
+        bad_syntax = 1;
+      } else if (c == '\"') {
+        value_pos = i + 1;
+        value_len = 0;
+        state = INIPS_QUOTED_VALUE;
+      } else {
+        value_pos = i;
+        value_len = 1;
+        state = INIPS_NON_QUOTED_VALUE;
+      }
+      break;
+
+    case INIPS_QUOTED_VALUE:
+      if (c == '\"') {
+        /* Insert the key */
+        if (curr_section == NULL) {
+          /* Empty section but we don't have it yet */
+          curr_section = __ini_add_section(ini, "", 0);
+          if (curr_section == NULL) {
+            alloc_error = 1;
+            break;
+          }
+        }
+
+        if (!__ini_add_key(ini, curr_section, buf + name_pos, name_len,
+                           buf + value_pos, value_len, 1)) {
+          alloc_error = 1;
+          break;
+        }
+        state = INIPS_AFTER_KEY_VALUE;
+      } else if (IS_NEWLINE_OR_EOF(c)) {
+        bad_syntax = 1;
+      } else {
+        value_len++;
+      }
+      break;
+
+    case INIPS_NON_QUOTED_VALUE:
+      if (IS_NEWLINE_OR_EOF(c)) {
+        if (curr_section == NULL) {
+          /* Empty section but we don't have it yet */
+          curr_section = __ini_add_section(ini, "", 0);
+          if (curr_section == NULL) {
+            alloc_error = 1;
+            break;
+          }
+        }
+
+        if (!__ini_add_key(ini, curr_section, buf + name_pos, name_len,
+                           buf + value_pos, value_len, 0)) {
+          alloc_error = 1;
+          break;
+        }
+        state = INIPS_NONE;
+      }
+      if (c == '[' || c == ']' || c == '=') {
+        bad_syntax = 1;
+      } else {
+        value_len++;
+      }
+      break;
+
+    case INIPS_AFTER_KEY_VALUE:
+      if (IS_NEWLINE_OR_EOF(c)) {
+        state = INIPS_NONE;
+      } else {
+        bad_syntax = 1;
+      }
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  return !bad_syntax && !alloc_error;
+}
+
+/* Appends len bytes to the value of a streaming parser and keeps room for the
+ * NUL character. Returns 1 on success and 0 on an allocation error. */
+int __ini_parser_append(ini_parser *parser, const char *str, size_t len) {
+  char *value;
+  size_t cap = (parser->value_cap > 0 ? parser->value_cap : 64);
+  while (cap < parser->value_len + len + 1) {
+    cap *= 2;
+  }
+  if (cap != parser->value_cap) {
+    value = (char *)INILOAD_REALLOC(parser->value, cap);
+    if (value == NULL) {
+      return 0;
+    }
+    parser->value = value;
+    parser->value_cap = cap;
+  }
+  memcpy(parser->value + parser->value_len, str, len);
+  parser->value_len += len;
+  return 1;
+}
+
+/* Reports the key that has just been read, after the section with an empty
+ * name if no section header came before it */
+int __ini_parser_key(ini_parser *parser, int quoted) {
+  if (!__ini_parser_append(parser, "", 1)) {
+    return 0;
+  }
+  parser->name[parser->name_len] = '\0';
+  if (!parser->has_section) {
+    parser->section[0] = '\0';
+    parser->has_section = 1;
+    if (parser->on_section != NULL &&
+        !parser->on_section(parser->user, parser->section)) {
+      return 0;
+    }
+  }
+  return parser->on_key == NULL ||
+         parser->on_key(parser->user, parser->section, parser->name,
+                        parser->value, quoted);
+}
+
+/* Runs the state machine of __ini_parse() over a chunk of text, copying the
+ * names and values since the chunk is gone after the call. Returns 1 on
+ * success and 0 after an error. */
+int __ini_parser_run(ini_parser *parser, const char *chunk, size_t len) {
+  size_t i = 0;
+  size_t end = 0;
+  char c = 0;
+
+  for (i = 0; i < len && !parser->failed; i++) {
+    if (parser->state == INIPS_COMMENT ||
+        parser->state == INIPS_QUOTED_VALUE ||
+        parser->state == INIPS_NON_QUOTED_VALUE) {
+      /* Copy the characters that would not change the state at once */
+      end = __ini_scan(chunk, i, len);
+      if (parser->state != INIPS_COMMENT &&
+          !__ini_parser_append(parser, chunk + i, end - i)) {
+        parser->failed = 1;
+        break;
+      }
+      i = end;
+      if (i == len) {
+        break;
+      }
+    }
+    c = chunk[i];
+    switch (parser->state) {
+    case INIPS_NONE:
+      if (IS_SPACE(c) || IS_NEWLINE_OR_EOF(c)) {
+        /* Do nothing */
+      } else if (IS_COMMENT(c)) {
+        parser->state = INIPS_COMMENT;
+      } else if (c == '[') {
+        parser->name_len = 0;
+        parser->state = INIPS_SECTION_NAME;
+      } else {
+        /* Everything else could be a key name */
+        parser->name[0] = c;
+        parser->name_len = 1;
+        parser->state = INIPS_KEY_NAME;
+      }
+      break;
+
+    case INIPS_COMMENT:
+      if (IS_NEWLINE_OR_EOF(c)) {
+        parser->state = INIPS_NONE;
+      }
+      break;
+
+    case INIPS_SECTION_NAME:
+      if (c == ']') {
+        parser->name[parser->name_len] = '\0';
+        memcpy(parser->section, parser->name, parser->name_len + 1);
+        parser->has_section = 1;
+        if (parser->on_section != NULL &&
+            !parser->on_section(parser->user, parser->section)) {
+          parser->failed = 1;
+          break;
+        }
+        parser->state = INIPS_AFTER_SECTION_NAME;
+      } else if (c == '[' || c == '=' || IS_NEWLINE_OR_EOF(c) ||
+                 IS_COMMENT(c)) {
+        parser->failed = 1;
+      } else if (parser->name_len == INILOAD_NAME_MAXLEN) {
+        /* Name is too long */
+        parser->failed = 1;
+      } else {
+        parser->name[parser->name_len++] = c;
+      }
+      break;
+
+    case INIPS_AFTER_SECTION_NAME:
+      if (IS_NEWLINE_OR_EOF(c)) {
+        parser->state = INIPS_NONE;
+      } else if (!IS_SPACE(c)) {
+        parser->failed = 1;
+      }
+      break;
+
+    case INIPS_KEY_NAME:
+      if (IS_SPACE(c)) {
+        parser->state = INIPS_AFTER_KEY_NAME;
+      } else if (c == '=') {
+        parser->state = INIPS_BEFORE_KEY_VALUE;
+      } else if (c == '[' || c == ']' || IS_NEWLINE_OR_EOF(c)) {
+        parser->failed = 1;
+      } else if (parser->name_len == INILOAD_NAME_MAXLEN) {
+        /* Name is too long */
+        parser->failed = 1;
+      } else {
+        parser->name[parser->name_len++] = c;
+      }
+      break;
+
+    case INIPS_AFTER_KEY_NAME:
+      if (c == '=') {
+        parser->state = INIPS_BEFORE_KEY_VALUE;
+      } else if (!IS_SPACE(c)) {
+        parser->failed = 1;
+      }
+      break;
+
+    case INIPS_BEFORE_KEY_VALUE:
+      parser->value_len = 0;
+      if (IS_SPACE(c)) {
+      } else if (IS_NEWLINE_OR_EOF(c) || c == '=' || c == '[' || c == ']') {
+        parser->failed = 1;
+      } else if (c == '\"') {
+        parser->state = INIPS_QUOTED_VALUE;
+      } else if (!__ini_parser_append(parser, &c, 1)) {
+        parser->failed = 1;
+      } else {
+        parser->state = INIPS_NON_QUOTED_VALUE;
+      }
+      break;
+
+    case INIPS_QUOTED_VALUE:
+      if (c == '\"') {
+        if (!__ini_parser_key(parser, 1)) {
+          parser->failed = 1;
+          break;
+        }
+        parser->state = INIPS_AFTER_KEY_VALUE;
+      } else if (IS_NEWLINE_OR_EOF(c) || !__ini_parser_append(parser, &c, 1)) {
+        parser->failed = 1;
+      }
+      break;
+
+    case INIPS_NON_QUOTED_VALUE:
+      if (IS_NEWLINE_OR_EOF(c)) {
+        if (!__ini_parser_key(parser, 0)) {
+          parser->failed = 1;
+          break;
+        }
+        parser->state = INIPS_NONE;
+      } else if (c == '[' || c == ']' || c == '=' ||
+                 !__ini_parser_append(parser, &c, 1)) {
+        parser->failed = 1;
+      }
+      break;
+
+    case INIPS_AFTER_KEY_VALUE:
+      if (IS_NEWLINE_OR_EOF(c)) {
+        parser->state = INIPS_NONE;
+      } else {
+        parser->failed = 1;
+      }
+      break;
+
+    default:
+      break;
+    }
+  }
+  return !parser->failed;
+}
+
+#undef IS_SPACE
+#undef IS_NEWLINE
+#undef IS_EOF
+#undef IS_NEWLINE_OR_EOF
+#undef IS_COMMENT
+
+/* Counts the section headers of a text and the lines with a key after each
+ * of them, which are stored in *counts after the number of keys before the
+ * first header. Returns the number of counts, 0 if there was an allocation
+ * error. */
+size_t __ini_count_keys(const char *buf, size_t len, size_t **counts) {
+  const char *end = buf + len;
+  const char *line_end;
+  size_t num_counts = 1;
+  size_t cap = 64;
+  size_t *counts_new;
+
+  *counts = (size_t *)INILOAD_MALLOC(sizeof(size_t) * cap);
+  if (*counts == NULL) {
+    return 0;
+  }
+  (*counts)[0] = 0;
+  for (; buf < end; buf = line_end + 1) {
+    line_end = (const char *)memchr(buf, '\n', (size_t)(end - buf));
+    if (line_end == NULL) {
+      line_end = end;
+    }
+    while (buf < line_end && (*buf == ' ' || *buf == '\t')) {
+      buf++;
+    }
+    if (buf == line_end || *buf == ';' || *buf == '#') {
+      continue;
+    }
+    if (*buf != '[') {
+      /* Repeated keys and syntax errors are counted too, the counts are
+       * only used to size arrays */
+      (*counts)[num_counts - 1] +=
+          (memchr(buf, '=', (size_t)(line_end - buf)) != NULL);
+      continue;
+    }
+    if (num_counts == cap) {
+      counts_new = (size_t *)INILOAD_REALLOC(*counts, sizeof(size_t) * cap * 2);
+      if (counts_new == NULL) {
+        INILOAD_FREE(*counts);
+        return 0;
+      }
+      *counts = counts_new;
+      cap *= 2;
+    }
+    (*counts)[num_counts++] = 0;
+  }
+  return num_counts;
+}
+
+/* Makes room for num_sections sections and num_keys keys in the arrays and
+ * indexes of a file that has none yet */
+int __ini_reserve(ini_file *ini, size_t num_sections, size_t num_keys) {
+  ini_section *ptr_sec_new;
+  size_t cap;
+  if (num_sections > ini->cap_sections) {
+    ptr_sec_new = (ini_section *)__ini_realloc(
+        ini->arena, ini->ptr_sections, sizeof(ini_section) * ini->cap_sections,
+        sizeof(ini_section) * num_sections);
+    if (ptr_sec_new == NULL) {
+      return 0;
+    }
+    INILOAD_COUNT_ALLOC(ini, sizeof(ini_section) * num_sections, 1);
+    ini->ptr_sections = ptr_sec_new;
+    ini->cap_sections = num_sections;
+  }
+  cap = __ini_index_size(num_sections);
+  if (cap > ini->cap_section_index && ini->num_section_index == 0) {
+    __ini_mfree(ini->arena, ini->section_index);
+    ini->section_index = (ini_index_entry *)__ini_malloc(
+        ini->arena, sizeof(ini_index_entry) * cap);
+    ini->cap_section_index = 0;
+    if (ini->section_index == NULL) {
+      return 0;
+    }
+    INILOAD_COUNT_ALLOC(ini, sizeof(ini_index_entry) * cap, 0);
+    memset(ini->section_index, 0, sizeof(ini_index_entry) * cap);
+    ini->cap_section_index = cap;
+  }
+  cap = __ini_index_size(num_keys);
+  if (cap > ini->cap_key_index && ini->num_key_index == 0) {
+    __ini_mfree(ini->arena, ini->key_index);
+    ini->key_index = (ini_index_entry *)__ini_malloc(
+        ini->arena, sizeof(ini_index_entry) * cap);
+    ini->cap_key_index = 0;
+    if (ini->key_index == NULL) {
+      return 0;
+    }
+    INILOAD_COUNT_ALLOC(ini, sizeof(ini_index_entry) * cap, 0);
+    memset(ini->key_index, 0, sizeof(ini_index_entry) * cap);
+    ini->cap_key_index = cap;
+  }
+  return 1;
+}
+
+/* Parses a text into an empty file with arrays sized for it, either from the
+ * hints of the options or by counting the sections and keys beforehand */
+int __ini_parse_sized(ini_file *ini, const char *buf, size_t len,
+                      const ini_options *options) {
+  size_t *counts = NULL;
+  size_t num_counts, s, num_keys = 0;
+  int ok;
+
+  if (options != NULL &&
+      (options->num_sections_hint != 0 || options->num_keys_hint != 0)) {
+    if (options->num_sections_hint != 0 &&
+        options->num_keys_hint / options->num_sections_hint >
+            INILOAD_INITIAL_CAP) {
+      ini->cap_new_keys =
+          options->num_keys_hint / options->num_sections_hint + 1;
+    }
+    ok = __ini_reserve(ini, options->num_sections_hint,
+                       options->num_keys_hint) &&
+         __ini_parse(ini, buf, len);
+    ini->cap_new_keys = INILOAD_INITIAL_CAP;
+    return ok;
+  }
+
+  num_counts = __ini_count_keys(buf, len, &counts);
+  if (num_counts == 0) {
+    return 0;
+  }
+  for (s = 0; s < num_counts; s++) {
+    num_keys += counts[s];
+  }
+  /* Keys before the first header make a section with an empty name */
+  if (!__ini_reserve(ini, num_counts - (counts[0] == 0), num_keys)) {
+    INILOAD_FREE(counts);
+    return 0;
+  }
+  ini->key_hints = counts;
+  ini->num_key_hints = num_counts;
+  ini->hint_pos = 0;
+  ok = __ini_parse(ini, buf, len);
+  ini->key_hints = NULL;
+  ini->num_key_hints = 0;
+  INILOAD_FREE(counts);
+  return ok;
+}
+
+#ifdef INILOAD_ENABLE_THREADS
+/**
+ * @brief A part of the text that is parsed on its own thread.
+ */
+typedef struct ini_chunk {
+  ini_file *ini;   /**< Sections and keys parsed from the chunk */
+  const char *buf; /**< Start of the chunk */
+  size_t len;      /**< Length of the chunk */
+  int ok;          /**< 1 if the chunk was parsed successfully */
+} ini_chunk;
+
+#ifdef INILOAD_WIN32
+DWORD WINAPI __ini_parse_chunk(LPVOID arg) {
+  ini_chunk *chunk = (ini_chunk *)arg;
+  chunk->ok = __ini_parse_sized(chunk->ini, chunk->buf, chunk->len, NULL);
+  return 0;
+}
+#else
+void *__ini_parse_chunk(void *arg) {
+  ini_chunk *chunk = (ini_chunk *)arg;
+  chunk->ok = __ini_parse_sized(chunk->ini, chunk->buf, chunk->len, NULL);
+  return NULL;
+}
+#endif
+
+/* Sets a key parsed by another chunk, whose strings are already in the pool,
+ * in section s */
+int __ini_merge_key(ini_file *ini, size_t s, const ini_key *from) {
+  ini_section *section = &ini->ptr_sections[s];
+  const char *key_name = ini->ptr_pool + from->name_off;
+  unsigned long hash =
+      __ini_hash_key_len(section->hash, key_name, from->name_len);
+  ini_key *key = __ini_find_key(ini, s, key_name, from->name_len, hash);
+  ini_key *ptr_keys_new;
+  if (key != NULL) {
+    key->type = from->type;
+    key->value = from->value;
+    return 1;
+  }
+  if (section->num_keys == section->cap_keys) {
+    ptr_keys_new = (ini_key *)__ini_realloc(
+        ini->arena, section->ptr_keys, sizeof(ini_key) * section->cap_keys,
+        sizeof(ini_key) * (section->cap_keys * 2));
+    if (ptr_keys_new == NULL) {
+      return 0;
+    }
+    INILOAD_COUNT_ALLOC(ini, sizeof(ini_key) * (section->cap_keys * 2), 1);
+    section->cap_keys = section->cap_keys * 2;
+    section->ptr_keys = ptr_keys_new;
+  }
+  section->ptr_keys[section->num_keys++] = *from;
+  return __ini_index_put_key(ini, hash, s, section->num_keys - 1);
+}
+
+/* Appends the sections, keys, strings and index entries parsed from a chunk to
+ * the ones parsed so far, leaving the chunk's ini_file empty */
+int __ini_join_chunk(ini_file *ini, ini_file *part) {
+  size_t pool_base = 0;
+  size_t cap, i, k, s;
+  size_t *moved;
+  ini_section *section;
+  char *ptr_pool_new;
+  int ok = 1;
+
+#ifdef INILOAD_ENABLE_STATS
+  /* The allocations of the chunk's thread count for the whole file */
+  ini->stats.num_allocs += part->stats.num_allocs;
+  ini->stats.alloc_bytes += part->stats.alloc_bytes;
+  ini->stats.num_grows += part->stats.num_grows;
+#endif
+  if (!(ini->flags & INI_LOAD_ZERO_COPY)) {
+    /* Strings are offsets into the chunk's own pool, which is appended */
+    pool_base = ini->size_pool;
+    if (ini->size_pool + part->size_pool > ini->cap_pool) {
+      cap = ini->size_pool + part->size_pool;
+      ptr_pool_new =
+          (char *)__ini_realloc(ini->arena, ini->ptr_pool, ini->cap_pool, cap);
+      if (ptr_pool_new == NULL) {
+        return 0;
+      }
+      INILOAD_COUNT_ALLOC(ini, cap, 1);
+      ini->ptr_pool = ptr_pool_new;
+      ini->cap_pool = cap;
+    }
+    memcpy(ini->ptr_pool + ini->size_pool, part->ptr_pool, part->size_pool);
+    ini->size_pool += part->size_pool;
+  }
+
+  for (i = 0; i < part->num_sections; i++) {
+    section = &part->ptr_sections[i];
+    section->name_off += pool_base;
+    for (k = 0; k < section->num_keys && pool_base != 0; k++) {
+      section->ptr_keys[k].name_off += pool_base;
+      if (section->ptr_keys[k].type == INI_KEY_STRING ||
+          section->ptr_keys[k].type == INI_KEY_LAZY) {
+        section->ptr_keys[k].value.string_off += pool_base;
+      }
+    }
+  }
+
+  /* Sections seen by an earlier chunk get the keys of this one, the others
+   * change hands with their key arrays. moved[i] is the new position of
+   * section i plus one, 0 if it was merged. */
+  moved = (size_t *)INILOAD_MALLOC(sizeof(size_t) * (part->num_sections + 1));
+  if (moved == NULL) {
+    return 0;
+  }
+  INILOAD_COUNT_ALLOC(ini, sizeof(size_t) * (part->num_sections + 1), 0);
+  for (i = 0; i < part->num_sections && ok; i++) {
+    section = &part->ptr_sections[i];
+    s = __ini_find_section_len(ini, ini->ptr_pool + section->name_off,
+                               section->name_len, section->hash);
+    moved[i] = 0;
+    if (s == 0) {
+      ok = __ini_grow_sections(ini) &&
+           __ini_index_put_section(ini, section->hash, ini->num_sections);
+      if (ok) {
+        ini->ptr_sections[ini->num_sections] = *section;
+        moved[i] = ++ini->num_sections;
+        section->ptr_keys = NULL;
+      }
+      continue;
+    }
+    for (k = 0; k < section->num_keys && ok; k++) {
+      ok = __ini_merge_key(ini, s - 1, &section->ptr_keys[k]);
+    }
+  }
+
+  /* The key hashes computed by the chunk's thread are reused for the moved
+   * sections, which have no keys in the index yet */
+  for (i = 0; i < part->cap_key_index && ok; i++) {
+    if (part->key_index[i].section != 0 &&
+        moved[part->key_index[i].section - 1] != 0) {
+      ok = __ini_index_put_key(ini, part->key_index[i].hash,
+                               moved[part->key_index[i].section - 1] - 1,
+                               part->key_index[i].key);
+    }
+  }
+  INILOAD_FREE(moved);
+  return ok;
+}
+
+/* Splits the text into chunks starting at section headers, parses them on
+ * separate threads and joins the results in file order */
+int __ini_parse_parallel(ini_file *ini, const char *buf, size_t len,
+                         unsigned int num_threads) {
+  ini_chunk chunks[64];
+  size_t num_chunks = len / INILOAD_PARALLEL_MIN_CHUNK;
+  size_t begin = 0;
+  size_t pos, n;
+  const char *nl;
+  int ok = 1;
+#ifdef INILOAD_WIN32
+  HANDLE threads[64];
+#else
+  pthread_t threads[64];
+#endif
+
+  if (num_chunks > num_threads) {
+    num_chunks = num_threads;
+  }
+  if (num_chunks > 64) {
+    num_chunks = 64;
+  }
+
+  /* Every line starts in the initial state of the parser, so the text can be
+   * cut before any '[' that follows a newline */
+  for (n = 0; n < num_chunks; n++) {
+    chunks[n].buf = buf + begin;
+    chunks[n].ok = 0;
+    pos = len / num_chunks * (n + 1);
+    if (pos < begin) {
+      pos = begin;
+    }
+    nl = NULL;
+    if (n + 1 < num_chunks) {
+      nl = (const char *)memchr(buf + pos, '\n', len - pos);
+      while (nl != NULL && nl + 1 < buf + len && nl[1] != '[') {
+        nl = (const char *)memchr(nl + 1, '\n', len - (nl + 1 - buf));
+      }
+    }
+    if (nl == NULL || nl + 1 >= buf + len) {
+      /* The rest of the text is the last chunk */
+      chunks[n].len = len - begin;
+      num_chunks = n + 1;
+      break;
+    }
+    chunks[n].len = (size_t)(nl + 1 - buf) - begin;
+    begin += chunks[n].len;
+  }
+
+  if (num_chunks <= 1) {
+    return __ini_parse_sized(ini, buf, len, NULL);
+  }
+
+  /* The first chunk is parsed into ini on this thread */
+  chunks[0].ini = ini;
+  for (n = 1; n < num_chunks; n++) {
+    chunks[n].ini = __ini_create(NULL, chunks[n].len);
+    if (chunks[n].ini == NULL) {
+      ok = 0;
+      break;
+    }
+    chunks[n].ini->flags = ini->flags;
+    if (ini->flags & INI_LOAD_ZERO_COPY) {
+      /* All chunks NUL-terminate their strings in the same text */
+      chunks[n].ini->ptr_pool = ini->ptr_pool;
+      chunks[n].ini->size_pool = ini->size_pool;
+    }
+#ifdef INILOAD_WIN32
+    threads[n] = CreateThread(NULL, 0, __ini_parse_chunk, &chunks[n], 0, NULL);
+    if (threads[n] == NULL) {
+#else
+    if (pthread_create(&threads[n], NULL, __ini_parse_chunk, &chunks[n]) != 0) {
+#endif
+      if (ini->flags & INI_LOAD_ZERO_COPY) {
+        chunks[n].ini->ptr_pool = NULL;
+      }
+      ini_free(chunks[n].ini);
+      ok = 0;
+      break;
+    }
+  }
+  num_chunks = n;
+
+  chunks[0].ok = __ini_parse_sized(ini, chunks[0].buf, chunks[0].len, NULL);
+  ok = ok && chunks[0].ok;
+  for (n = 1; n < num_chunks; n++) {
+#ifdef INILOAD_WIN32
+    WaitForSingleObject(threads[n], INFINITE);
+    CloseHandle(threads[n]);
+#else
+    pthread_join(threads[n], NULL);
+#endif
+    ok = ok && chunks[n].ok && __ini_join_chunk(ini, chunks[n].ini);
+    if (ini->flags & INI_LOAD_ZERO_COPY) {
+      chunks[n].ini->ptr_pool = NULL;
+    }
+    ini_free(chunks[n].ini);
+  }
+  return ok;
+}
+#endif /* INILOAD_ENABLE_THREADS */
+
+/* Parses the text on the calling thread or, if requested, on several */
+int __ini_parse_text(ini_file *ini, const char *buf, size_t len,
+                     const ini_options *options) {
+  double start = INILOAD_NOW();
+  int ok;
+  INILOAD_COUNT_BYTES(ini, len);
+#ifdef INILOAD_ENABLE_THREADS
+  if (options != NULL && (options->flags & INI_LOAD_PARALLEL) &&
+      ini->arena == NULL && len >= 2 * (size_t)INILOAD_PARALLEL_MIN_CHUNK) {
+    ok = __ini_parse_parallel(ini, buf, len,
+                              options->num_threads == 0
+                                  ? INILOAD_THREADS
+                                  : options->num_threads);
+    INILOAD_COUNT_TIME(ini, parse_seconds, start);
+    return ok;
+  }
+#else
+  (void)options;
+#endif
+  ok = __ini_parse_sized(ini, buf, len, options);
+  INILOAD_COUNT_TIME(ini, parse_seconds, start);
+  return ok;
+}
+
+/* Allocates room for len bytes of text plus a NUL character, in the arena if
+ * the text is kept as the string pool */
+char *__ini_alloc_text(ini_file *ini, size_t len) {
+  INILOAD_COUNT_ALLOC(ini, len + 1, 0);
+  return (char *)__ini_malloc(
+      (ini->flags & INI_LOAD_ZERO_COPY) ? ini->arena : NULL, len + 1);
+}
+
+void __ini_free_text(ini_file *ini, char *buf) {
+  if (!(ini->flags & INI_LOAD_ZERO_COPY) || ini->ptr_pool != buf) {
+    __ini_mfree((ini->flags & INI_LOAD_ZERO_COPY) ? ini->arena : NULL, buf);
+  }
+}
+
+/* Parses text read by iniload into buf (len bytes followed by room for a NUL
+ * character), which is either kept as the string pool or freed */
+ini_file *__ini_load_text(ini_file *ini, char *buf, size_t len,
+                          const ini_options *options) {
+  buf[len] = '\0';
+  if (ini->flags & INI_LOAD_ZERO_COPY) {
+    ini->ptr_pool = buf;
+    ini->size_pool = len;
+    ini->cap_pool = len + 1;
+  }
+  if (!__ini_parse_text(ini, buf, len, options)) {
+    __ini_free_text(ini, buf);
+    ini_free(ini);
+    return NULL;
+  }
+  __ini_free_text(ini, buf);
+  return ini;
+}
+
+#ifdef INILOAD_HAS_FD
+int __ini_open(const char *path) {
+#ifdef INILOAD_WIN32
+  return _open(path, _O_RDONLY | _O_BINARY);
+#else
+  return open(path, O_RDONLY);
+#endif
+}
+
+void __ini_close(int fd) {
+#ifdef INILOAD_WIN32
+  _close(fd);
+#else
+  close(fd);
+#endif
+}
+
+/* Gets the size and modification time of a regular file. Returns 0 if fd is
+ * not a regular file. */
+int __ini_stat(int fd, size_t *size, unsigned long *mtime) {
+#ifdef INILOAD_WIN32
+  struct _stat64 st;
+  if (_fstat64(fd, &st) != 0 || !(st.st_mode & _S_IFREG)) {
+    return 0;
+  }
+#else
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    return 0;
+  }
+#endif
+  *size = (size_t)st.st_size;
+  if (mtime != NULL) {
+    *mtime = (unsigned long)st.st_mtime;
+  }
+  return 1;
+}
+
+/* Maps len bytes of a regular file for reading. Returns NULL on failure, an
+ * empty file gives an empty text since it can not be mapped. */
+char *__ini_map(int fd, size_t len) {
+#ifdef INILOAD_WIN32
+  HANDLE mapping;
+  void *view;
+  if (len == 0) {
+    return (char *)"";
+  }
+  mapping = CreateFileMappingA((HANDLE)_get_osfhandle(fd), NULL, PAGE_READONLY,
+                               0, 0, NULL);
+  if (mapping == NULL) {
+    return NULL;
+  }
+  /* The view keeps the mapping alive */
+  view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  return (char *)view;
+#else
+  void *map;
+  if (len == 0) {
+    return (char *)"";
+  }
+  map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  return map == MAP_FAILED ? NULL : (char *)map;
+#endif
+}
+
+void __ini_unmap(char *map, size_t len) {
+  if (len == 0) {
+    return;
+  }
+#ifdef INILOAD_WIN32
+  UnmapViewOfFile(map);
+#else
+  munmap(map, len);
+#endif
+}
+
+/* Parses a memory mapping of a regular file. Sets *mapped to 0 and returns
+ * NULL if the file could not be mapped. */
+ini_file *__ini_load_mapped(int fd, const ini_options *options, int *mapped) {
+  ini_file *ptr = NULL;
+  size_t len;
+  char *map;
+  *mapped = 0;
+  if (!__ini_stat(fd, &len, NULL)) {
+    return NULL;
+  }
+  map = __ini_map(fd, len);
+  if (map == NULL) {
+    return NULL;
+  }
+#ifdef POSIX_MADV_SEQUENTIAL
+  if (len > 0) {
+    posix_madvise(map, len, POSIX_MADV_SEQUENTIAL);
+  }
+#endif
+  *mapped = 1;
+  ptr = ini_load_mem_ex(map, len, options);
+  __ini_unmap(map, len);
+  return ptr;
+}
+#endif /* INILOAD_HAS_FD */
+
+ini_file *ini_load(const char *path) { return ini_load_ex(path, NULL); }
+
+ini_file *ini_load_ex(const char *path, const ini_options *options) {
+  FILE *f = NULL;
+  long file_size = 0;
+  char *buf = NULL;
+  ini_file *ptr = NULL;
+  double start;
+#ifdef INILOAD_HAS_FD
+  int fd;
+  int mapped = 0;
+
+  if (options != NULL && (options->flags & INI_LOAD_MMAP)) {
+    fd = __ini_open(path);
+    if (fd < 0) {
+      return NULL;
+    }
+    ptr = __ini_load_mapped(fd, options, &mapped);
+    __ini_close(fd);
+    if (mapped) {
+      return ptr;
+    }
+  }
+#endif
+
+  f = fopen(path, "rb");
+
+  if (f == NULL) {
+    return NULL;
+  }
+
+  fseek(f, 0, SEEK_END);
+  file_size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (file_size < 0) {
+    fclose(f);
+    return NULL;
+  }
+
+  ptr = __ini_create(options, file_size);
+  if (ptr == NULL) {
+    fclose(f);
+    return NULL;
+  }
+
+  /* Read the entire file */
+  buf = __ini_alloc_text(ptr, file_size);
+  if (buf == NULL) {
+    fclose(f);
+    ini_free(ptr);
+    return NULL;
+  }
+
+  start = INILOAD_NOW();
+  if (fread(buf, 1, file_size, f) != (size_t)file_size) {
+    fclose(f);
+    __ini_free_text(ptr, buf);
+    ini_free(ptr);
+    return NULL;
+  }
+  fclose(f);
+  INILOAD_COUNT_TIME(ptr, read_seconds, start);
+
+  return __ini_load_text(ptr, buf, file_size, options);
+}
+
+ini_file *ini_load_mem(const char *data, size_t len) {
+  return ini_load_mem_ex(data, len, NULL);
+}
+
+ini_file *ini_load_mem_ex(const char *data, size_t len,
+                          const ini_options *options) {
+  ini_file *ptr = __ini_create(options, len);
+  if (ptr == NULL) {
+    return NULL;
+  }
+  /* The caller's data is never written to */
+  ptr->flags &= ~(unsigned int)INI_LOAD_ZERO_COPY;
+  if (!__ini_parse_text(ptr, data, len, options)) {
+    ini_free(ptr);
+    return NULL;
+  }
+  return ptr;
+}
+
+#ifdef INILOAD_HAS_FD
+ini_file *ini_load_fd(int fd) { return ini_load_fd_ex(fd, NULL); }
+
+ini_file *ini_load_fd_ex(int fd, const ini_options *options) {
+  size_t cap = 4096;
+  size_t len = 0;
+  char *buf = NULL;
+  char *buf_new = NULL;
+  ini_file *ptr = NULL;
+  int mapped = 0;
+  double start;
+#ifdef INILOAD_WIN32
+  struct _stat st;
+  int n;
+  if (_fstat(fd, &st) == 0 && (st.st_mode & _S_IFREG)) {
+#else
+  struct stat st;
+  ssize_t n;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+#endif
+    /* One extra byte lets the final read see the end of the file */
+    cap = (size_t)st.st_size + 1;
+  }
+
+  if (options != NULL && (options->flags & INI_LOAD_MMAP)) {
+    ptr = __ini_load_mapped(fd, options, &mapped);
+    if (mapped) {
+      return ptr;
+    }
+  }
+
+  ptr = __ini_create(options, cap);
+  if (ptr == NULL) {
+    return NULL;
+  }
+  buf = __ini_alloc_text(ptr, cap);
+  if (buf == NULL) {
+    ini_free(ptr);
+    return NULL;
+  }
+
+  /* Read until the end of the file, growing the buffer for pipes, sockets and
+   * files that are still being appended to */
+  start = INILOAD_NOW();
+  for (;;) {
+    if (len == cap) {
+      buf_new = (char *)__ini_realloc(
+          (ptr->flags & INI_LOAD_ZERO_COPY) ? ptr->arena : NULL, buf, cap + 1,
+          cap * 2 + 1);
+      if (buf_new == NULL) {
+        __ini_free_text(ptr, buf);
+        ini_free(ptr);
+        return NULL;
+      }
+      INILOAD_COUNT_ALLOC(ptr, cap * 2 + 1, 1);
+      buf = buf_new;
+      cap *= 2;
+    }
+#ifdef INILOAD_WIN32
+    n = _read(fd, buf + len, (unsigned int)(cap - len));
+#else
+    n = read(fd, buf + len, cap - len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+#endif
+    if (n < 0) {
+      __ini_free_text(ptr, buf);
+      ini_free(ptr);
+      return NULL;
+    }
+    if (n == 0) {
+      break;
+    }
+    len += (size_t)n;
+  }
+  INILOAD_COUNT_TIME(ptr, read_seconds, start);
+
+  return __ini_load_text(ptr, buf, len, options);
+}
+#endif /* INILOAD_HAS_FD */
+
+/* Returns the end of the piece of text starting at pos, which is the start of
+ * the next line whose first character other than blanks is '[' */
+size_t __ini_span_end(const char *buf, size_t len, size_t pos) {
+  const char *bracket;
+  size_t i = pos + 1;
+  size_t j;
+  while (i < len) {
+    bracket = (const char *)memchr(buf + i, '[', len - i);
+    if (bracket == NULL) {
+      return len;
+    }
+    j = (size_t)(bracket - buf);
+    i = j + 1;
+    while (j > pos && (buf[j - 1] == ' ' || buf[j - 1] == '\t')) {
+      j--;
+    }
+    if (j > pos &&
+        (buf[j - 1] == '\n' || buf[j - 1] == '\r' || buf[j - 1] == '\0')) {
+      return j;
+    }
+  }
+  return len;
+}
+
+/* Mixes 32 bits into a hash like MurmurHash3 does */
+unsigned long __ini_mix(unsigned long hash, unsigned long k) {
+  k = (k * 0xcc9e2d51UL) & 0xffffffffUL;
+  k = ((k << 15) | (k >> 17)) & 0xffffffffUL;
+  k = (k * 0x1b873593UL) & 0xffffffffUL;
+  hash ^= k;
+  hash = ((hash << 13) | (hash >> 19)) & 0xffffffffUL;
+  return (hash * 5 + 0xe6546b64UL) & 0xffffffffUL;
+}
+
+/* Two 32-bit hashes of a piece of text with different seeds, four bytes at a
+ * time, which together make accidental matches unlikely */
+void __ini_hash_span(const char *buf, size_t len, unsigned long hash[2]) {
+  const unsigned char *p = (const unsigned char *)buf;
+  unsigned long h0 = INILOAD_HASH_SEED;
+  unsigned long h1 = len & 0xffffffffUL;
+  unsigned long k;
+  size_t i;
+  for (i = 0; i + 4 <= len; i += 4) {
+    k = (unsigned long)p[i] | ((unsigned long)p[i + 1] << 8) |
+        ((unsigned long)p[i + 2] << 16) | ((unsigned long)p[i + 3] << 24);
+    h0 = __ini_mix(h0, k);
+    h1 = __ini_mix(h1, k ^ 0x5bd1e995UL);
+  }
+  for (k = 0; i < len; i++) {
+    k = (k << 8) | p[i];
+  }
+  hash[0] = __ini_mix(h0, k);
+  hash[1] = __ini_mix(h1, k);
+}
+
+/* Appends a section of the previous version, taking over its keys, and adds
+ * it to the section index in file order. Its keys are indexed by
+ * __ini_reuse_keys() once all sections are in place. */
+int __ini_reuse_section(ini_file *ini, const ini_section *old_section) {
+  size_t s;
+  if (!__ini_grow_sections(ini)) {
+    return 0;
+  }
+  s = ini->num_sections;
+  ini->ptr_sections[s] = *old_section;
+  ini->num_sections++;
+  return __ini_index_put_section(ini, old_section->hash, s);
+}
+
+/* Indexes the keys of the reused sections, placed[s] being the position plus
+ * one of section s of the previous version in the new one, or 0 if it was
+ * not reused. No key name of a reused section is hashed again. If every
+ * reused section kept its position and the index of the previous version has
+ * room, that index is taken over and only the keys of the changed sections
+ * are removed and added, which allocates nothing and so leaves the previous
+ * version intact; otherwise its entries are copied to the new positions with
+ * their hashes. */
+int __ini_reuse_keys(ini_file *ini, ini_file *old, const size_t *placed) {
+  ini_index_entry *index = ini->key_index;
+  ini_section *section;
+  size_t cap = ini->cap_key_index;
+  size_t removed = 0;
+  size_t s, k, i;
+  int same = (old->key_index != NULL && old->key_filter != NULL);
+  for (s = 0; s < old->num_sections && same; s++) {
+    same = (placed[s] == 0 || placed[s] == s + 1);
+    removed += (placed[s] == 0 ? old->ptr_sections[s].num_keys : 0);
+  }
+  same = same && (old->num_key_index - removed + ini->num_key_index) * 2 <=
+                     old->cap_key_index;
+
+  if (!same) {
+    while (ini->cap_key_index < old->cap_key_index) {
+      if (!__ini_index_grow(NULL, &ini->key_index, &ini->cap_key_index)) {
+        return 0;
+      }
+      INILOAD_COUNT_ALLOC(ini, sizeof(ini_index_entry) * ini->cap_key_index,
+                          1);
+    }
+    for (i = 0; i < old->cap_key_index; i++) {
+      s = old->key_index[i].section;
+      if (s != 0 && placed[s - 1] != 0 &&
+          !__ini_index_put_key(ini, old->key_index[i].hash, placed[s - 1] - 1,
+                               old->key_index[i].key)) {
+        return 0;
+      }
+    }
+    return 1;
+  }
+
+  /* The keys of the changed sections of the previous version */
+  for (s = 0; s < old->num_sections; s++) {
+    section = &old->ptr_sections[s];
+    for (k = 0; placed[s] == 0 && k < section->num_keys; k++) {
+      __ini_index_remove_key(
+          old,
+          __ini_hash_key(section->hash,
+                         ini->ptr_pool + section->ptr_keys[k].name_off),
+          s, k);
+    }
+  }
+  ini->key_index = old->key_index;
+  ini->num_key_index = old->num_key_index;
+  ini->cap_key_index = old->cap_key_index;
+  old->key_index = NULL;
+  __ini_mfree(NULL, ini->key_filter);
+  ini->key_filter = old->key_filter;
+  ini->cap_key_filter = old->cap_key_filter;
+  ini->num_filter_stale = old->num_filter_stale;
+  old->key_filter = NULL;
+  if (ini->num_filter_stale > ini->num_key_index / 2) {
+    /* The filter has the size of the index, rebuilding it allocates nothing */
+    __ini_filter_build(ini);
+  }
+
+  /* The keys of the changed sections of the new version, whose entries are
+   * taken from the index that was filled while parsing them */
+  for (i = 0; i < cap; i++) {
+    s = index[i].section;
+    if (s != 0 && (s > old->num_sections || placed[s - 1] != s)) {
+      __ini_index_put_key(ini, index[i].hash, s - 1, index[i].key);
+    }
+  }
+  __ini_mfree(NULL, index);
+  return 1;
+}
+
+/* Reloads with or without taking over sections of the previous version. A
+ * repeated section header can not be told apart from the sections it adds to,
+ * so it makes the first attempt fail with *conflict set, and the file that is
+ * then parsed in full is not reused by the next reload. */
+ini_file *__ini_reload_mem(ini_file *old, const char *data, size_t len,
+                           int allow_reuse, int *conflict) {
+  ini_options options = {0};
+  ini_file *ini;
+  size_t *matches = NULL;
+  size_t *placed = NULL;
+  size_t cap_matches = 16;
+  size_t old_size_pool = 0;
+  size_t live_pool = 0;
+  size_t pos, end, first, pool_before, s, i, name_end;
+  unsigned long hash[2];
+  ini_section *section;
+  int header;
+  int reuse = 0;
+  int ok = 1;
+  double start;
+
+  if (old != NULL) {
+    options.flags = old->flags & INI_LOAD_LAZY;
+    for (s = 0; s < old->num_sections; s++) {
+      live_pool += old->ptr_sections[s].pool_len;
+    }
+    /* Start over with a new pool once it is mostly unused */
+    reuse = allow_reuse && old->incremental && old->size_pool / 2 <= live_pool;
+  }
+  ini = __ini_create(&options, len);
+  if (ini == NULL) {
+    return NULL;
+  }
+  ini->incremental = 1;
+
+  if (reuse) {
+    /* The sections of the previous version are found by the hash of their
+     * text, the strings of the reused ones stay where they are in the pool */
+    while (cap_matches < old->num_sections * 2) {
+      cap_matches *= 2;
+    }
+    matches = (size_t *)INILOAD_MALLOC(sizeof(size_t) * cap_matches);
+    placed = (size_t *)INILOAD_MALLOC(sizeof(size_t) *
+                                      (old->num_sections + 1));
+    if (matches == NULL || placed == NULL) {
+      INILOAD_FREE(matches);
+      INILOAD_FREE(placed);
+      ini_free(ini);
+      return NULL;
+    }
+    INILOAD_COUNT_ALLOC(ini, sizeof(size_t) * cap_matches, 0);
+    INILOAD_COUNT_ALLOC(ini, sizeof(size_t) * (old->num_sections + 1), 0);
+    memset(matches, 0, sizeof(size_t) * cap_matches);
+    memset(placed, 0, sizeof(size_t) * (old->num_sections + 1));
+    for (s = 0; s < old->num_sections; s++) {
+      i = old->ptr_sections[s].span_hash[0] & (cap_matches - 1);
+      while (matches[i] != 0) {
+        i = (i + 1) & (cap_matches - 1);
+      }
+      matches[i] = s + 1;
+    }
+    /* The section index gets as large as that of the previous version, the
+     * key index only holds the keys that are parsed again until
+     * __ini_reuse_keys() */
+    if (old->cap_section_index != 0) {
+      ini->section_index = (ini_index_entry *)INILOAD_MALLOC(
+          sizeof(ini_index_entry) * old->cap_section_index);
+      if (ini->section_index == NULL) {
+        INILOAD_FREE(matches);
+        INILOAD_FREE(placed);
+        ini_free(ini);
+        return NULL;
+      }
+      INILOAD_COUNT_ALLOC(
+          ini, sizeof(ini_index_entry) * old->cap_section_index, 0);
+      memset(ini->section_index, 0,
+             sizeof(ini_index_entry) * old->cap_section_index);
+      ini->cap_section_index = old->cap_section_index;
+    }
+    INILOAD_FREE(ini->ptr_pool);
+    ini->ptr_pool = old->ptr_pool;
+    ini->size_pool = old->size_pool;
+    ini->cap_pool = old->cap_pool;
+    old_size_pool = old->size_pool;
+  }
+
+  start = INILOAD_NOW();
+  INILOAD_COUNT_BYTES(ini, len);
+  for (pos = 0; pos < len && ok; pos = end) {
+    end = __ini_span_end(data, len, pos);
+    __ini_hash_span(data + pos, end - pos, hash);
+    section = NULL;
+    for (i = hash[0] & (cap_matches - 1); reuse && matches[i] != 0;
+         i = (i + 1) & (cap_matches - 1)) {
+      s = matches[i] - 1;
+      if (placed[s] == 0 && old->ptr_sections[s].span_hash[0] == hash[0] &&
+          old->ptr_sections[s].span_hash[1] == hash[1] &&
+          old->ptr_sections[s].span_len == end - pos) {
+        /* Every section of the previous version is reused only once */
+        placed[s] = ini->num_sections + 1;
+        section = &old->ptr_sections[s];
+        break;
+      }
+    }
+    if (section != NULL &&
+        __ini_find_section_len(ini, ini->ptr_pool + section->name_off,
+                               section->name_len, section->hash) != 0) {
+      *conflict = 1;
+      ok = 0;
+      break;
+    }
+    if (section != NULL) {
+      ok = __ini_reuse_section(ini, section);
+      continue;
+    }
+
+    /* Changed text is parsed, it makes at most one section */
+    for (i = pos; i < end && (data[i] == ' ' || data[i] == '\t'); i++) {
+    }
+    header = (i < end && data[i] == '[');
+    if (header && reuse) {
+      /* Keys must not be added to a section of the previous version */
+      for (name_end = i + 1; name_end < end && data[name_end] != ']' &&
+                             data[name_end] != '\n';
+           name_end++) {
+      }
+      if (__ini_find_section_len(
+              ini, data + i + 1, name_end - i - 1,
+              __ini_hash_len(INILOAD_HASH_SEED, data + i + 1,
+                             name_end - i - 1)) != 0) {
+        *conflict = 1;
+        ok = 0;
+        break;
+      }
+    }
+    first = ini->num_sections;
+    pool_before = ini->size_pool;
+    ok = __ini_parse(ini, data + pos, end - pos);
+    if (ok && header && ini->num_sections == first) {
+      /* The header added to an earlier section */
+      *conflict = 1;
+      ini->incremental = 0;
+    }
+    if (ok && ini->num_sections > first) {
+      ini->ptr_sections[first].span_hash[0] = hash[0];
+      ini->ptr_sections[first].span_hash[1] = hash[1];
+      ini->ptr_sections[first].span_len = end - pos;
+      ini->ptr_sections[first].pool_len = ini->size_pool - pool_before;
+    }
+  }
+  if (reuse && ok) {
+    ok = __ini_reuse_keys(ini, old, placed);
+  }
+  INILOAD_COUNT_TIME(ini, parse_seconds, start);
+  INILOAD_FREE(matches);
+
+  if (reuse && !ok) {
+    /* Give the previous version its pool back, reused sections are the ones
+     * with their name in its part of the pool */
+    old->ptr_pool = ini->ptr_pool;
+    old->cap_pool = ini->cap_pool;
+    old->size_pool = old_size_pool;
+    ini->ptr_pool = NULL;
+    for (s = 0; s < ini->num_sections; s++) {
+      if (ini->ptr_sections[s].name_off < old_size_pool) {
+        ini->ptr_sections[s].ptr_keys = NULL;
+      }
+    }
+  } else if (reuse) {
+    /* The pool and the reused keys now belong to the new version */
+    old->ptr_pool = NULL;
+    for (s = 0; s < old->num_sections; s++) {
+      if (placed[s] != 0) {
+        old->ptr_sections[s].ptr_keys = NULL;
+      }
+    }
+  }
+  INILOAD_FREE(placed);
+
+  if (!ok) {
+    ini_free(ini);
+    return NULL;
+  }
+  if (old != NULL) {
+    ini_free(old);
+  }
+  return ini;
+}
+
+ini_file *ini_reload_mem(ini_file *old, const char *data, size_t len) {
+  int conflict = 0;
+  ini_file *ini = __ini_reload_mem(old, data, len, 1, &conflict);
+  if (ini == NULL && conflict) {
+    ini = __ini_reload_mem(old, data, len, 0, &conflict);
+  }
+  return ini;
+}
+
+ini_file *ini_reload(ini_file *old, const char *path) {
+  FILE *f = NULL;
+  long file_size = 0;
+  char *buf = NULL;
+  ini_file *ptr = NULL;
+#ifdef INILOAD_ENABLE_STATS
+  double start, read_seconds;
+#endif
+
+  f = fopen(path, "rb");
+  if (f == NULL) {
+    return NULL;
+  }
+  fseek(f, 0, SEEK_END);
+  file_size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (file_size < 0) {
+    fclose(f);
+    return NULL;
+  }
+  buf = (char *)INILOAD_MALLOC(file_size + 1);
+  if (buf == NULL) {
+    fclose(f);
+    return NULL;
+  }
+#ifdef INILOAD_ENABLE_STATS
+  start = __ini_now();
+#endif
+  if (fread(buf, 1, file_size, f) == (size_t)file_size) {
+#ifdef INILOAD_ENABLE_STATS
+    read_seconds = __ini_now() - start;
+#endif
+    ptr = ini_reload_mem(old, buf, file_size);
+#ifdef INILOAD_ENABLE_STATS
+    if (ptr != NULL) {
+      ptr->stats.read_seconds += read_seconds;
+    }
+#endif
+  }
+  fclose(f);
+  INILOAD_FREE(buf);
+  return ptr;
+}
+
+int ini_freeze(ini_file *ini) {
+  ini_index_entry *key_index;
+  ini_section *section, *ptr_sec_new;
+  ini_key *keys;
+  char *ptr_pool_new;
+  size_t s, i, j, cap, num_keys = 0;
+  unsigned long hash;
+
+  if (ini->image != NULL || ini->frozen != NULL) {
+    return 1;
+  }
   for (s = 0; s < ini->num_sections; s++) {
-    if (strcmp(ini->ptr_sections[s].name, section_name) == 0) {
-      for (k = 0; k < ini->ptr_sections[s].num_keys; k++) {
-        if (strcmp(ini->ptr_sections[s].ptr_keys[k].name, key_name) == 0) {
-          return &ini->ptr_sections[s].ptr_keys[k];
-        }
+    num_keys += ini->ptr_sections[s].num_keys;
+  }
+  cap = __ini_index_size(num_keys);
+  keys = (ini_key *)__ini_malloc(ini->arena, sizeof(ini_key) * num_keys + 1);
+  key_index = (ini_index_entry *)__ini_malloc(
+      ini->arena, sizeof(ini_index_entry) * cap + 1);
+  if (keys == NULL || key_index == NULL) {
+    __ini_mfree(ini->arena, keys);
+    __ini_mfree(ini->arena, key_index);
+    return 0;
+  }
+  INILOAD_COUNT_ALLOC(ini, sizeof(ini_key) * num_keys + 1, 0);
+  INILOAD_COUNT_ALLOC(ini, sizeof(ini_index_entry) * cap + 1, 0);
+
+  ini->frozen = keys;
+  for (s = 0; s < ini->num_sections; s++) {
+    section = &ini->ptr_sections[s];
+    if (section->num_keys > 0) {
+      memcpy(keys, section->ptr_keys, sizeof(ini_key) * section->num_keys);
+    }
+    __ini_mfree(ini->arena, section->ptr_keys);
+    section->ptr_keys = keys;
+    section->cap_keys = section->num_keys;
+    keys += section->num_keys;
+  }
+
+  /* The entries are reinserted in the order of the keys, so that the keys
+   * probed after a collision tend to be neighbours */
+  memset(key_index, 0, sizeof(ini_index_entry) * cap);
+  for (s = 0; s < ini->num_sections; s++) {
+    section = &ini->ptr_sections[s];
+    for (i = 0; i < section->num_keys; i++) {
+      hash = __ini_hash_key_len(section->hash,
+                                ini->ptr_pool + section->ptr_keys[i].name_off,
+                                section->ptr_keys[i].name_len);
+      j = hash & (cap - 1);
+      while (key_index[j].section != 0) {
+        j = (j + 1) & (cap - 1);
+      }
+      key_index[j].hash = hash;
+      key_index[j].section = s + 1;
+      key_index[j].key = i;
+    }
+  }
+  __ini_mfree(ini->arena, ini->key_index);
+  ini->key_index = key_index;
+  ini->num_key_index = num_keys;
+  ini->cap_key_index = cap;
+  /* Without a filter the lookups only probe the index */
+  __ini_filter_build(ini);
+  /* Reloads would take over the keys of single sections */
+  ini->incremental = 0;
+
+  if (ini->arena == NULL) {
+    /* Give back the spare capacity, a failure only keeps it */
+    if (ini->num_sections > 0 && ini->num_sections < ini->cap_sections) {
+      ptr_sec_new = (ini_section *)INILOAD_REALLOC(
+          ini->ptr_sections, sizeof(ini_section) * ini->num_sections);
+      if (ptr_sec_new != NULL) {
+        ini->ptr_sections = ptr_sec_new;
+        ini->cap_sections = ini->num_sections;
+      }
+    }
+    if (!(ini->flags & INI_LOAD_ZERO_COPY) && ini->ptr_pool != NULL &&
+        ini->size_pool + 1 < ini->cap_pool) {
+      ptr_pool_new = (char *)INILOAD_REALLOC(ini->ptr_pool, ini->size_pool + 1);
+      if (ptr_pool_new != NULL) {
+        ini->ptr_pool = ptr_pool_new;
+        ini->cap_pool = ini->size_pool + 1;
+      }
+    }
+  }
+  return 1;
+}
+
+#ifdef INILOAD_HAS_FD
+#define INILOAD_IMAGE_VERSION 2
+
+/**
+ * @brief Header of a binary image of a parsed INI file.
+ *
+ * The sections, the keys of all sections one section after the other, the
+ * indexes and the string pool follow at aligned offsets from the start of the
+ * image. Since the image holds no pointers it can be used wherever it is
+ * mapped.
+ */
+typedef struct ini_image {
+  char magic[8];          /**< "INILOAD" */
+  unsigned long version;  /**< INILOAD_IMAGE_VERSION */
+  unsigned long order;    /**< 0x01020304 in the byte order of the writer */
+  unsigned long sizes;    /**< Sizes of size_t, ini_key, ini_section and
+                               ini_index_entry, one byte each */
+  size_t size;            /**< Size of the whole image */
+  size_t num_sections;    /**< Number of sections */
+  size_t num_keys;        /**< Number of keys of all sections */
+  size_t num_section_index; /**< Number of used slots in the section index */
+  size_t cap_section_index; /**< Number of slots in the section index */
+  size_t num_key_index;     /**< Number of used slots in the key index */
+  size_t cap_key_index;     /**< Number of slots in the key index */
+  size_t size_pool;         /**< Size of the string pool without the last NUL */
+  size_t sections_off;      /**< Offset of the sections */
+  size_t keys_off;          /**< Offset of the keys */
+  size_t section_index_off; /**< Offset of the section index */
+  size_t key_index_off;     /**< Offset of the key index */
+  size_t pool_off;          /**< Offset of the string pool */
+  size_t source_size;          /**< Size of the INI file */
+  unsigned long source_mtime;  /**< Modification time of the INI file */
+  unsigned long source_hash[2]; /**< __ini_hash_span() of the INI file */
+} ini_image;
+
+/* Fills the fields of a header that identify the format */
+void __ini_image_format(ini_image *hdr) {
+  memcpy(hdr->magic, "INILOAD", 8);
+  hdr->version = INILOAD_IMAGE_VERSION;
+  hdr->order = 0x01020304UL;
+  hdr->sizes = (unsigned long)sizeof(size_t) |
+               (unsigned long)sizeof(ini_key) << 8 |
+               (unsigned long)sizeof(ini_section) << 16 |
+               (unsigned long)sizeof(ini_index_entry) << 24;
+}
+
+/* Returns a newly allocated image of a parsed INI file and its size. Lazy
+ * keys are converted in the image, the file itself is not modified. */
+char *__ini_image_create(ini_file *ini, size_t *size) {
+  ini_image hdr;
+  ini_section *sections;
+  ini_key *keys;
+  char *image;
+  size_t s, k, num_keys = 0;
+
+  for (s = 0; s < ini->num_sections; s++) {
+    num_keys += ini->ptr_sections[s].num_keys;
+  }
+  memset(&hdr, 0, sizeof(ini_image));
+  __ini_image_format(&hdr);
+  hdr.num_sections = ini->num_sections;
+  hdr.num_keys = num_keys;
+  hdr.num_section_index = ini->num_section_index;
+  hdr.cap_section_index = ini->cap_section_index;
+  hdr.num_key_index = ini->num_key_index;
+  hdr.cap_key_index = ini->cap_key_index;
+  hdr.size_pool = ini->size_pool;
+  hdr.sections_off = INILOAD_ALIGN(sizeof(ini_image));
+  hdr.keys_off =
+      hdr.sections_off + INILOAD_ALIGN(sizeof(ini_section) * ini->num_sections);
+  hdr.section_index_off =
+      hdr.keys_off + INILOAD_ALIGN(sizeof(ini_key) * num_keys);
+  hdr.key_index_off =
+      hdr.section_index_off +
+      INILOAD_ALIGN(sizeof(ini_index_entry) * ini->cap_section_index);
+  hdr.pool_off = hdr.key_index_off +
+                 INILOAD_ALIGN(sizeof(ini_index_entry) * ini->cap_key_index);
+  hdr.size = hdr.pool_off + ini->size_pool + 1;
+
+  image = (char *)INILOAD_MALLOC(hdr.size);
+  if (image == NULL) {
+    return NULL;
+  }
+  /* Padding is zeroed so that equal files give equal images */
+  memset(image, 0, hdr.size);
+  memcpy(image, &hdr, sizeof(ini_image));
+  sections = (ini_section *)(image + hdr.sections_off);
+  keys = (ini_key *)(image + hdr.keys_off);
+  for (s = 0; s < ini->num_sections; s++) {
+    sections[s] = ini->ptr_sections[s];
+    sections[s].cap_keys = sections[s].num_keys;
+    sections[s].ptr_keys = NULL;
+    for (k = 0; k < ini->ptr_sections[s].num_keys; k++) {
+      *keys = ini->ptr_sections[s].ptr_keys[k];
+      if (keys->type == INI_KEY_LAZY) {
+        __ini_resolve_key(ini, keys);
+      }
+      keys++;
+    }
+  }
+  if (ini->cap_section_index > 0) {
+    memcpy(image + hdr.section_index_off, ini->section_index,
+           sizeof(ini_index_entry) * ini->cap_section_index);
+  }
+  if (ini->cap_key_index > 0) {
+    memcpy(image + hdr.key_index_off, ini->key_index,
+           sizeof(ini_index_entry) * ini->cap_key_index);
+  }
+  if (ini->size_pool > 0) {
+    memcpy(image + hdr.pool_off, ini->ptr_pool, ini->size_pool);
+  }
+  *size = hdr.size;
+  return image;
+}
+
+/* Checks that size bytes hold an image in the format of this build whose
+ * parts lie within it */
+int __ini_image_valid(const char *image, size_t size) {
+  ini_image format;
+  const ini_image *hdr = (const ini_image *)image;
+  if (size < sizeof(ini_image)) {
+    return 0;
+  }
+  __ini_image_format(&format);
+  return memcmp(hdr->magic, format.magic, 8) == 0 &&
+         hdr->version == format.version && hdr->order == format.order &&
+         hdr->sizes == format.sizes && hdr->size == size &&
+         hdr->num_sections <= size / sizeof(ini_section) &&
+         hdr->num_keys <= size / sizeof(ini_key) &&
+         hdr->cap_section_index <= size / sizeof(ini_index_entry) &&
+         hdr->cap_key_index <= size / sizeof(ini_index_entry) &&
+         hdr->sections_off <= size && hdr->keys_off <= size &&
+         hdr->section_index_off <= size && hdr->key_index_off <= size &&
+         hdr->sections_off >= sizeof(ini_image) &&
+         hdr->sections_off + sizeof(ini_section) * hdr->num_sections <=
+             hdr->keys_off &&
+         hdr->keys_off + sizeof(ini_key) * hdr->num_keys <=
+             hdr->section_index_off &&
+         hdr->section_index_off +
+                 sizeof(ini_index_entry) * hdr->cap_section_index <=
+             hdr->key_index_off &&
+         hdr->key_index_off + sizeof(ini_index_entry) * hdr->cap_key_index <=
+             hdr->pool_off &&
+         hdr->pool_off < size && hdr->size_pool == size - hdr->pool_off - 1 &&
+         image[size - 1] == '\0' &&
+         hdr->sections_off % sizeof(ini_max_align) == 0 &&
+         hdr->keys_off % sizeof(ini_max_align) == 0 &&
+         hdr->section_index_off % sizeof(ini_max_align) == 0 &&
+         hdr->key_index_off % sizeof(ini_max_align) == 0;
+}
+
+/* Checks that a name of len bytes at offset off lies within the pool of an
+ * image, whose last NUL character ends every string */
+int __ini_image_string_valid(const ini_image *hdr, size_t off, size_t len) {
+  return off <= hdr->size_pool && len <= hdr->size_pool - off;
+}
+
+/* Checks that num slots of an index of an image are used, leaving a free one
+ * for the lookups to stop at, and that they point to existing sections and,
+ * for the key index, to existing keys */
+int __ini_image_index_valid(const ini_index_entry *index, size_t cap,
+                            size_t num, const ini_section *sections,
+                            size_t num_sections, int keys) {
+  size_t i, used = 0;
+  if ((cap & (cap - 1)) != 0 || (cap == 0 ? num != 0 : num >= cap)) {
+    return 0;
+  }
+  for (i = 0; i < cap; i++) {
+    if (index[i].section == 0) {
+      continue;
+    }
+    if (index[i].section > num_sections ||
+        (keys && index[i].key >= sections[index[i].section - 1].num_keys)) {
+      return 0;
+    }
+    used++;
+  }
+  return used == num;
+}
+
+/* Returns an INI file reading a valid image in place, which it owns from then
+ * on, or NULL if the sections, keys and indexes do not add up or there was an
+ * allocation error. Every offset and position is checked, since the image may
+ * have been written by anyone. Only the sections are copied, to point them to
+ * their keys. */
+ini_file *__ini_image_attach(char *image, size_t size) {
+  const ini_image *hdr = (const ini_image *)image;
+  const ini_section *image_sections =
+      (const ini_section *)(image + hdr->sections_off);
+  ini_key *keys = (ini_key *)(image + hdr->keys_off);
+  ini_file *ini;
+  ini_section *sections;
+  size_t s, k, num_keys = 0;
+
+  for (s = 0; s < hdr->num_sections; s++) {
+    if (image_sections[s].num_keys > hdr->num_keys - num_keys ||
+        !__ini_image_string_valid(hdr, image_sections[s].name_off,
+                                  image_sections[s].name_len)) {
+      return NULL;
+    }
+    num_keys += image_sections[s].num_keys;
+  }
+  if (num_keys != hdr->num_keys) {
+    return NULL;
+  }
+  for (k = 0; k < num_keys; k++) {
+    /* Lazy keys are converted in images, which are read-only */
+    if ((unsigned int)keys[k].type >= (unsigned int)INI_KEY_LAZY ||
+        !__ini_image_string_valid(hdr, keys[k].name_off, keys[k].name_len) ||
+        (keys[k].type == INI_KEY_STRING &&
+         !__ini_image_string_valid(hdr, keys[k].value.string_off, 0))) {
+      return NULL;
+    }
+  }
+  if (!__ini_image_index_valid(
+          (const ini_index_entry *)(image + hdr->section_index_off),
+          hdr->cap_section_index, hdr->num_section_index, image_sections,
+          hdr->num_sections, 0) ||
+      !__ini_image_index_valid(
+          (const ini_index_entry *)(image + hdr->key_index_off),
+          hdr->cap_key_index, hdr->num_key_index, image_sections,
+          hdr->num_sections, 1)) {
+    return NULL;
+  }
+  ini = __ini_create(NULL, 0);
+  if (ini == NULL) {
+    return NULL;
+  }
+  if (hdr->num_sections > ini->cap_sections) {
+    sections = (ini_section *)INILOAD_REALLOC(
+        ini->ptr_sections, sizeof(ini_section) * hdr->num_sections);
+    if (sections == NULL) {
+      ini_free(ini);
+      return NULL;
+    }
+    INILOAD_COUNT_ALLOC(ini, sizeof(ini_section) * hdr->num_sections, 1);
+    ini->ptr_sections = sections;
+    ini->cap_sections = hdr->num_sections;
+  }
+  num_keys = 0;
+  for (s = 0; s < hdr->num_sections; s++) {
+    ini->ptr_sections[s] = image_sections[s];
+    ini->ptr_sections[s].ptr_keys = keys + num_keys;
+    num_keys += image_sections[s].num_keys;
+  }
+  ini->num_sections = hdr->num_sections;
+  ini->num_section_index = hdr->num_section_index;
+  ini->cap_section_index = hdr->cap_section_index;
+  ini->section_index = (ini_index_entry *)(image + hdr->section_index_off);
+  ini->num_key_index = hdr->num_key_index;
+  ini->cap_key_index = hdr->cap_key_index;
+  ini->key_index = (ini_index_entry *)(image + hdr->key_index_off);
+  ini->size_pool = hdr->size_pool;
+  ini->cap_pool = hdr->size_pool + 1;
+  ini->ptr_pool = image + hdr->pool_off;
+  ini->image = image;
+  ini->image_size = size;
+  INILOAD_COUNT_BYTES(ini, size);
+  return ini;
+}
+
+/* Writes the image of a parsed INI file to a temporary file and moves it to
+ * path, so that readers never see a partial snapshot */
+int __ini_save_image(ini_file *ini, const char *path, size_t source_size,
+                     unsigned long source_mtime,
+                     const unsigned long source_hash[2]) {
+  ini_image *hdr;
+  char *image, *tmp;
+  size_t size;
+  FILE *f;
+  int ok;
+
+  image = __ini_image_create(ini, &size);
+  if (image == NULL) {
+    return 0;
+  }
+  hdr = (ini_image *)image;
+  hdr->source_size = source_size;
+  hdr->source_mtime = source_mtime;
+  hdr->source_hash[0] = source_hash[0];
+  hdr->source_hash[1] = source_hash[1];
+
+  tmp = (char *)INILOAD_MALLOC(strlen(path) + 32);
+  if (tmp == NULL) {
+    INILOAD_FREE(image);
+    return 0;
+  }
+#ifdef INILOAD_WIN32
+  sprintf(tmp, "%s.%lu.tmp", path, (unsigned long)GetCurrentProcessId());
+#else
+  sprintf(tmp, "%s.%lu.tmp", path, (unsigned long)getpid());
+#endif
+  f = fopen(tmp, "wb");
+  ok = (f != NULL && fwrite(image, 1, size, f) == size);
+  if (f != NULL && fclose(f) != 0) {
+    ok = 0;
+  }
+#ifdef INILOAD_WIN32
+  ok = ok && MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING);
+#else
+  ok = ok && rename(tmp, path) == 0;
+#endif
+  if (!ok && f != NULL) {
+    remove(tmp);
+  }
+  INILOAD_FREE(tmp);
+  INILOAD_FREE(image);
+  return ok;
+}
+
+/* Maps a regular file and gets what a snapshot records about it. Returns NULL
+ * if the file could not be mapped. */
+char *__ini_map_source(const char *path, size_t *size, unsigned long *mtime,
+                       unsigned long hash[2]) {
+  char *text = NULL;
+  int fd = __ini_open(path);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (__ini_stat(fd, size, mtime)) {
+    text = __ini_map(fd, *size);
+  }
+  __ini_close(fd);
+  if (text != NULL) {
+    __ini_hash_span(text, *size, hash);
+  }
+  return text;
+}
+
+int ini_save_snapshot(ini_file *ini, const char *source_path,
+                      const char *path) {
+  size_t size;
+  unsigned long mtime, hash[2];
+  char *text = __ini_map_source(source_path, &size, &mtime, hash);
+  if (text == NULL) {
+    return 0;
+  }
+  __ini_unmap(text, size);
+  return __ini_save_image(ini, path, size, mtime, hash);
+}
+
+ini_file *ini_load_snapshot(const char *source_path, const char *path) {
+  const ini_image *hdr;
+  ini_file *ini = NULL;
+  char *text, *image = NULL;
+  size_t len, size = 0;
+  unsigned long mtime, hash[2];
+  int fd;
+
+  text = __ini_map_source(source_path, &len, &mtime, hash);
+  if (text == NULL) {
+    return ini_load(source_path);
+  }
+  fd = __ini_open(path);
+  if (fd >= 0) {
+    if (__ini_stat(fd, &size, NULL) && size >= sizeof(ini_image)) {
+      image = __ini_map(fd, size);
+    }
+    __ini_close(fd);
+  }
+  if (image != NULL) {
+    hdr = (const ini_image *)image;
+    if (__ini_image_valid(image, size) && hdr->source_size == len &&
+        hdr->source_mtime == mtime && hdr->source_hash[0] == hash[0] &&
+        hdr->source_hash[1] == hash[1]) {
+      ini = __ini_image_attach(image, size);
+    }
+    if (ini == NULL) {
+      __ini_unmap(image, size);
+    }
+  }
+  if (ini == NULL) {
+    /* The snapshot is missing or stale, errors saving it are ignored */
+    ini = ini_load_mem(text, len);
+    if (ini != NULL) {
+      __ini_save_image(ini, path, len, mtime, hash);
+    }
+  }
+  __ini_unmap(text, len);
+  return ini;
+}
+
+/**
+ * @brief Named shared memory segment holding the image of an INI file.
+ */
+struct ini_shared {
+  char *name; /**< Name of the segment */
+#ifdef INILOAD_WIN32
+  HANDLE mapping; /**< Keeps the segment alive while it is shared */
+#endif
+};
+
+ini_shared *ini_share(ini_file *ini, const char *name) {
+  ini_shared *shared;
+  char *image;
+  char magic[8];
+  size_t size;
+#ifdef INILOAD_WIN32
+  void *view;
+#else
+  size_t done;
+  long n;
+  int fd;
+#endif
+
+  shared = (ini_shared *)INILOAD_MALLOC(sizeof(ini_shared));
+  if (shared == NULL) {
+    return NULL;
+  }
+  shared->name = (char *)INILOAD_MALLOC(strlen(name) + 1);
+  image = __ini_image_create(ini, &size);
+  if (shared->name == NULL || image == NULL) {
+    INILOAD_FREE(shared->name);
+    INILOAD_FREE(shared);
+    INILOAD_FREE(image);
+    return NULL;
+  }
+  strcpy(shared->name, name);
+  /* The magic is written last so that a process attaching meanwhile does not
+   * take a partial image for a complete one */
+  memcpy(magic, image, 8);
+  memset(image, 0, 8);
+#ifdef INILOAD_WIN32
+  shared->mapping = CreateFileMappingA(
+      INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size >> 16 >> 16),
+      (DWORD)(size & 0xFFFFFFFFUL), name);
+  if (shared->mapping != NULL && GetLastError() == ERROR_ALREADY_EXISTS) {
+    /* The segment lives as long as a process has it open, its name can not
+     * be taken over until then */
+    CloseHandle(shared->mapping);
+    shared->mapping = NULL;
+  }
+  view = (shared->mapping != NULL
+              ? MapViewOfFile(shared->mapping, FILE_MAP_WRITE, 0, 0, 0)
+              : NULL);
+  if (view == NULL) {
+    if (shared->mapping != NULL) {
+      CloseHandle(shared->mapping);
+    }
+    INILOAD_FREE(image);
+    INILOAD_FREE(shared->name);
+    INILOAD_FREE(shared);
+    return NULL;
+  }
+  memcpy(view, image, size);
+  memcpy(view, magic, 8);
+  UnmapViewOfFile(view);
+#else
+  /* Attached processes keep the previous segment after it is unlinked. A
+   * concurrent call may create its segment between the two, which is then
+   * replaced in turn. */
+  for (n = 0, fd = -1; fd < 0 && n < 8; n++) {
+    shm_unlink(name);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 && errno != EEXIST) {
+      break;
+    }
+  }
+  done = 0;
+  while (fd >= 0 && done < size) {
+    n = (long)write(fd, image + done, size - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += (size_t)n;
+  }
+  if (done < size || lseek(fd, 0, SEEK_SET) != 0 || write(fd, magic, 8) != 8) {
+    if (fd >= 0) {
+      close(fd);
+      shm_unlink(name);
+    }
+    INILOAD_FREE(image);
+    INILOAD_FREE(shared->name);
+    INILOAD_FREE(shared);
+    return NULL;
+  }
+  close(fd);
+#endif
+  INILOAD_FREE(image);
+  return shared;
+}
+
+ini_file *ini_attach(const char *name) {
+  ini_file *ini = NULL;
+  char *image;
+  size_t size;
+#ifdef INILOAD_WIN32
+  MEMORY_BASIC_INFORMATION info;
+  HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+  if (mapping == NULL) {
+    return NULL;
+  }
+  image = (char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (image == NULL) {
+    return NULL;
+  }
+  /* Views are rounded up to whole pages, the header tells the exact size */
+  if (VirtualQuery(image, &info, sizeof(info)) == 0 ||
+      info.RegionSize < sizeof(ini_image) ||
+      ((const ini_image *)image)->size < sizeof(ini_image) ||
+      ((const ini_image *)image)->size > info.RegionSize) {
+    UnmapViewOfFile(image);
+    return NULL;
+  }
+  size = ((const ini_image *)image)->size;
+#else
+  struct stat st;
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ini_image)) {
+    close(fd);
+    return NULL;
+  }
+  size = (size_t)st.st_size;
+  image = __ini_map(fd, size);
+  close(fd);
+  if (image == NULL) {
+    return NULL;
+  }
+#endif
+  if (__ini_image_valid(image, size)) {
+    ini = __ini_image_attach(image, size);
+  }
+  if (ini == NULL) {
+    __ini_unmap(image, size);
+  }
+  return ini;
+}
+
+void ini_unshare(ini_shared *shared) {
+#ifdef INILOAD_WIN32
+  CloseHandle(shared->mapping);
+#else
+  shm_unlink(shared->name);
+#endif
+  INILOAD_FREE(shared->name);
+  INILOAD_FREE(shared);
+}
+#endif /* INILOAD_HAS_FD */
+
+size_t ini_num_sections(ini_file *ini) { return ini->num_sections; }
+
+int ini_has_section(ini_file *ini, const char *section_name) {
+  return (__ini_find_section(ini, section_name) == NULL ? 0 : 1);
+}
+
+size_t ini_num_keys(ini_file *ini, const char *section_name) {
+  ini_section *section = __ini_find_section(ini, section_name);
+  return (section == NULL ? 0 : section->num_keys);
+}
+
+const char *ini_section_at(ini_file *ini, size_t section) {
+  if (section >= ini->num_sections) {
+    return NULL;
+  }
+  return ini->ptr_pool + ini->ptr_sections[section].name_off;
+}
+
+size_t ini_num_keys_at(ini_file *ini, size_t section) {
+  return (section < ini->num_sections ? ini->ptr_sections[section].num_keys
+                                      : 0);
+}
+
+ini_key_handle ini_key_at(ini_file *ini, size_t section, size_t key) {
+  if (section >= ini->num_sections ||
+      key >= ini->ptr_sections[section].num_keys) {
+    return NULL;
+  }
+  return &ini->ptr_sections[section].ptr_keys[key];
+}
+
+int ini_has_key(ini_file *ini, const char *section_name, const char *key_name) {
+  return (__ini_get_key_ptr(ini, section_name, key_name) == NULL ? 0 : 1);
+}
+
+int ini_get_int(ini_file *ini, const char *section_name, const char *key_name,
+                int default_val) {
+  ini_key *key = __ini_get_key_ptr(ini, section_name, key_name);
+  return ini_get_int_h(ini, INILOAD_COUNT_LOOKUP(ini, key, get_int),
+                       default_val);
+}
+
+float ini_get_float(ini_file *ini, const char *section_name,
+                    const char *key_name, float default_val) {
+  ini_key *key = __ini_get_key_ptr(ini, section_name, key_name);
+  return ini_get_float_h(ini, INILOAD_COUNT_LOOKUP(ini, key, get_float),
+                         default_val);
+}
+
+char *ini_get_string(ini_file *ini, const char *section_name,
+                     const char *key_name, char *default_val) {
+  ini_key *key = __ini_get_key_ptr(ini, section_name, key_name);
+  return ini_get_string_h(ini, INILOAD_COUNT_LOOKUP(ini, key, get_string),
+                          default_val);
+}
+
+ini_int64 ini_get_int64(ini_file *ini, const char *section_name,
+                        const char *key_name, ini_int64 default_val) {
+  ini_key *key = __ini_get_key_ptr(ini, section_name, key_name);
+  return ini_get_int64_h(ini, INILOAD_COUNT_LOOKUP(ini, key, get_int),
+                         default_val);
+}
+
+double ini_get_double(ini_file *ini, const char *section_name,
+                      const char *key_name, double default_val) {
+  ini_key *key = __ini_get_key_ptr(ini, section_name, key_name);
+  return ini_get_double_h(ini, INILOAD_COUNT_LOOKUP(ini, key, get_float),
+                          default_val);
+}
+
+ini_key_handle ini_lookup(ini_file *ini, const char *section_name,
+                          const char *key_name) {
+  ini_key *key = __ini_get_key_ptr(ini, section_name, key_name);
+  return INILOAD_COUNT_LOOKUP(ini, key, lookup);
+}
+
+ini_key_handle ini_lookup_hash(ini_file *ini, const char *section_name,
+                               size_t section_len, const char *key_name,
+                               size_t key_len, unsigned long hash) {
+  size_t i;
+  ini_section *section;
+  ini_key *key;
+  if (ini->cap_key_index == 0 || !__ini_filter_test(ini, hash)) {
+    return INILOAD_COUNT_LOOKUP(ini, (ini_key *)NULL, lookup);
+  }
+  i = hash & (ini->cap_key_index - 1);
+  while (ini->key_index[i].section != 0) {
+    if (ini->key_index[i].hash == hash) {
+      section = &ini->ptr_sections[ini->key_index[i].section - 1];
+      key = &section->ptr_keys[ini->key_index[i].key];
+      if (section->name_len == section_len && key->name_len == key_len &&
+          memcmp(ini->ptr_pool + section->name_off, section_name,
+                 section_len) == 0 &&
+          memcmp(ini->ptr_pool + key->name_off, key_name, key_len) == 0) {
+        return INILOAD_COUNT_LOOKUP(ini, key, lookup);
       }
     }
+    i = (i + 1) & (ini->cap_key_index - 1);
   }
-  return NULL;
+  return INILOAD_COUNT_LOOKUP(ini, (ini_key *)NULL, lookup);
 }
 
-ini_file *ini_load(const char *path) {
-  FILE *f = NULL;
-  long file_size = 0;
-  char *buf = 0;
-  size_t name_pos = 0;
-  size_t name_len = 0;
-  size_t value_pos = 0;
-  size_t value_len = 0;
-  ini_file *ptr = NULL;
+ini_key_type ini_get_type_h(ini_file *ini, ini_key_handle key) {
+  if (key->type == INI_KEY_LAZY) {
+    __ini_resolve_key(ini, key);
+  }
+  return key->type;
+}
 
-  size_t i = 0;
-  char c = 0;
-  char tmp = 0;
-  char tmp2 = 0;
+int ini_get_int_h(ini_file *ini, ini_key_handle key, int default_val) {
+  if (key != NULL && key->type == INI_KEY_LAZY) {
+    __ini_resolve_key(ini, key);
+  }
+  if (key == NULL || key->type != INI_KEY_INT) {
+    return default_val;
+  } else {
+    return (int)key->value.int_val;
+  }
+}
 
-  int alloc_error = 0;
-  int bad_syntax = 0;
+float ini_get_float_h(ini_file *ini, ini_key_handle key, float default_val) {
+  if (key != NULL && key->type == INI_KEY_LAZY) {
+    __ini_resolve_key(ini, key);
+  }
+  if (key == NULL || key->type != INI_KEY_FLOAT) {
+    return default_val;
+  } else {
+    return (float)key->value.float_val;
+  }
+}
 
-  ini_section *curr_section = NULL;
+char *ini_get_string_h(ini_file *ini, ini_key_handle key, char *default_val) {
+  if (key != NULL && key->type == INI_KEY_LAZY) {
+    __ini_resolve_key(ini, key);
+  }
+  if (key == NULL || key->type != INI_KEY_STRING) {
+    return default_val;
+  } else {
+    return ini->ptr_pool + key->value.string_off;
+  }
+}
 
-  enum {
-    INIPS_NONE,
-    INIPS_COMMENT,
-    INIPS_SECTION_NAME,
-    INIPS_AFTER_SECTION_NAME,
-    INIPS_KEY_NAME,
-    INIPS_AFTER_KEY_NAME,
-    INIPS_BEFORE_KEY_VALUE,
-    INIPS_QUOTED_VALUE,
-    INIPS_NON_QUOTED_VALUE,
-    INIPS_AFTER_KEY_VALUE
-  } state = INIPS_NONE;
-
-  f = fopen(path, "rt");
+ini_int64 ini_get_int64_h(ini_file *ini, ini_key_handle key,
+                          ini_int64 default_val) {
+  if (key != NULL && key->type == INI_KEY_LAZY) {
+    __ini_resolve_key(ini, key);
+  }
+  if (key == NULL ||
+      (key->type != INI_KEY_INT && key->type != INI_KEY_INT64)) {
+    return default_val;
+  } else {
+    return key->value.int_val;
+  }
+}
 
-  if (f == NULL) {
-    return NULL;
+double ini_get_double_h(ini_file *ini, ini_key_handle key,
+                        double default_val) {
+  if (key != NULL && key->type == INI_KEY_LAZY) {
+    __ini_resolve_key(ini, key);
+  }
+  if (key == NULL ||
+      (key->type != INI_KEY_FLOAT && key->type != INI_KEY_DOUBLE)) {
+    return default_val;
+  } else {
+    return key->value.float_val;
   }
+}
 
-  fseek(f, 0, SEEK_END);
-  file_size = ftell(f);
-  fseek(f, 0, SEEK_SET);
+const char *ini_get_name_h(ini_file *ini, ini_key_handle key) {
+  return ini->ptr_pool + key->name_off;
+}
 
-  /* Read the entire file */
-  buf = (char *)malloc(sizeof(char) * file_size + 1);
-  if (buf == NULL) {
-    fclose(f);
-    return NULL;
+size_t ini_get_batch(ini_file *ini, const ini_batch_key *keys,
+                     size_t num_keys) {
+  const char *section_name = NULL;
+  unsigned long section_hash = 0;
+  size_t i, len, s = 0;
+  size_t found = 0;
+  ini_key *key;
+  ini_key_type type;
+
+  for (i = 0; i < num_keys; i++) {
+    if (keys[i].section_name != NULL &&
+        (section_name == NULL || (keys[i].section_name != section_name &&
+                                  strcmp(keys[i].section_name,
+                                         section_name) != 0))) {
+      /* A new group of keys */
+      section_name = keys[i].section_name;
+      len = strlen(section_name);
+      section_hash = __ini_hash_len(INILOAD_HASH_SEED, section_name, len);
+      s = __ini_find_section_len(ini, section_name, len, section_hash);
+    }
+    if (s == 0) {
+      key = INILOAD_COUNT_LOOKUP(ini, (ini_key *)NULL, lookup);
+      continue;
+    }
+    len = strlen(keys[i].key_name);
+    key = __ini_find_key(ini, s - 1, keys[i].key_name, len,
+                         __ini_hash_key_len(section_hash, keys[i].key_name,
+                                            len));
+    key = INILOAD_COUNT_LOOKUP(ini, key, lookup);
+    if (key != NULL && key->type == INI_KEY_LAZY) {
+      __ini_resolve_key(ini, key);
+    }
+    if (key == NULL) {
+      continue;
+    }
+    /* The wide types also take the values of the narrow ones */
+    type = keys[i].type;
+    if (key->type != type &&
+        !(type == INI_KEY_INT64 && key->type == INI_KEY_INT) &&
+        !(type == INI_KEY_DOUBLE && key->type == INI_KEY_FLOAT)) {
+      continue;
+    }
+    if (type == INI_KEY_INT) {
+      *(int *)keys[i].out = (int)key->value.int_val;
+    } else if (type == INI_KEY_FLOAT) {
+      *(float *)keys[i].out = (float)key->value.float_val;
+    } else if (type == INI_KEY_INT64) {
+      *(ini_int64 *)keys[i].out = key->value.int_val;
+    } else if (type == INI_KEY_DOUBLE) {
+      *(double *)keys[i].out = key->value.float_val;
+    } else {
+      *(char **)keys[i].out = ini->ptr_pool + key->value.string_off;
+    }
+    found++;
   }
+  return found;
+}
 
-  if (fread(buf, 1, file_size, f) != file_size) {
-    fclose(f);
-    free(buf);
-    return NULL;
+ini_file *ini_create(void) { return __ini_create(NULL, 0); }
+
+/* Gives every section of a frozen file its own array of keys again, so that
+ * keys can be added */
+int __ini_thaw(ini_file *ini) {
+  ini_key **arrays;
+  ini_section *section;
+  size_t s, cap;
+  arrays = (ini_key **)INILOAD_MALLOC(sizeof(ini_key *) * ini->num_sections +
+                                      1);
+  if (arrays == NULL) {
+    return 0;
   }
-  fclose(f);
-  buf[file_size] = '\0';
+  for (s = 0; s < ini->num_sections; s++) {
+    section = &ini->ptr_sections[s];
+    cap = (section->num_keys > 0 ? section->num_keys : 1);
+    arrays[s] = (ini_key *)__ini_malloc(ini->arena, sizeof(ini_key) * cap);
+    if (arrays[s] == NULL) {
+      while (s > 0) {
+        __ini_mfree(ini->arena, arrays[--s]);
+      }
+      INILOAD_FREE(arrays);
+      return 0;
+    }
+    INILOAD_COUNT_ALLOC(ini, sizeof(ini_key) * cap, 0);
+  }
+  for (s = 0; s < ini->num_sections; s++) {
+    section = &ini->ptr_sections[s];
+    if (section->num_keys > 0) {
+      memcpy(arrays[s], section->ptr_keys,
+             sizeof(ini_key) * section->num_keys);
+    }
+    section->ptr_keys = arrays[s];
+    section->cap_keys = (section->num_keys > 0 ? section->num_keys : 1);
+  }
+  __ini_mfree(ini->arena, ini->frozen);
+  ini->frozen = NULL;
+  INILOAD_FREE(arrays);
+  return 1;
+}
 
-  /* Allocate memory for the ini file struct */
-  ptr = (ini_file *)malloc(sizeof(ini_file));
-  if (ptr == NULL) {
-    free(buf);
-    return NULL;
+/* Checks that a section or key name reads back the same from the text that
+ * ini_save() writes */
+int __ini_valid_name(const char *name, int is_key) {
+  size_t i;
+  char c;
+  if (is_key && (name[0] == '\0' || name[0] == ';' || name[0] == '#')) {
+    return 0;
   }
+  for (i = 0; name[i] != '\0'; i++) {
+    c = name[i];
+    if (c == '[' || c == ']' || c == '=' || c == '\r' || c == '\n' ||
+        (is_key ? c == ' ' || c == '\t' : c == ';' || c == '#')) {
+      return 0;
+    }
+  }
+  return i <= INILOAD_NAME_MAXLEN;
+}
 
-  /* Allocate memory for the array of sections */
-  ptr->ptr_sections =
-      (ini_section *)malloc(sizeof(ini_section) * INILOAD_INITIAL_CAP);
-  if (!ptr->ptr_sections) {
-    free(buf);
-    free(ptr);
-    return NULL;
+/* Returns 0 if a string value can be written as it is, 1 if it has to be
+ * quoted to read back as the same string and -1 if it can not be written */
+int __ini_quote_string(const char *str) {
+  ini_int64 int_val;
+  double float_val;
+  const char *p;
+  int quotes = (str[0] == '\0' || str[0] == ' ' || str[0] == '\t');
+  int has_quote = 0;
+  for (p = str; *p != '\0'; p++) {
+    if (*p == '\r' || *p == '\n') {
+      return -1;
+    } else if (*p == '[' || *p == ']' || *p == '=') {
+      quotes = 1;
+    } else if (*p == '\"') {
+      has_quote = 1;
+    }
   }
-  ptr->cap_sections = INILOAD_INITIAL_CAP;
-  ptr->num_sections = 0;
+  if (!quotes && str[0] != '\"' &&
+      __ini_classify(str, &int_val, &float_val) != INI_KEY_STRING) {
+    quotes = 1;
+  }
+  if (has_quote && (quotes || str[0] == '\"')) {
+    return -1;
+  }
+  return quotes;
+}
 
-/* Parse using a state machine/automaton */
-#define IS_SPACE(c) (c == ' ' || c == '\t')
-#define IS_NEWLINE(c) (c == '\r' || c == '\n')
-#define IS_EOF(c) (c == '\0')
-#define IS_NEWLINE_OR_EOF(c) (IS_NEWLINE(c) || IS_EOF(c))
-#define IS_COMMENT(c) (c == ';' || c == '#')
+/* Writes the decimal digits of an integer, returns their number */
+size_t __ini_format_int(char *str, ini_int64 value) {
+  char digits[24];
+  size_t n = 0, len = 0;
+  ini_uint64 u = (ini_uint64)value;
+  if (value < 0) {
+    u = (ini_uint64)0 - u;
+    str[len++] = '-';
+  }
+  do {
+    digits[n++] = (char)('0' + u % 10);
+    u /= 10;
+  } while (u != 0);
+  while (n > 0) {
+    str[len++] = digits[--n];
+  }
+  str[len] = '\0';
+  return len;
+}
 
-  for (i = 0; i < file_size + 1 && !bad_syntax && !alloc_error; i++) {
-    c = buf[i];
-    /*printf("%c <--- %d\n", c, state);*/
+/* Writes the digits of a number rounded to a number of significant digits
+ * in decimal notation, e.g. 0.001 or 1200.5, without trailing zeros. e is
+ * the exponent of the first digit, the caller keeps it within [-4, 8] and
+ * the precision within [1, 15]. */
+size_t __ini_format_fixed(char *str, double value, int precision, int e) {
+  static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,
+                                 1e7,  1e8,  1e9,  1e10, 1e11, 1e12, 1e13,
+                                 1e14, 1e15, 1e16, 1e17, 1e18};
+  double x = (value < 0 ? -value : value);
+  int k = precision - 1 - e;
+  char digits[16];
+  ini_uint64 m;
+  size_t len = 0;
+  int i, last;
 
-    switch (state) {
-    case INIPS_NONE:
-      if (IS_SPACE(c) || IS_NEWLINE_OR_EOF(c)) {
-        /* Do nothing */
-      } else if (IS_COMMENT(c)) {
-        state = INIPS_COMMENT;
-      } else if (c == '[') {
-        name_pos = i + 1;
-        name_len = 0;
-        state = INIPS_SECTION_NAME;
+  m = (ini_uint64)((k >= 0 ? x * pow10[k] : x / pow10[-k]) + 0.5);
+  if ((double)m >= pow10[precision]) {
+    /* Rounded up to the next power of ten */
+    return __ini_format_fixed(str, value, precision, e + 1);
+  }
+  for (i = precision - 1; i >= 0; i--) {
+    digits[i] = (char)('0' + m % 10);
+    m /= 10;
+  }
+  if (value < 0) {
+    str[len++] = '-';
+  }
+  if (e >= 0) {
+    for (i = 0; i <= e; i++) {
+      str[len++] = (i < precision ? digits[i] : '0');
+    }
+  } else {
+    str[len++] = '0';
+    i = 0;
+  }
+  str[len++] = '.';
+  for (k = e; k < -1; k++) {
+    str[len++] = '0';
+  }
+  /* A point is followed by at least one digit to stay a float */
+  for (last = precision - 1; last > i && digits[last] == '0'; last--) {
+  }
+  if (i > last) {
+    str[len++] = '0';
+  }
+  for (; i <= last; i++) {
+    str[len++] = digits[i];
+  }
+  str[len] = '\0';
+  return len;
+}
+
+/* Writes a float with the fewest significant digits that the loader reads
+ * back to the same value, into at least 32 bytes. Usual magnitudes are
+ * rounded in double precision, the others printed with sprintf(). If 6
+ * digits suffice, no shorter form can differ from them since a normal float
+ * is closer to a shorter decimal than half of the step between 6-digit
+ * decimals. */
+size_t __ini_format_float(char *str, float value) {
+  ini_int64 int_val;
+  double float_val = 0.0;
+  double x = (value < 0 ? -(double)value : (double)value);
+  double p;
+  ini_key_type type;
+  int precision, e;
+  size_t len;
+  if (value != value) {
+    strcpy(str, "nan");
+    return 3;
+  }
+  if (x >= 1e-4 && x < 1e9) {
+    /* Exponent of the first digit, off by one only next to a power of ten
+     * where the rounding corrects it */
+    for (e = 8, p = 1e8; p > x; e--, p /= 10) {
+    }
+    for (precision = 6; precision <= 9; precision++) {
+      len = __ini_format_fixed(str, value, precision, e);
+      if (__ini_classify(str, &int_val, &float_val) == INI_KEY_FLOAT &&
+          (float)float_val == value) {
+        return len;
+      }
+    }
+  }
+  /* Subnormal floats are less precise, they can need fewer digits */
+  for (precision = (x < 1.17549435e-38 ? 1 : 6);; precision++) {
+    len = (size_t)sprintf(str, "%.*g", precision, (double)value);
+    type = __ini_classify(str, &int_val, &float_val);
+    if (type == INI_KEY_INT) {
+      /* A float that is an integer keeps a point to stay a float */
+      strcpy(str + len, ".0");
+      len += 2;
+      float_val = (double)int_val;
+    }
+    if (precision == 9 || (float)float_val == value) {
+      return len;
+    }
+  }
+}
+
+/* Writes a double with the fewest significant digits that the loader reads
+ * back to the same value like __ini_format_float(). Digits past the 15th
+ * are not exact when rounded in double precision, they are left to
+ * sprintf(). */
+size_t __ini_format_double(char *str, double value) {
+  ini_int64 int_val;
+  double float_val = 0.0;
+  double x = (value < 0 ? -value : value);
+  double p;
+  ini_key_type type;
+  int precision, e;
+  size_t len;
+  if (value != value) {
+    strcpy(str, "nan");
+    return 3;
+  }
+  if (x >= 1e-4 && x < 1e9) {
+    for (e = 8, p = 1e8; p > x; e--, p /= 10) {
+    }
+    for (precision = 6; precision <= 15; precision++) {
+      len = __ini_format_fixed(str, value, precision, e);
+      if (__ini_classify(str, &int_val, &float_val) == INI_KEY_FLOAT &&
+          float_val == value) {
+        return len;
+      }
+    }
+  }
+  for (precision = (x < DBL_MIN ? 1 : 6);; precision++) {
+    len = (size_t)sprintf(str, "%.*g", precision, value);
+    type = __ini_classify(str, &int_val, &float_val);
+    if (type == INI_KEY_INT) {
+      strcpy(str + len, ".0");
+      len += 2;
+      float_val = (double)int_val;
+    }
+    if (precision == 17 || float_val == value) {
+      return len;
+    }
+  }
+}
+
+/* Adds the section and sets the key to a value like a parsed line would */
+int __ini_set(ini_file *ini, const char *section_name, const char *key_name,
+              const char *value, size_t value_len, int quotes) {
+  ini_section *section;
+  size_t value_off = (size_t)-1;
+  if (ini->image != NULL || !__ini_valid_name(section_name, 0) ||
+      !__ini_valid_name(key_name, 1)) {
+    return 0;
+  }
+  if (ini->frozen != NULL && !__ini_thaw(ini)) {
+    return 0;
+  }
+  if (ini->flags & INI_LOAD_ZERO_COPY) {
+    /* New strings are appended to the text, after its NUL character */
+    ini->flags &= ~(unsigned int)INI_LOAD_ZERO_COPY;
+    ini->size_pool = ini->cap_pool;
+  }
+  /* The sections no longer match their text */
+  ini->incremental = 0;
+  if (ini->ptr_pool != NULL && value >= ini->ptr_pool &&
+      value < ini->ptr_pool + ini->cap_pool) {
+    /* A string of the pool, e.g. the value of another key, follows the pool
+     * when it grows and must not move again until it is copied */
+    value_off = (size_t)(value - ini->ptr_pool);
+  }
+  if (!__ini_pool_reserve(ini, strlen(section_name) + strlen(key_name) +
+                                   value_len + 3)) {
+    return 0;
+  }
+  if (value_off != (size_t)-1) {
+    value = ini->ptr_pool + value_off;
+  }
+  section = __ini_add_section(ini, section_name, strlen(section_name));
+  if (section == NULL) {
+    return 0;
+  }
+  return __ini_add_key(ini, section, key_name, strlen(key_name), value,
+                       value_len, quotes);
+}
+
+int ini_set_int(ini_file *ini, const char *section_name, const char *key_name,
+                int value) {
+  char text[32];
+  return __ini_set(ini, section_name, key_name, text,
+                   __ini_format_int(text, value), 0);
+}
+
+int ini_set_float(ini_file *ini, const char *section_name,
+                  const char *key_name, float value) {
+  char text[32];
+  return __ini_set(ini, section_name, key_name, text,
+                   __ini_format_float(text, value), 0);
+}
+
+int ini_set_int64(ini_file *ini, const char *section_name,
+                  const char *key_name, ini_int64 value) {
+  char text[32];
+  return __ini_set(ini, section_name, key_name, text,
+                   __ini_format_int(text, value), 0);
+}
+
+int ini_set_double(ini_file *ini, const char *section_name,
+                   const char *key_name, double value) {
+  char text[32];
+  return __ini_set(ini, section_name, key_name, text,
+                   __ini_format_double(text, value), 0);
+}
+
+int ini_set_string(ini_file *ini, const char *section_name,
+                   const char *key_name, const char *value) {
+  if (__ini_quote_string(value) < 0) {
+    return 0;
+  }
+  return __ini_set(ini, section_name, key_name, value, strlen(value), 1);
+}
+
+/* Writes the buffer to the file */
+void __ini_flush(ini_writer *w) {
+  if (w->pos > 0 && fwrite(w->buf, 1, w->pos, w->f) != w->pos) {
+    w->error = 1;
+  }
+  w->pos = 0;
+}
+
+/* Appends len bytes to the text, flushing the buffer or cutting the text
+ * when the buffer is full */
+void __ini_put(ini_writer *w, const char *str, size_t len) {
+  size_t n;
+  w->len += len;
+  while (len > 0) {
+    n = (w->size - w->pos < len ? w->size - w->pos : len);
+    if (n > 0) {
+      memcpy(w->buf + w->pos, str, n);
+      w->pos += n;
+      str += n;
+      len -= n;
+    }
+    if (len > 0) {
+      if (w->f == NULL) {
+        return;
+      }
+      __ini_flush(w);
+    }
+  }
+}
+
+/* Formats the sections and keys in file order */
+void __ini_write(ini_file *ini, ini_writer *w) {
+  ini_section *section;
+  ini_key *key;
+  char *str;
+  char num[32];
+  size_t s, k;
+  int quotes;
+  for (s = 0; s < ini->num_sections; s++) {
+    section = &ini->ptr_sections[s];
+    if (s > 0) {
+      __ini_put(w, "\n", 1);
+    }
+    if (s > 0 || section->name_len > 0 || section->num_keys == 0) {
+      /* The keys before the first header need none, an empty "" section
+       * is only kept by its header */
+      __ini_put(w, "[", 1);
+      __ini_put(w, ini->ptr_pool + section->name_off, section->name_len);
+      __ini_put(w, "]\n", 2);
+    }
+    for (k = 0; k < section->num_keys; k++) {
+      key = &section->ptr_keys[k];
+      __ini_put(w, ini->ptr_pool + key->name_off, key->name_len);
+      __ini_put(w, " = ", 3);
+      if (key->type == INI_KEY_INT || key->type == INI_KEY_INT64) {
+        __ini_put(w, num, __ini_format_int(num, key->value.int_val));
+      } else if (key->type == INI_KEY_FLOAT ||
+                 key->type == INI_KEY_DOUBLE) {
+        __ini_put(w, num, __ini_format_double(num, key->value.float_val));
       } else {
-        /* Everything else could be a key name */
-        name_pos = i;
-        name_len = 1;
-        state = INIPS_KEY_NAME;
+        /* The text of a lazy value is written as it was loaded */
+        str = ini->ptr_pool + key->value.string_off;
+        quotes = (key->type == INI_KEY_STRING && __ini_quote_string(str));
+        if (quotes) {
+          __ini_put(w, "\"", 1);
+        }
+        __ini_put(w, str, strlen(str));
+        if (quotes) {
+          __ini_put(w, "\"", 1);
+        }
       }
-      break;
+      __ini_put(w, "\n", 1);
+    }
+  }
+}
+
+int ini_save(ini_file *ini, const char *path) {
+  ini_writer w;
+  w.buf = (char *)INILOAD_MALLOC(INILOAD_WRITE_BUFFER_SIZE);
+  if (w.buf == NULL) {
+    return 0;
+  }
+  w.f = fopen(path, "wb");
+  if (w.f == NULL) {
+    INILOAD_FREE(w.buf);
+    return 0;
+  }
+  w.size = INILOAD_WRITE_BUFFER_SIZE;
+  w.pos = 0;
+  w.len = 0;
+  w.error = 0;
+  __ini_write(ini, &w);
+  __ini_flush(&w);
+  if (fclose(w.f) != 0) {
+    w.error = 1;
+  }
+  INILOAD_FREE(w.buf);
+  return !w.error;
+}
+
+size_t ini_save_mem(ini_file *ini, char *buf, size_t size) {
+  ini_writer w;
+  w.buf = buf;
+  w.size = (buf != NULL && size > 0 ? size - 1 : 0);
+  w.pos = 0;
+  w.len = 0;
+  w.f = NULL;
+  w.error = 0;
+  __ini_write(ini, &w);
+  if (buf != NULL && size > 0) {
+    buf[w.pos] = '\0';
+  }
+  return w.len;
+}
+
+int ini_get_stats(ini_file *ini, ini_stats *stats) {
+  size_t s;
+#ifdef INILOAD_ENABLE_STATS
+  /* Only the lookup counters change while the file is read */
+  stats->bytes_read = ini->stats.bytes_read;
+  stats->read_seconds = ini->stats.read_seconds;
+  stats->parse_seconds = ini->stats.parse_seconds;
+  stats->num_allocs = ini->stats.num_allocs;
+  stats->alloc_bytes = ini->stats.alloc_bytes;
+  stats->num_grows = ini->stats.num_grows;
+  stats->get_int_calls = __ini_count_read(&ini->stats.get_int_calls);
+  stats->get_int_misses = __ini_count_read(&ini->stats.get_int_misses);
+  stats->get_float_calls = __ini_count_read(&ini->stats.get_float_calls);
+  stats->get_float_misses = __ini_count_read(&ini->stats.get_float_misses);
+  stats->get_string_calls = __ini_count_read(&ini->stats.get_string_calls);
+  stats->get_string_misses =
+      __ini_count_read(&ini->stats.get_string_misses);
+  stats->lookup_calls = __ini_count_read(&ini->stats.lookup_calls);
+  stats->lookup_misses = __ini_count_read(&ini->stats.lookup_misses);
+#else
+  memset(stats, 0, sizeof(ini_stats));
+#endif
+  stats->num_sections = ini->num_sections;
+  stats->num_keys = 0;
+  for (s = 0; s < ini->num_sections; s++) {
+    stats->num_keys += ini->ptr_sections[s].num_keys;
+  }
+#ifdef INILOAD_ENABLE_STATS
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+size_t ini_hot_keys(ini_file *ini, ini_key_stats *keys, size_t max_keys) {
+  size_t num_keys = 0;
+#ifdef INILOAD_ENABLE_STATS
+  ini_key_stats entry;
+  ini_section *section;
+  size_t s, k, i, lookups;
+  if (ini->image != NULL) {
+    return 0;
+  }
+  /* Insertion into the sorted list of the most looked up keys so far, which
+   * is short compared to the number of keys */
+  for (s = 0; s < ini->num_sections; s++) {
+    section = &ini->ptr_sections[s];
+    for (k = 0; k < section->num_keys; k++) {
+      lookups = __ini_count_read(&section->ptr_keys[k].lookups);
+      if (lookups == 0 ||
+          (num_keys == max_keys &&
+           (max_keys == 0 || keys[max_keys - 1].lookups >= lookups))) {
+        continue;
+      }
+      entry.section_name = ini->ptr_pool + section->name_off;
+      entry.key_name = ini->ptr_pool + section->ptr_keys[k].name_off;
+      entry.lookups = lookups;
+      i = (num_keys < max_keys ? num_keys++ : max_keys - 1);
+      while (i > 0 && keys[i - 1].lookups < entry.lookups) {
+        keys[i] = keys[i - 1];
+        i--;
+      }
+      keys[i] = entry;
+    }
+  }
+#else
+  (void)ini;
+  (void)keys;
+  (void)max_keys;
+#endif
+  return num_keys;
+}
+
+void ini_free(ini_file *ini) {
+  size_t s;
+  if (ini->arena != NULL) {
+    __ini_arena_free(ini->arena);
+    return;
+  }
+#ifdef INILOAD_HAS_FD
+  if (ini->image != NULL) {
+    /* Only the sections are not part of the snapshot */
+    INILOAD_FREE(ini->ptr_sections);
+    __ini_unmap(ini->image, ini->image_size);
+    INILOAD_FREE(ini);
+    return;
+  }
+#endif
+  if (ini->frozen != NULL) {
+    /* All keys are in one array */
+    INILOAD_FREE(ini->frozen);
+  } else {
+    for (s = 0; s < ini->num_sections; s++) {
+      INILOAD_FREE(ini->ptr_sections[s].ptr_keys);
+    }
+  }
+  INILOAD_FREE(ini->ptr_sections);
+  INILOAD_FREE(ini->section_index);
+  INILOAD_FREE(ini->key_index);
+  INILOAD_FREE(ini->key_filter);
+  INILOAD_FREE(ini->ptr_pool);
+  INILOAD_FREE(ini);
+}
+
+#ifdef INILOAD_HAS_ATOMICS
+ini_live *ini_live_create(const char *path, const ini_options *options) {
+  ini_live *live;
+  if (options != NULL && options->arena_buf != NULL) {
+    return NULL;
+  }
+  live = (ini_live *)INILOAD_MALLOC(sizeof(ini_live));
+  if (live == NULL) {
+    return NULL;
+  }
+  memset(live, 0, sizeof(ini_live));
+  if (options != NULL) {
+    live->options = *options;
+  }
+  live->options.flags &= ~(unsigned int)INI_LOAD_LAZY;
+  live->path = (char *)INILOAD_MALLOC(strlen(path) + 1);
+  if (live->path == NULL) {
+    INILOAD_FREE(live);
+    return NULL;
+  }
+  strcpy(live->path, path);
+  live->current = ini_load_ex(path, &live->options);
+  if (live->current == NULL) {
+    INILOAD_FREE(live->path);
+    INILOAD_FREE(live);
+    return NULL;
+  }
+  return live;
+}
 
-    case INIPS_COMMENT:
-      if (IS_NEWLINE_OR_EOF(c)) {
-        state = INIPS_NONE;
-      } else {
-        /* Do nothing, read the comment */
-      }
+ini_file *ini_live_acquire(ini_live *live, size_t *slot) {
+  long epoch;
+  for (;;) {
+    epoch = __ini_atomic_load(&live->epoch);
+    __ini_atomic_add(&live->readers[epoch & 1], 1);
+    if (__ini_atomic_load(&live->epoch) == epoch) {
       break;
+    }
+    /* A writer moved on meanwhile and may not wait for this counter */
+    __ini_atomic_add(&live->readers[epoch & 1], -1);
+  }
+  *slot = (size_t)(epoch & 1);
+  return (ini_file *)__ini_atomic_load_ptr((void *volatile *)&live->current);
+}
 
-    case INIPS_SECTION_NAME:
-      if (c == ']') {
-        /* Add the new section */
-        if (name_len > INILOAD_NAME_MAXLEN) {
-          /* Name is too long */
-          bad_syntax = 1;
-          break;
-        }
-        /* "Cut" the buffer to extract the section name */
-        tmp = buf[name_pos + name_len];
-        buf[name_pos + name_len] = '\0';
-        curr_section = __ini_add_section(ptr, buf + name_pos);
-        if (curr_section == NULL) {
-          alloc_error = 1;
-          break;
-        }
-        /* Restore the buffer */
-        buf[name_pos + name_len] = tmp;
-        state = INIPS_AFTER_SECTION_NAME;
-      } else if (c == '[' || c == '=' || IS_NEWLINE_OR_EOF(c) ||
-                 IS_COMMENT(c)) {
-        bad_syntax = 1;
-      } else {
-        name_len++;
-      }
-      break;
+void ini_live_release(ini_live *live, size_t slot) {
+  __ini_atomic_add(&live->readers[slot], -1);
+}
 
-    case INIPS_AFTER_SECTION_NAME:
-      if (IS_NEWLINE_OR_EOF(c)) {
-        state = INIPS_NONE;
-      } else if (IS_SPACE(c)) {
-      } else {
-        bad_syntax = 1;
-      }
-      break;
+int ini_live_reload(ini_live *live) {
+  ini_file *ini = ini_load_ex(live->path, &live->options);
+  if (ini == NULL) {
+    return 0;
+  }
+  ini_live_publish(live, ini);
+  return 1;
+}
 
-    case INIPS_KEY_NAME:
-      if (IS_SPACE(c)) {
-        state = INIPS_AFTER_KEY_NAME;
-      } else if (c == '=') {
-        state = INIPS_BEFORE_KEY_VALUE;
-      } else if (c == '[' || c == ']' || IS_NEWLINE_OR_EOF(c)) {
-        bad_syntax = 1;
-      } else {
-        name_len++;
-      }
-      if (name_len > INILOAD_NAME_MAXLEN) {
-        bad_syntax = 1;
-        break;
-      }
-      break;
+void ini_live_publish(ini_live *live, ini_file *ini) {
+  ini_file *old;
+  size_t s, k;
+  long epoch;
 
-    case INIPS_AFTER_KEY_NAME:
-      if (IS_SPACE(c)) {
-      } else if (c == '=') {
-        state = INIPS_BEFORE_KEY_VALUE;
-      } else {
-        bad_syntax = 1;
+  /* Readers must not write to the keys */
+  for (s = 0; s < ini->num_sections && (ini->flags & INI_LOAD_LAZY); s++) {
+    for (k = 0; k < ini->ptr_sections[s].num_keys; k++) {
+      if (ini->ptr_sections[s].ptr_keys[k].type == INI_KEY_LAZY) {
+        __ini_resolve_key(ini, &ini->ptr_sections[s].ptr_keys[k]);
       }
-      break;
+    }
+  }
 
-    case INIPS_BEFORE_KEY_VALUE:
-      if (IS_SPACE(c)) {
-      } else if (IS_NEWLINE_OR_EOF(c) || c == '=' || c == '[' || c == ']') {
-        bad_syntax = 1;
-      } else if (c == '\"') {
-        value_pos = i + 1;
-        value_len = 0;
-        state = INIPS_QUOTED_VALUE;
-      } else {
-        value_pos = i;
-        value_len = 1;
-        state = INIPS_NON_QUOTED_VALUE;
-      }
-      break;
+  while (__ini_atomic_swap(&live->busy, 1) != 0) {
+    __ini_yield();
+  }
+  old = (ini_file *)__ini_atomic_swap_ptr((void *volatile *)&live->current,
+                                          ini);
+  epoch = __ini_atomic_load(&live->epoch);
+  __ini_atomic_add(&live->epoch, 1);
+  /* Readers registered from now on see the new version */
+  while (__ini_atomic_load(&live->readers[epoch & 1]) != 0) {
+    __ini_yield();
+  }
+  __ini_atomic_swap(&live->busy, 0);
+  ini_free(old);
+}
 
-    case INIPS_QUOTED_VALUE:
-      if (c == '\"') {
-        /* Insert the key */
-        tmp = buf[name_pos + name_len];
-        buf[name_pos + name_len] = '\0';
-        tmp2 = buf[value_pos + value_len];
-        buf[value_pos + value_len] = '\0';
-        if (curr_section == NULL) {
-          /* Empty section but we don't have it yet */
-          curr_section = __ini_add_section(ptr, "");
-          if (curr_section == NULL) {
-            alloc_error = 1;
-            break;
-          }
-        }
+void ini_live_free(ini_live *live) {
+  ini_free(live->current);
+  INILOAD_FREE(live->path);
+  INILOAD_FREE(live);
+}
+#endif
 
-        __ini_add_key(curr_section, buf + name_pos, buf + value_pos, value_len,
-                      1);
+ini_stack *ini_stack_create(ini_file *const *files, size_t num_files) {
+  ini_stack *stack = (ini_stack *)INILOAD_MALLOC(sizeof(ini_stack));
+  if (stack == NULL) {
+    return NULL;
+  }
+  stack->files = (ini_file **)INILOAD_MALLOC(sizeof(ini_file *) * num_files +
+                                             1);
+  if (stack->files == NULL) {
+    INILOAD_FREE(stack);
+    return NULL;
+  }
+  if (num_files > 0) {
+    memcpy(stack->files, files, sizeof(ini_file *) * num_files);
+  }
+  stack->num_files = num_files;
+  stack->num_keys = 0;
+  stack->num_cache = 0;
+  stack->cap_cache = 0;
+  stack->cache = NULL;
+  return stack;
+}
 
-        /* Restore the buffer */
-        buf[name_pos + name_len] = tmp;
-        buf[value_pos + value_len] = tmp2;
-        state = INIPS_AFTER_KEY_VALUE;
-      } else if (IS_NEWLINE_OR_EOF(c)) {
-        bad_syntax = 1;
-      } else {
-        value_len++;
-      }
-      break;
+ini_file *ini_stack_replace(ini_stack *stack, size_t layer, ini_file *ini) {
+  ini_file *old = stack->files[layer];
+  stack->files[layer] = ini;
+  if (stack->num_cache > 0) {
+    memset(stack->cache, 0, sizeof(ini_stack_entry) * stack->cap_cache);
+    stack->num_cache = 0;
+  }
+  return old;
+}
 
-    case INIPS_NON_QUOTED_VALUE:
-      if (IS_NEWLINE_OR_EOF(c)) {
-        tmp = buf[name_pos + name_len];
-        buf[name_pos + name_len] = '\0';
-        tmp2 = buf[value_pos + value_len];
-        buf[value_pos + value_len] = '\0';
-        if (curr_section == NULL) {
-          /* Empty section but we don't have it yet */
-          curr_section = __ini_add_section(ptr, "");
-          if (curr_section == NULL) {
-            alloc_error = 1;
-            break;
-          }
+/* Remembers where a key was found, a full cache is doubled */
+void __ini_stack_remember(ini_stack *stack, unsigned long hash, size_t layer,
+                          size_t s, size_t k) {
+  ini_stack_entry *new_cache;
+  size_t new_cap, i, j;
+  if ((stack->num_cache + 1) * 2 > stack->cap_cache) {
+    new_cap = (stack->cap_cache == 0 ? INILOAD_INITIAL_CAP * 2
+                                     : stack->cap_cache * 2);
+    new_cache = (ini_stack_entry *)INILOAD_MALLOC(sizeof(ini_stack_entry) *
+                                                  new_cap);
+    if (new_cache == NULL) {
+      /* The key is only looked up again next time */
+      return;
+    }
+    memset(new_cache, 0, sizeof(ini_stack_entry) * new_cap);
+    for (i = 0; i < stack->cap_cache; i++) {
+      if (stack->cache[i].layer != 0) {
+        j = stack->cache[i].hash & (new_cap - 1);
+        while (new_cache[j].layer != 0) {
+          j = (j + 1) & (new_cap - 1);
         }
+        new_cache[j] = stack->cache[i];
+      }
+    }
+    INILOAD_FREE(stack->cache);
+    stack->cache = new_cache;
+    stack->cap_cache = new_cap;
+  }
+  i = hash & (stack->cap_cache - 1);
+  while (stack->cache[i].layer != 0) {
+    i = (i + 1) & (stack->cap_cache - 1);
+  }
+  stack->cache[i].hash = hash;
+  stack->cache[i].layer = layer + 1;
+  stack->cache[i].section = s;
+  stack->cache[i].key = k;
+  stack->num_cache++;
+}
 
-        __ini_add_key(curr_section, buf + name_pos, buf + value_pos, value_len,
-                      0);
+ini_key_handle ini_stack_lookup(ini_stack *stack, const char *section_name,
+                                const char *key_name, ini_file **file) {
+  size_t section_len = strlen(section_name);
+  size_t key_len = strlen(key_name);
+  unsigned long section_hash =
+      __ini_hash_len(INILOAD_HASH_SEED, section_name, section_len);
+  unsigned long hash = __ini_hash_key_len(section_hash, key_name, key_len);
+  size_t num_keys = 0;
+  size_t i, layer, s;
+  ini_stack_entry *entry;
+  ini_section *section;
+  ini_file *ini;
+  ini_key *key;
 
-        /* Restore the buffer */
-        buf[name_pos + name_len] = tmp;
-        buf[value_pos + value_len] = tmp2;
-        state = INIPS_NONE;
-      }
-      if (c == '[' || c == ']' || c == '=') {
-        bad_syntax = 1;
-      } else {
-        value_len++;
-      }
-      break;
+  for (layer = 0; layer < stack->num_files; layer++) {
+    if (stack->files[layer] != NULL) {
+      num_keys += stack->files[layer]->num_key_index;
+    }
+  }
+  if (num_keys != stack->num_keys && stack->num_cache > 0) {
+    /* A file has new keys, which may override those found before */
+    memset(stack->cache, 0, sizeof(ini_stack_entry) * stack->cap_cache);
+    stack->num_cache = 0;
+  }
+  stack->num_keys = num_keys;
 
-    case INIPS_AFTER_KEY_VALUE:
-      if (IS_NEWLINE_OR_EOF(c)) {
-        state = INIPS_NONE;
-      } else {
-        bad_syntax = 1;
-      }
+  for (i = hash & (stack->cap_cache - 1); stack->cap_cache > 0;
+       i = (i + 1) & (stack->cap_cache - 1)) {
+    entry = &stack->cache[i];
+    if (entry->layer == 0) {
       break;
+    }
+    if (entry->hash != hash) {
+      continue;
+    }
+    ini = stack->files[entry->layer - 1];
+    section = &ini->ptr_sections[entry->section];
+    key = &section->ptr_keys[entry->key];
+    if (section->name_len == section_len && key->name_len == key_len &&
+        memcmp(ini->ptr_pool + section->name_off, section_name,
+               section_len) == 0 &&
+        memcmp(ini->ptr_pool + key->name_off, key_name, key_len) == 0) {
+      if (file != NULL) {
+        *file = ini;
+      }
+      return key;
+    }
+  }
 
-    default:
-      break;
+  /* From the highest priority down */
+  for (layer = stack->num_files; layer-- > 0;) {
+    ini = stack->files[layer];
+    if (ini == NULL) {
+      continue;
+    }
+    s = __ini_find_section_len(ini, section_name, section_len, section_hash);
+    if (s == 0) {
+      continue;
+    }
+    key = __ini_find_key(ini, s - 1, key_name, key_len, hash);
+    if (key != NULL) {
+      __ini_stack_remember(stack, hash, layer, s - 1,
+                           (size_t)(key - ini->ptr_sections[s - 1].ptr_keys));
+      if (file != NULL) {
+        *file = ini;
+      }
+      return key;
     }
   }
+  if (file != NULL) {
+    *file = NULL;
+  }
+  return NULL;
+}
 
-  free(buf);
+int ini_stack_get_int(ini_stack *stack, const char *section_name,
+                      const char *key_name, int default_val) {
+  ini_file *ini;
+  ini_key *key = ini_stack_lookup(stack, section_name, key_name, &ini);
+  return ini_get_int_h(ini, key, default_val);
+}
 
-#undef IS_SPACE
-#undef IS_NEWLINE
-#undef IS_EOF
-#undef IS_NEWLINE_OR_EOF
-#undef IS_COMMENT
+float ini_stack_get_float(ini_stack *stack, const char *section_name,
+                          const char *key_name, float default_val) {
+  ini_file *ini;
+  ini_key *key = ini_stack_lookup(stack, section_name, key_name, &ini);
+  return ini_get_float_h(ini, key, default_val);
+}
 
-  if (bad_syntax || alloc_error) {
-    ini_free(ptr);
-    return NULL;
-  } else {
-    return ptr;
-  }
+char *ini_stack_get_string(ini_stack *stack, const char *section_name,
+                           const char *key_name, char *default_val) {
+  ini_file *ini;
+  ini_key *key = ini_stack_lookup(stack, section_name, key_name, &ini);
+  return ini_get_string_h(ini, key, default_val);
 }
-size_t ini_num_sections(ini_file *ini) { return ini->num_sections; }
 
-int ini_has_section(ini_file *ini, const char *section_name) {
-  size_t s;
-  for (s = 0; s < ini->num_sections; s++) {
-    if (strcmp(ini->ptr_sections[s].name, section_name) == 0) {
-      return 1;
+ini_int64 ini_stack_get_int64(ini_stack *stack, const char *section_name,
+                              const char *key_name, ini_int64 default_val) {
+  ini_file *ini;
+  ini_key *key = ini_stack_lookup(stack, section_name, key_name, &ini);
+  return ini_get_int64_h(ini, key, default_val);
+}
+
+double ini_stack_get_double(ini_stack *stack, const char *section_name,
+                            const char *key_name, double default_val) {
+  ini_file *ini;
+  ini_key *key = ini_stack_lookup(stack, section_name, key_name, &ini);
+  return ini_get_double_h(ini, key, default_val);
+}
+
+void ini_stack_free(ini_stack *stack) {
+  INILOAD_FREE(stack->cache);
+  INILOAD_FREE(stack->files);
+  INILOAD_FREE(stack);
+}
+
+/* Loads the paths that are not taken yet, the last file of all is followed
+ * by a byte to the pipe */
+void __ini_async_run(ini_async *async) {
+  long i;
+  ini_file *ini;
+  while ((i = __ini_atomic_add(&async->next, 1) - 1) <
+         (long)async->num_paths) {
+    ini = ini_load_ex(async->paths[i], &async->options);
+    async->results[i] = ini;
+    if (async->on_load != NULL) {
+      async->on_load(async->user, (size_t)i, ini);
+    }
+    if (__ini_atomic_add(&async->done, 1) == (long)async->num_paths) {
+#ifdef INILOAD_POSIX
+      while (write(async->pipe_fds[1], "", 1) < 0 && errno == EINTR) {
+      }
+#endif
     }
   }
+}
+
+#ifdef INILOAD_ENABLE_THREADS
+#ifdef INILOAD_WIN32
+DWORD WINAPI __ini_async_worker(LPVOID arg) {
+  __ini_async_run((ini_async *)arg);
   return 0;
 }
+#else
+void *__ini_async_worker(void *arg) {
+  __ini_async_run((ini_async *)arg);
+  return NULL;
+}
+#endif
+#endif
 
-size_t ini_num_keys(ini_file *ini, const char *section_name) {
-  size_t s;
-  for (s = 0; s < ini->num_sections; s++) {
-    if (strcmp(ini->ptr_sections[s].name, section_name) == 0) {
-      return ini->ptr_sections[s].num_keys;
+ini_async *ini_load_async(const char *const *paths, size_t num_paths,
+                          const ini_options *options, ini_load_cb on_load,
+                          void *user) {
+  ini_async *async;
+  size_t i, size = 0;
+  char *str;
+#ifdef INILOAD_ENABLE_THREADS
+  size_t num_threads;
+#endif
+
+  if (options != NULL && options->arena_buf != NULL) {
+    return NULL;
+  }
+  async = (ini_async *)INILOAD_MALLOC(sizeof(ini_async));
+  if (async == NULL) {
+    return NULL;
+  }
+  memset(async, 0, sizeof(ini_async));
+  for (i = 0; i < num_paths; i++) {
+    size += strlen(paths[i]) + 1;
+  }
+  /* The pointers are followed by the strings */
+  async->paths =
+      (char **)INILOAD_MALLOC(sizeof(char *) * num_paths + size + 1);
+  async->results =
+      (ini_file **)INILOAD_MALLOC(sizeof(ini_file *) * num_paths + 1);
+  if (async->paths == NULL || async->results == NULL) {
+    INILOAD_FREE(async->paths);
+    INILOAD_FREE(async->results);
+    INILOAD_FREE(async);
+    return NULL;
+  }
+  str = (char *)(async->paths + num_paths);
+  for (i = 0; i < num_paths; i++) {
+    async->paths[i] = str;
+    strcpy(str, paths[i]);
+    str += strlen(str) + 1;
+    async->results[i] = NULL;
+  }
+  async->num_paths = num_paths;
+  if (options != NULL) {
+    async->options = *options;
+  }
+  async->on_load = on_load;
+  async->user = user;
+#ifdef INILOAD_POSIX
+  if (pipe(async->pipe_fds) != 0) {
+    INILOAD_FREE(async->paths);
+    INILOAD_FREE(async->results);
+    INILOAD_FREE(async);
+    return NULL;
+  }
+#endif
+#ifdef INILOAD_POSIX
+  if (num_paths == 0) {
+    /* Nothing to wait for */
+    while (write(async->pipe_fds[1], "", 1) < 0 && errno == EINTR) {
     }
   }
-  return 0;
+#endif
+
+#ifdef INILOAD_ENABLE_THREADS
+  num_threads = (async->options.num_threads == 0 ? INILOAD_THREADS
+                                                 : async->options.num_threads);
+  if (num_threads > num_paths) {
+    num_threads = num_paths;
+  }
+#ifdef INILOAD_WIN32
+  async->threads = (HANDLE *)INILOAD_MALLOC(sizeof(HANDLE) * num_threads + 1);
+#else
+  async->threads =
+      (pthread_t *)INILOAD_MALLOC(sizeof(pthread_t) * num_threads + 1);
+#endif
+  for (i = 0; async->threads != NULL && i < num_threads; i++) {
+#ifdef INILOAD_WIN32
+    async->threads[i] =
+        CreateThread(NULL, 0, __ini_async_worker, async, 0, NULL);
+    if (async->threads[i] == NULL) {
+#else
+    if (pthread_create(&async->threads[i], NULL, __ini_async_worker, async) !=
+        0) {
+#endif
+      break;
+    }
+  }
+  async->num_threads = i;
+#endif
+  if (async->num_threads == 0) {
+    /* Without workers the files are loaded right away */
+    __ini_async_run(async);
+  }
+  return async;
 }
 
-int ini_has_key(ini_file *ini, const char *section_name, const char *key_name) {
-  return (__ini_get_key_ptr(ini, section_name, key_name) == NULL ? 0 : 1);
+int ini_async_fd(ini_async *async) {
+#ifdef INILOAD_POSIX
+  return async->pipe_fds[0];
+#else
+  (void)async;
+  return -1;
+#endif
 }
 
-int ini_get_int(ini_file *ini, const char *section_name, const char *key_name,
-                int default_val) {
-  ini_key *ptr = __ini_get_key_ptr(ini, section_name, key_name);
-  if (ptr == NULL || ptr->type != INI_KEY_INT) {
-    return default_val;
-  } else {
-    return ptr->value.int_val;
-  }
+int ini_async_done(ini_async *async) {
+  return __ini_atomic_load(&async->done) == (long)async->num_paths;
 }
 
-float ini_get_float(ini_file *ini, const char *section_name,
-                    const char *key_name, float default_val) {
-  ini_key *ptr = __ini_get_key_ptr(ini, section_name, key_name);
-  if (ptr == NULL || ptr->type != INI_KEY_FLOAT) {
-    return default_val;
-  } else {
-    return ptr->value.float_val;
+void ini_async_wait(ini_async *async) {
+#ifdef INILOAD_ENABLE_THREADS
+  size_t i;
+  if (!async->joined) {
+    for (i = 0; i < async->num_threads; i++) {
+#ifdef INILOAD_WIN32
+      WaitForSingleObject(async->threads[i], INFINITE);
+      CloseHandle(async->threads[i]);
+#else
+      pthread_join(async->threads[i], NULL);
+#endif
+    }
   }
+#endif
+  async->joined = 1;
 }
 
-char *ini_get_string(ini_file *ini, const char *section_name,
-                     const char *key_name, char *default_val) {
-  ini_key *ptr = __ini_get_key_ptr(ini, section_name, key_name);
-  if (ptr == NULL || ptr->type != INI_KEY_STRING) {
-    return default_val;
-  } else {
-    return ptr->value.string_val;
+ini_file *ini_async_result(ini_async *async, size_t index) {
+  if (index >= async->num_paths || !ini_async_done(async)) {
+    return NULL;
   }
+  return async->results[index];
 }
 
-void ini_free(ini_file *ini) {
-  size_t s, k;
-  for (s = 0; s < ini->num_sections; s++) {
-    for (k = 0; k < ini->ptr_sections[s].num_keys; k++) {
-      if (ini->ptr_sections[s].ptr_keys[k].type == INI_KEY_STRING) {
-        free(ini->ptr_sections[s].ptr_keys[k].value.string_val);
-      }
-    }
-    free(ini->ptr_sections[s].ptr_keys);
+void ini_async_free(ini_async *async) {
+  ini_async_wait(async);
+#ifdef INILOAD_ENABLE_THREADS
+  INILOAD_FREE(async->threads);
+#endif
+#ifdef INILOAD_POSIX
+  close(async->pipe_fds[0]);
+  close(async->pipe_fds[1]);
+#endif
+  INILOAD_FREE(async->paths);
+  INILOAD_FREE(async->results);
+  INILOAD_FREE(async);
+}
+
+ini_parser *ini_parser_create(ini_section_cb on_section, ini_key_cb on_key,
+                              void *user) {
+  ini_parser *parser = (ini_parser *)INILOAD_MALLOC(sizeof(ini_parser));
+  if (parser == NULL) {
+    return NULL;
   }
-  free(ini->ptr_sections);
-  free(ini);
+  memset(parser, 0, sizeof(ini_parser));
+  parser->on_section = on_section;
+  parser->on_key = on_key;
+  parser->user = user;
+  parser->state = INIPS_NONE;
+  return parser;
+}
+
+int ini_parser_feed(ini_parser *parser, const char *chunk, size_t len) {
+  return !parser->failed && __ini_parser_run(parser, chunk, len);
+}
+
+int ini_parser_finish(ini_parser *parser) {
+  /* The end of the text reads as a NUL character */
+  int ok = !parser->failed && __ini_parser_run(parser, "", 1);
+  parser->state = INIPS_NONE;
+  parser->failed = 0;
+  parser->has_section = 0;
+  parser->name_len = 0;
+  parser->value_len = 0;
+  return ok;
+}
+
+void ini_parser_free(ini_parser *parser) {
+  INILOAD_FREE(parser->value);
+  INILOAD_FREE(parser);
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,448 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stddef.h>
+#include <stdlib.h>
+
+/* Allocations made by iniload, counted by size so that ini_free() of a
+ * reallocated block is accounted correctly */
+static size_t num_allocs = 0;
+static size_t heap_bytes = 0;
+static size_t peak_heap_bytes = 0;
+
+typedef union bench_header {
+  size_t size;
+  double align_double;
+  void *align_ptr;
+} bench_header;
+
+void *bench_malloc(size_t size) {
+  bench_header *block = (bench_header *)malloc(sizeof(bench_header) + size);
+  if (block == NULL) {
+    return NULL;
+  }
+  block->size = size;
+  num_allocs++;
+  heap_bytes += size;
+  if (heap_bytes > peak_heap_bytes) {
+    peak_heap_bytes = heap_bytes;
+  }
+  return block + 1;
+}
+
+void bench_free(void *ptr) {
+  bench_header *block;
+  if (ptr == NULL) {
+    return;
+  }
+  block = (bench_header *)ptr - 1;
+  heap_bytes -= block->size;
+  free(block);
+}
+
+void *bench_realloc(void *ptr, size_t size) {
+  bench_header *block;
+  size_t old_size;
+  if (ptr == NULL) {
+    return bench_malloc(size);
+  }
+  block = (bench_header *)ptr - 1;
+  old_size = block->size;
+  block = (bench_header *)realloc(block, sizeof(bench_header) + size);
+  if (block == NULL) {
+    return NULL;
+  }
+  block->size = size;
+  num_allocs++;
+  heap_bytes = heap_bytes - old_size + size;
+  if (heap_bytes > peak_heap_bytes) {
+    peak_heap_bytes = heap_bytes;
+  }
+  return block + 1;
+}
+
+#define INILOAD_IMPLEMENTATION
+#define INILOAD_ENABLE_THREADS
+#define INILOAD_MALLOC(size) bench_malloc(size)
+#define INILOAD_REALLOC(ptr, size) bench_realloc(ptr, size)
+#define INILOAD_FREE(ptr) bench_free(ptr)
+#include "iniload.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/* Generated text, grown until it reaches the requested size */
+typedef struct corpus {
+  char *buf;
+  size_t len;
+  size_t cap;
+} corpus;
+
+typedef void (*generator)(corpus *text, size_t size);
+
+/* Throughput of the fastest load and save of one corpus, saved and compared
+ * by --save and --check; the fastest run varies less between runs than the
+ * average */
+typedef struct bench_result {
+  char name[32];
+  unsigned long size;
+  double load_mbs;
+  double save_mbs;
+} bench_result;
+
+double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Deterministic pseudo-random numbers so that runs can be compared */
+static unsigned long rand_state = 12345;
+
+unsigned long next_rand(void) {
+  rand_state = (rand_state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+  return rand_state;
+}
+
+void append(corpus *text, const char *str, size_t len) {
+  while (text->len + len + 1 > text->cap) {
+    text->cap = (text->cap == 0 ? 4096 : text->cap * 2);
+    text->buf = (char *)realloc(text->buf, text->cap);
+    if (text->buf == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+  }
+  memcpy(text->buf + text->len, str, len);
+  text->len += len;
+}
+
+void appendf_line(corpus *text, const char *fmt, unsigned long a,
+                  unsigned long b) {
+  char line[128];
+  append(text, line, (size_t)sprintf(line, fmt, a, b));
+}
+
+void gen_many_sections(corpus *text, size_t size) {
+  unsigned long s, k;
+  for (s = 0; text->len < size; s++) {
+    appendf_line(text, "[section%lu]\n", s, 0);
+    for (k = 0; k < 4; k++) {
+      appendf_line(text, "key%lu = value%lu\n", k, next_rand());
+    }
+  }
+}
+
+void gen_huge_section(corpus *text, size_t size) {
+  unsigned long k;
+  append(text, "[huge]\n", 7);
+  for (k = 0; text->len < size; k++) {
+    appendf_line(text, "key%lu = value%lu\n", k, next_rand());
+  }
+}
+
+void gen_long_values(corpus *text, size_t size) {
+  char value[4096];
+  unsigned long k;
+  size_t i;
+  for (i = 0; i < sizeof(value); i++) {
+    value[i] = (char)('a' + i % 26);
+  }
+  append(text, "[long]\n", 7);
+  for (k = 0; text->len < size; k++) {
+    appendf_line(text, "key%lu = %lu", k, next_rand());
+    append(text, value, 1024 + next_rand() % (sizeof(value) - 1024));
+    append(text, "\n", 1);
+  }
+}
+
+void gen_comments(corpus *text, size_t size) {
+  unsigned long k;
+  append(text, "[commented]\n", 12);
+  for (k = 0; text->len < size; k++) {
+    if (next_rand() % 5 == 0) {
+      appendf_line(text, "key%lu = %lu\n", k, next_rand());
+    } else {
+      appendf_line(text,
+                   "; comment %lu explaining the setting below in some "
+                   "detail, %lu\n",
+                   k, next_rand());
+    }
+  }
+}
+
+void gen_numeric(corpus *text, size_t size) {
+  unsigned long k, r;
+  char line[128];
+  append(text, "[numbers]\n", 10);
+  for (k = 0; text->len < size; k++) {
+    r = next_rand();
+    if (r % 2 == 0) {
+      append(text, line,
+             (size_t)sprintf(line, "int%lu = %ld\n", k,
+                             (long)(r % 2000000) - 1000000L));
+    } else {
+      append(text, line,
+             (size_t)sprintf(line, "float%lu = %.6f\n", k,
+                             (double)(r % 2000000) / 1000.0 - 1000.0));
+    }
+  }
+}
+
+/* Loads a corpus repeatedly for about a second and prints the averages */
+void bench_load(const char *name, generator gen, size_t size,
+                const ini_options *options, bench_result *result) {
+  corpus text = {NULL, 0, 0};
+  ini_file *ini;
+  double start, load_time = 0.0, save_time = 0.0, free_time = 0.0;
+  double best_load = 0.0, best_save = 0.0, t;
+  size_t runs = 0, allocs = 0, peak = 0, saved_len = 0;
+  char *saved = NULL;
+
+  gen(&text, size);
+  while (runs == 0 ||
+         (load_time + save_time + free_time < 1.0 && runs < 1000)) {
+    num_allocs = 0;
+    peak_heap_bytes = heap_bytes;
+    start = now();
+    ini = ini_load_mem_ex(text.buf, text.len, options);
+    t = now() - start;
+    load_time += t;
+    best_load = (runs == 0 || t < best_load ? t : best_load);
+    if (ini == NULL) {
+      fprintf(stderr, "%s: failed to load\n", name);
+      exit(1);
+    }
+    allocs = num_allocs;
+    peak = peak_heap_bytes;
+    if (saved == NULL) {
+      saved_len = ini_save_mem(ini, NULL, 0);
+      saved = (char *)malloc(saved_len + 1);
+    }
+    start = now();
+    if (ini_save_mem(ini, saved, saved_len + 1) != saved_len) {
+      fprintf(stderr, "%s: failed to save\n", name);
+      exit(1);
+    }
+    t = now() - start;
+    save_time += t;
+    best_save = (runs == 0 || t < best_save ? t : best_save);
+    start = now();
+    ini_free(ini);
+    free_time += now() - start;
+    runs++;
+  }
+  sprintf(result->name, "%.31s", name);
+  result->size = (unsigned long)size;
+  result->load_mbs = text.len / 1e6 / best_load;
+  result->save_mbs = saved_len / 1e6 / best_save;
+  printf("%-14s %10.2f %10.1f %10.1f %10lu %10.1f %10.3f\n", name,
+         text.len / 1e6, text.len / 1e6 / (load_time / runs),
+         saved_len / 1e6 / (save_time / runs), (unsigned long)allocs,
+         peak / 1e6, free_time / runs * 1e3);
+  free(saved);
+  free(text.buf);
+}
+
+/* Times ini_get_* on a section of num_keys keys in random order */
+void bench_lookups(size_t num_keys) {
+  corpus text = {NULL, 0, 0};
+  ini_file *ini;
+  char (*names)[24];
+  char (*missing)[24];
+  size_t *order;
+  size_t i, found = 0;
+  size_t num_lookups = 1000000;
+  double start, int_time, string_time, miss_time, handle_time, frozen_time;
+  ini_key_handle *keys;
+
+  append(&text, "[s]\n", 4);
+  names = (char(*)[24])malloc(sizeof(*names) * num_keys);
+  missing = (char(*)[24])malloc(sizeof(*missing) * num_keys);
+  order = (size_t *)malloc(sizeof(size_t) * num_lookups);
+  keys = (ini_key_handle *)malloc(sizeof(ini_key_handle) * num_lookups);
+  for (i = 0; i < num_keys; i++) {
+    sprintf(names[i], "key%lu", (unsigned long)i);
+    sprintf(missing[i], "key%lu", (unsigned long)(num_keys + i));
+    appendf_line(&text, "key%lu = %lu\n", i, i);
+  }
+  for (i = 0; i < num_lookups; i++) {
+    order[i] = next_rand() % num_keys;
+  }
+  ini = ini_load_mem(text.buf, text.len);
+
+  start = now();
+  for (i = 0; i < num_lookups; i++) {
+    found += ini_get_int(ini, "s", names[order[i]], -1) >= 0;
+  }
+  int_time = now() - start;
+  start = now();
+  for (i = 0; i < num_lookups; i++) {
+    found += ini_get_string(ini, "s", names[order[i]], NULL) == NULL;
+  }
+  string_time = now() - start;
+  /* Keys that are not in the file, read for their default value */
+  start = now();
+  for (i = 0; i < num_lookups; i++) {
+    found += ini_get_int(ini, "s", missing[order[i]], -1) < 0;
+  }
+  miss_time = now() - start;
+  for (i = 0; i < num_lookups; i++) {
+    keys[i] = ini_lookup(ini, "s", names[order[i]]);
+  }
+  start = now();
+  for (i = 0; i < num_lookups; i++) {
+    found += ini_get_int_h(ini, keys[i], -1) >= 0;
+  }
+  handle_time = now() - start;
+  ini_freeze(ini);
+  start = now();
+  for (i = 0; i < num_lookups; i++) {
+    found += ini_get_int(ini, "s", names[order[i]], -1) >= 0;
+  }
+  frozen_time = now() - start;
+
+  printf("%10lu %12.1f %12.1f %12.1f %12.1f %12.1f\n",
+         (unsigned long)num_keys, int_time / num_lookups * 1e9,
+         string_time / num_lookups * 1e9, miss_time / num_lookups * 1e9,
+         handle_time / num_lookups * 1e9, frozen_time / num_lookups * 1e9);
+  if (found != num_lookups * 5) {
+    fprintf(stderr, "lookups failed\n");
+    exit(1);
+  }
+  ini_free(ini);
+  free(keys);
+  free(order);
+  free(missing);
+  free(names);
+  free(text.buf);
+}
+
+/* Writes the results as the baseline of later checks */
+int bench_save(const char *path, const bench_result *results,
+               size_t num_results) {
+  FILE *f = fopen(path, "w");
+  size_t i;
+  if (f == NULL) {
+    return 0;
+  }
+  for (i = 0; i < num_results; i++) {
+    fprintf(f, "%s %lu %.1f %.1f\n", results[i].name, results[i].size,
+            results[i].load_mbs, results[i].save_mbs);
+  }
+  return fclose(f) == 0;
+}
+
+/* Compares the results with a saved baseline and prints every throughput
+ * that is lower by more than threshold percent. Corpora that were not run
+ * are skipped. Returns the number of regressions, or -1 if the baseline
+ * can not be read. */
+int bench_check(const char *path, const bench_result *results,
+                size_t num_results, double threshold) {
+  FILE *f = fopen(path, "r");
+  bench_result base;
+  double limit = 1.0 - threshold / 100.0;
+  int regressions = 0;
+  size_t i;
+  if (f == NULL) {
+    return -1;
+  }
+  while (fscanf(f, "%31s %lu %lf %lf", base.name, &base.size,
+                &base.load_mbs, &base.save_mbs) == 4) {
+    for (i = 0; i < num_results; i++) {
+      if (strcmp(results[i].name, base.name) != 0 ||
+          results[i].size != base.size) {
+        continue;
+      }
+      if (results[i].load_mbs < base.load_mbs * limit) {
+        printf("REGRESSION %s %lu: load %.1f MB/s, baseline %.1f MB/s\n",
+               base.name, base.size, results[i].load_mbs, base.load_mbs);
+        regressions++;
+      }
+      if (results[i].save_mbs < base.save_mbs * limit) {
+        printf("REGRESSION %s %lu: save %.1f MB/s, baseline %.1f MB/s\n",
+               base.name, base.size, results[i].save_mbs, base.save_mbs);
+        regressions++;
+      }
+    }
+  }
+  fclose(f);
+  return regressions;
+}
+
+/* Usage: bench [max corpus size, e.g. 64M or 1G] [ini_load_flags]
+ *              [--save baseline | --check baseline] [--threshold percent]
+ *
+ * --save writes the load and save throughput of every corpus, --check
+ * compares them with a saved baseline and fails if any is lower by more than
+ * the threshold (20% by default). */
+int main(int argc, char *argv[]) {
+  const char *names[] = {"many_sections", "huge_section", "long_values",
+                         "comments", "numeric"};
+  generator gens[] = {gen_many_sections, gen_huge_section, gen_long_values,
+                      gen_comments, gen_numeric};
+  ini_options options = {0};
+  struct rusage usage;
+  bench_result results[64];
+  size_t num_results = 0;
+  size_t max_size = (size_t)64 << 20;
+  size_t size, num_keys;
+  const char *save_path = NULL, *check_path = NULL;
+  double threshold = 20.0;
+  char *unit;
+  int a, g, positional = 0, regressions = 0;
+
+  for (a = 1; a < argc; a++) {
+    if (strcmp(argv[a], "--save") == 0 && a + 1 < argc) {
+      save_path = argv[++a];
+    } else if (strcmp(argv[a], "--check") == 0 && a + 1 < argc) {
+      check_path = argv[++a];
+    } else if (strcmp(argv[a], "--threshold") == 0 && a + 1 < argc) {
+      threshold = strtod(argv[++a], NULL);
+    } else if (positional++ == 0) {
+      max_size = (size_t)strtoul(argv[a], &unit, 10);
+      if (*unit == 'K' || *unit == 'k') {
+        max_size <<= 10;
+      } else if (*unit == 'M' || *unit == 'm') {
+        max_size <<= 20;
+      } else if (*unit == 'G' || *unit == 'g') {
+        max_size <<= 30;
+      }
+    } else {
+      options.flags = (unsigned int)strtoul(argv[a], NULL, 0);
+    }
+  }
+
+  printf("%-14s %10s %10s %10s %10s %10s %10s\n", "corpus", "MB", "MB/s",
+         "save MB/s", "allocs", "peak MB", "free ms");
+  for (size = 16 << 10; size <= max_size; size *= 16) {
+    for (g = 0; g < 5 && num_results < 64; g++) {
+      bench_load(names[g], gens[g], size, &options, &results[num_results++]);
+    }
+  }
+
+  printf("\n%10s %12s %12s %12s %12s %12s\n", "keys", "get_int ns",
+         "get_string ns", "missing ns", "handle ns", "frozen ns");
+  for (num_keys = 100; num_keys <= 1000000; num_keys *= 10) {
+    bench_lookups(num_keys);
+  }
+
+  getrusage(RUSAGE_SELF, &usage);
+  printf("\npeak RSS %.1f MB\n", usage.ru_maxrss / 1024.0);
+
+  if (save_path != NULL && !bench_save(save_path, results, num_results)) {
+    fprintf(stderr, "%s: can not be written\n", save_path);
+    return 1;
+  }
+  if (check_path != NULL) {
+    regressions = bench_check(check_path, results, num_results, threshold);
+    if (regressions < 0) {
+      fprintf(stderr, "%s: can not be read\n", check_path);
+      return 1;
+    }
+    printf("\n%d regressions of more than %.0f%% against %s\n", regressions,
+           threshold, check_path);
+  }
+  return regressions > 0;
+}
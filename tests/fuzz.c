@@ -0,0 +1,437 @@
+/* Differential fuzzing of the load modes. Every input is loaded by the
+ * reference ini_load_mem() and by each other way of parsing a text, which must
+ * give the same sections, keys and values or fail alike.
+ *
+ * Built with libFuzzer (make fuzz, needs clang) the inputs come from the
+ * fuzzer. Otherwise (make difftest) the program checks the files given as
+ * arguments and random mutations of them:
+ *
+ *   difftest [-n mutations] [-s seed] files...
+ *
+ * The first input that differs is written to fuzz-failure.ini. */
+#define INILOAD_IMPLEMENTATION
+#define INILOAD_ENABLE_THREADS
+#define INILOAD_NAME_MAXLEN 30
+#define INILOAD_PARALLEL_MIN_CHUNK 64
+#include "iniload.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef ini_file *(*fuzz_loader)(const char *data, size_t len);
+
+/* Difference found by the last fuzz_compare() */
+static char fuzz_diff[256];
+
+/* Compares two loaded files, including the names found through their
+ * indexes. Returns 1 if they are equal, otherwise describes the first
+ * difference in fuzz_diff. */
+int fuzz_compare(ini_file *a, ini_file *b) {
+  ini_section *sa, *sb;
+  ini_key *ka, *kb;
+  const char *section, *key;
+  ini_key_type type;
+  double fa, fb;
+  size_t s, k;
+
+  if (a->num_sections != b->num_sections) {
+    sprintf(fuzz_diff, "%lu sections instead of %lu",
+            (unsigned long)b->num_sections, (unsigned long)a->num_sections);
+    return 0;
+  }
+  for (s = 0; s < a->num_sections; s++) {
+    sa = &a->ptr_sections[s];
+    sb = &b->ptr_sections[s];
+    section = a->ptr_pool + sa->name_off;
+    if (strcmp(section, b->ptr_pool + sb->name_off) != 0 ||
+        sa->num_keys != sb->num_keys) {
+      sprintf(fuzz_diff, "section %lu differs", (unsigned long)s);
+      return 0;
+    }
+    if (__ini_find_section(a, section) != sa ||
+        __ini_find_section(b, section) != sb) {
+      sprintf(fuzz_diff, "section %lu is not indexed", (unsigned long)s);
+      return 0;
+    }
+    for (k = 0; k < sa->num_keys; k++) {
+      ka = &sa->ptr_keys[k];
+      kb = &sb->ptr_keys[k];
+      key = a->ptr_pool + ka->name_off;
+      sprintf(fuzz_diff, "key %lu of section %lu differs", (unsigned long)k,
+              (unsigned long)s);
+      if (strcmp(key, b->ptr_pool + kb->name_off) != 0) {
+        return 0;
+      }
+      /* Resolves lazy keys */
+      type = ini_get_type_h(a, ka);
+      if (ini_get_type_h(b, kb) != type) {
+        return 0;
+      }
+      if ((type == INI_KEY_INT || type == INI_KEY_INT64) &&
+          ka->value.int_val != kb->value.int_val) {
+        return 0;
+      }
+      fa = ka->value.float_val;
+      fb = kb->value.float_val;
+      if ((type == INI_KEY_FLOAT || type == INI_KEY_DOUBLE) && fa != fb &&
+          (fa == fa || fb == fb)) {
+        /* Any two NaNs are equal, the sign of a NaN is not written */
+        return 0;
+      }
+      if (type == INI_KEY_STRING &&
+          strcmp(a->ptr_pool + ka->value.string_off,
+                 b->ptr_pool + kb->value.string_off) != 0) {
+        return 0;
+      }
+      if (ini_lookup(a, section, key) != ka ||
+          ini_lookup(b, section, key) != kb) {
+        sprintf(fuzz_diff, "key %lu of section %lu is not indexed",
+                (unsigned long)k, (unsigned long)s);
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+ini_file *fuzz_load_flags(const char *data, size_t len, unsigned int flags) {
+  ini_options options = {0};
+  options.flags = flags;
+  return ini_load_mem_ex(data, len, &options);
+}
+
+ini_file *fuzz_zero_copy(const char *data, size_t len) {
+  return fuzz_load_flags(data, len, INI_LOAD_ZERO_COPY);
+}
+
+ini_file *fuzz_arena(const char *data, size_t len) {
+  return fuzz_load_flags(data, len, INI_LOAD_ARENA | INI_LOAD_ZERO_COPY);
+}
+
+ini_file *fuzz_parallel(const char *data, size_t len) {
+  return fuzz_load_flags(data, len, INI_LOAD_PARALLEL);
+}
+
+ini_file *fuzz_lazy(const char *data, size_t len) {
+  return fuzz_load_flags(data, len, INI_LOAD_LAZY);
+}
+
+/* Hints that are too small, the arrays grow while parsing */
+ini_file *fuzz_hinted(const char *data, size_t len) {
+  ini_options options = {0};
+  options.num_sections_hint = 1;
+  options.num_keys_hint = 1;
+  return ini_load_mem_ex(data, len, &options);
+}
+
+/* Reloads the text over a version made of its first half, which shares the
+ * sections before the cut */
+ini_file *fuzz_reload(const char *data, size_t len) {
+  ini_file *old = ini_reload_mem(NULL, data, len / 2);
+  ini_file *ini = ini_reload_mem(old, data, len);
+  if (ini == NULL && old != NULL) {
+    ini_free(old);
+  }
+  return ini;
+}
+
+/* Builds a file from the callbacks of the streaming parser */
+int fuzz_stream_section(void *user, const char *section) {
+  ini_file *ini = (ini_file *)user;
+  return __ini_add_section(ini, section, strlen(section)) != NULL;
+}
+
+int fuzz_stream_key(void *user, const char *section, const char *key,
+                    const char *value, int quoted) {
+  ini_file *ini = (ini_file *)user;
+  ini_section *ptr = __ini_find_section(ini, section);
+  return ptr != NULL && __ini_add_key(ini, ptr, key, strlen(key), value,
+                                      strlen(value), quoted);
+}
+
+/* Feeds the text in chunks of 1 to 8 bytes that depend on the text */
+ini_file *fuzz_stream(const char *data, size_t len) {
+  ini_file *ini = ini_create();
+  ini_parser *parser;
+  size_t i, chunk;
+  int ok = 1;
+  if (ini == NULL) {
+    return NULL;
+  }
+  parser = ini_parser_create(fuzz_stream_section, fuzz_stream_key, ini);
+  if (parser == NULL) {
+    ini_free(ini);
+    return NULL;
+  }
+  for (i = 0; i < len && ok; i += chunk) {
+    chunk = 1 + (unsigned char)data[i] % 8;
+    ok = ini_parser_feed(parser, data + i, len - i < chunk ? len - i : chunk);
+  }
+  ok = ini_parser_finish(parser) && ok;
+  ini_parser_free(parser);
+  if (!ok) {
+    ini_free(ini);
+    return NULL;
+  }
+  return ini;
+}
+
+/* Saves the reference and loads the saved text */
+ini_file *fuzz_saved(const char *data, size_t len) {
+  ini_file *ini = ini_load_mem(data, len);
+  ini_file *saved;
+  char *text;
+  size_t text_len;
+  if (ini == NULL) {
+    return NULL;
+  }
+  text_len = ini_save_mem(ini, NULL, 0);
+  text = (char *)malloc(text_len + 1);
+  if (text == NULL) {
+    ini_free(ini);
+    return NULL;
+  }
+  ini_save_mem(ini, text, text_len + 1);
+  saved = ini_load_mem(text, text_len);
+  free(text);
+  ini_free(ini);
+  return saved;
+}
+
+static const char *fuzz_names[] = {"zero_copy", "arena",  "parallel",
+                                   "lazy",      "hinted", "reload",
+                                   "stream",    "saved"};
+static const fuzz_loader fuzz_loaders[] = {
+    fuzz_zero_copy, fuzz_arena,  fuzz_parallel, fuzz_lazy,
+    fuzz_hinted,    fuzz_reload, fuzz_stream,   fuzz_saved};
+
+#define FUZZ_NUM_MODES (sizeof(fuzz_loaders) / sizeof(fuzz_loaders[0]))
+
+/* Loads an input in every mode, returns the name of the first mode that
+ * differs from the reference or NULL */
+const char *fuzz_check(const char *data, size_t len) {
+  ini_file *ref = ini_load_mem(data, len);
+  ini_file *ini;
+  size_t m;
+  for (m = 0; m < FUZZ_NUM_MODES; m++) {
+    ini = fuzz_loaders[m](data, len);
+    if ((ini == NULL) != (ref == NULL)) {
+      sprintf(fuzz_diff, ref == NULL ? "loaded a bad text" : "failed");
+    }
+    if ((ini == NULL) != (ref == NULL) ||
+        (ini != NULL && !fuzz_compare(ref, ini))) {
+      if (ini != NULL) {
+        ini_free(ini);
+      }
+      if (ref != NULL) {
+        ini_free(ref);
+      }
+      return fuzz_names[m];
+    }
+    if (ini != NULL) {
+      ini_free(ini);
+    }
+  }
+  if (ref != NULL) {
+    ini_free(ref);
+  }
+  return NULL;
+}
+
+#ifdef INILOAD_LIBFUZZER
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size) {
+  const char *mode = fuzz_check((const char *)data, size);
+  if (mode != NULL) {
+    fprintf(stderr, "%s: %s\n", mode, fuzz_diff);
+    abort();
+  }
+  return 0;
+}
+#else
+/* An input that can grow while it is mutated */
+typedef struct fuzz_input {
+  char *buf;
+  size_t len;
+  size_t cap;
+} fuzz_input;
+
+static unsigned long rand_state = 1;
+
+unsigned long next_rand(void) {
+  rand_state = (rand_state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+  return rand_state;
+}
+
+void fuzz_reserve(fuzz_input *in, size_t len) {
+  while (in->cap < len) {
+    in->cap = (in->cap < 256 ? 256 : in->cap * 2);
+    in->buf = (char *)realloc(in->buf, in->cap);
+    if (in->buf == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(2);
+    }
+  }
+}
+
+/* Inserts bytes at a position */
+void fuzz_insert(fuzz_input *in, size_t pos, const char *str, size_t len) {
+  fuzz_reserve(in, in->len + len);
+  memmove(in->buf + pos + len, in->buf + pos, in->len - pos);
+  memcpy(in->buf + pos, str, len);
+  in->len += len;
+}
+
+/* Changes an input with a few edits, favouring the characters and tokens
+ * that move the parser between states */
+void fuzz_mutate(fuzz_input *in, const fuzz_input *corpus, size_t num_corpus) {
+  static const char chars[] = "[]=;#\"\r\n \t\v0123456789.-+xeEabk";
+  static const char *tokens[] = {"[s]\n", "k = v\n", "\"", "\n", "\r\n",
+                                 "0x1p3", "1e400", "-nan", "inf", "1e-320",
+                                 "2147483648", "0777", ";c\n", "[]\n",
+                                 "k=\"\"\n", "9223372036854775808"};
+  const fuzz_input *other;
+  size_t edits = 1 + next_rand() % 4;
+  size_t pos, len;
+  char c;
+  while (edits-- > 0) {
+    pos = (in->len > 0 ? next_rand() % (in->len + 1) : 0);
+    switch (next_rand() % 6) {
+    case 0:
+      /* Replace a byte, sometimes by any value */
+      if (pos < in->len) {
+        in->buf[pos] = (next_rand() % 4 == 0 ? (char)next_rand()
+                                             : chars[next_rand() %
+                                                     (sizeof(chars) - 1)]);
+      }
+      break;
+    case 1:
+      c = chars[next_rand() % (sizeof(chars) - 1)];
+      fuzz_insert(in, pos, &c, 1);
+      break;
+    case 2:
+      len = next_rand() % (sizeof(tokens) / sizeof(tokens[0]));
+      fuzz_insert(in, pos, tokens[len], strlen(tokens[len]));
+      break;
+    case 3:
+      /* Delete a range */
+      len = (next_rand() % 16) % (in->len - pos + 1);
+      memmove(in->buf + pos, in->buf + pos + len, in->len - pos - len);
+      in->len -= len;
+      break;
+    case 4:
+      /* Splice in a piece of another input */
+      other = &corpus[next_rand() % num_corpus];
+      if (other->len > 0) {
+        len = next_rand() % other->len;
+        fuzz_insert(in, pos, other->buf + len,
+                    1 + next_rand() % (other->len - len));
+      }
+      break;
+    default:
+      /* Cut the end */
+      in->len = pos;
+      break;
+    }
+  }
+}
+
+int fuzz_read(const char *path, fuzz_input *in) {
+  FILE *f = fopen(path, "rb");
+  size_t n;
+  if (f == NULL) {
+    return 0;
+  }
+  in->buf = NULL;
+  in->len = 0;
+  in->cap = 0;
+  do {
+    fuzz_reserve(in, in->len + 4096);
+    n = fread(in->buf + in->len, 1, in->cap - in->len, f);
+    in->len += n;
+  } while (n > 0);
+  fclose(f);
+  return 1;
+}
+
+/* Writes the input that failed so that it can be replayed */
+int fuzz_fail(const fuzz_input *in, const char *name, const char *mode) {
+  FILE *f = fopen("fuzz-failure.ini", "wb");
+  if (f != NULL) {
+    fwrite(in->buf, 1, in->len, f);
+    fclose(f);
+  }
+  printf("%s: %s: %s, written to fuzz-failure.ini\n", name, mode, fuzz_diff);
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  fuzz_input *corpus;
+  fuzz_input in = {NULL, 0, 0};
+  unsigned long num_mutations = 10000, i;
+  size_t num_files = 0, num_corpus;
+  const char *mode = NULL;
+  int a;
+
+  corpus = (fuzz_input *)malloc(sizeof(fuzz_input) * (size_t)(argc + 1));
+  if (corpus == NULL) {
+    return 2;
+  }
+  for (a = 1; a < argc && mode == NULL; a++) {
+    if (strcmp(argv[a], "-n") == 0 && a + 1 < argc) {
+      num_mutations = strtoul(argv[++a], NULL, 10);
+    } else if (strcmp(argv[a], "-s") == 0 && a + 1 < argc) {
+      rand_state = strtoul(argv[++a], NULL, 10);
+    } else if (!fuzz_read(argv[a], &corpus[num_files])) {
+      fprintf(stderr, "%s: can not be read\n", argv[a]);
+      return 2;
+    } else {
+      mode = fuzz_check(corpus[num_files].buf, corpus[num_files].len);
+      if (mode != NULL) {
+        fuzz_fail(&corpus[num_files], argv[a], mode);
+      }
+      num_files++;
+    }
+  }
+  num_corpus = num_files;
+  if (num_corpus == 0) {
+    /* Mutations of an empty text */
+    corpus[0].buf = NULL;
+    corpus[0].len = 0;
+    corpus[0].cap = 0;
+    num_corpus = 1;
+  }
+  if (mode != NULL) {
+    num_mutations = 0;
+  }
+
+  for (i = 0; i < num_mutations && mode == NULL; i++) {
+    /* Mutates the previous input again most of the time, to get further
+     * from the files */
+    if (i % 8 == 0 || in.len > 65536) {
+      const fuzz_input *base = &corpus[next_rand() % num_corpus];
+      fuzz_reserve(&in, base->len);
+      if (base->len > 0) {
+        memcpy(in.buf, base->buf, base->len);
+      }
+      in.len = base->len;
+    }
+    fuzz_mutate(&in, corpus, num_corpus);
+    mode = fuzz_check(in.buf, in.len);
+  }
+  if (mode != NULL && num_mutations > 0) {
+    fuzz_fail(&in, "mutation", mode);
+  } else if (mode == NULL) {
+    printf("%lu files and %lu mutations load alike in %lu modes\n",
+           (unsigned long)num_files, num_mutations,
+           (unsigned long)FUZZ_NUM_MODES);
+  }
+
+  free(in.buf);
+  while (num_corpus > 0) {
+    free(corpus[--num_corpus].buf);
+  }
+  free(corpus);
+  return mode != NULL;
+}
+#endif
@@ -1,10 +1,72 @@
 #define INILOAD_IMPLEMENTATION
 #define INILOAD_NAME_MAXLEN 30
+#define INILOAD_ENABLE_THREADS
+#define INILOAD_PARALLEL_MIN_CHUNK 256
+#define INILOAD_ENABLE_STATS
 #include "iniload.h"
 
 #include <assert.h>
 #include <string.h>
 
+#ifdef INILOAD_POSIX
+#include <fcntl.h>
+#include <sys/wait.h>
+#endif
+
+/* Position of the key found by a lookup, as section * 1000 + key */
+size_t ini_lookup_pos(ini_file *ini, const char *section, const char *key) {
+  ini_key *found;
+  size_t s;
+  found = __ini_get_key_ptr(ini, section, key);
+  for (s = 0; s < ini->num_sections; s++) {
+    if (found >= ini->ptr_sections[s].ptr_keys &&
+        found < ini->ptr_sections[s].ptr_keys + ini->ptr_sections[s].num_keys) {
+      return s * 1000 + (size_t)(found - ini->ptr_sections[s].ptr_keys);
+    }
+  }
+  return (size_t)-1;
+}
+
+/* Compares the sections, keys and lookups of two loaded files */
+int ini_files_equal(ini_file *a, ini_file *b) {
+  size_t s, k;
+  ini_section *sa, *sb;
+  ini_key *ka, *kb;
+  const char *section, *key;
+  if (a->num_sections != b->num_sections) {
+    return 0;
+  }
+  for (s = 0; s < a->num_sections; s++) {
+    sa = &a->ptr_sections[s];
+    sb = &b->ptr_sections[s];
+    section = a->ptr_pool + sa->name_off;
+    if (strcmp(section, b->ptr_pool + sb->name_off) != 0 ||
+        sa->num_keys != sb->num_keys ||
+        __ini_find_section(a, section) - a->ptr_sections !=
+            __ini_find_section(b, section) - b->ptr_sections) {
+      return 0;
+    }
+    for (k = 0; k < sa->num_keys; k++) {
+      ka = &sa->ptr_keys[k];
+      kb = &sb->ptr_keys[k];
+      key = a->ptr_pool + ka->name_off;
+      if (strcmp(key, b->ptr_pool + kb->name_off) != 0 ||
+          ka->type != kb->type ||
+          ((ka->type == INI_KEY_INT || ka->type == INI_KEY_INT64) &&
+           ka->value.int_val != kb->value.int_val) ||
+          ((ka->type == INI_KEY_FLOAT || ka->type == INI_KEY_DOUBLE) &&
+           ka->value.float_val != kb->value.float_val) ||
+          (ka->type == INI_KEY_STRING &&
+           strcmp(a->ptr_pool + ka->value.string_off,
+                  b->ptr_pool + kb->value.string_off) != 0) ||
+          ini_lookup_pos(a, section, key) != ini_lookup_pos(b, section, key)) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
 void test_empty_file() {
   ini_file *ini;
   printf("test_empty_file()...");
@@ -39,7 +101,8 @@ void test_many_empty_sections() {
   ini = ini_load("inis/test_many_empty_sections.ini");
 
   assert(ini != NULL);
-  assert(ini_num_sections(ini) == 9);
+  /* The repeated [empty] headers make a single section */
+  assert(ini_num_sections(ini) == 6);
 
   ini_free(ini);
 
@@ -92,6 +155,66 @@ void test_large_section() {
   assert(ini_num_sections(ini) == 1);
   assert(ini_has_section(ini, "large"));
   assert(ini_num_keys(ini, "large") == 200);
+  assert(strcmp(ini_get_string(ini, "large", "key199", "wrong"), "value") == 0);
+
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+void test_duplicates() {
+  ini_file *ini;
+  ini_options options = {0};
+  static const char data[] = "k = 1\n[a]\nx = 1\ny = \"first\"\n"
+                             "[b]\nx = 2\n[a]\nz = 3\ny = 4\n[]\nk = 5\n"
+                             "[a]\nx = \"last\"\n";
+  int i;
+  printf("test_duplicates()...");
+
+  for (i = 0; i < 3; i++) {
+    options.flags = (i == 0 ? 0 : i == 1 ? INI_LOAD_ARENA : INI_LOAD_LAZY);
+    ini = ini_load_mem_ex(data, sizeof(data) - 1, &options);
+    assert(ini != NULL);
+    /* Repeated sections are merged and the last value of a key wins */
+    assert(ini_num_sections(ini) == 3);
+    assert(ini_num_keys(ini, "") == 1);
+    assert(ini_num_keys(ini, "a") == 3);
+    assert(ini_num_keys(ini, "b") == 1);
+    assert(ini_get_int(ini, "", "k", -1) == 5);
+    assert(strcmp(ini_get_string(ini, "a", "x", "wrong"), "last") == 0);
+    assert(ini_get_int(ini, "a", "y", -1) == 4);
+    assert(ini_get_int(ini, "a", "z", -1) == 3);
+    assert(ini_get_int(ini, "b", "x", -1) == 2);
+    /* Keys keep the place where they first appeared */
+    assert(strcmp(ini->ptr_pool + ini->ptr_sections[1].ptr_keys[2].name_off,
+                  "z") == 0);
+    ini_free(ini);
+  }
+
+  printf("SUCCESS\n");
+}
+
+void test_many_keys() {
+  ini_file *ini;
+  char key_name[32];
+  int s, k;
+  printf("test_many_keys()...");
+  ini = ini_load("inis/test_many_keys.ini");
+
+  assert(ini != NULL);
+  assert(ini_num_sections(ini) == 4);
+  for (s = 0; s < 4; s++) {
+    sprintf(key_name, "section%d", s);
+    assert(ini_num_keys(ini, key_name) == 250);
+  }
+  for (k = 0; k < 250; k++) {
+    sprintf(key_name, "key%d", k);
+    assert(ini_get_int(ini, "section0", key_name, -1) == k);
+    assert(ini_get_int(ini, "section3", key_name, -1) == 3000 + k);
+  }
+  assert(!ini_has_key(ini, "section0", "key250"));
+  assert(!ini_has_key(ini, "section4", "key0"));
+  assert(!ini_has_section(ini, "section4"));
 
   ini_free(ini);
 
@@ -114,6 +237,1683 @@ void test_spaces() {
   printf("SUCCESS\n");
 }
 
+void test_arena() {
+  ini_file *ini;
+  ini_options options = {0};
+  static char arena[1 << 16];
+  printf("test_arena()...");
+
+  options.flags = INI_LOAD_ARENA;
+  ini = ini_load_ex("inis/test_many_keys.ini", &options);
+  assert(ini != NULL);
+  assert(ini_num_sections(ini) == 4);
+  assert(ini_get_int(ini, "section2", "key123", -1) == 2123);
+  ini_free(ini);
+
+  options.arena_buf = arena;
+  options.arena_size = sizeof(arena);
+  ini = ini_load_ex("inis/test_multiple_sections.ini", &options);
+  assert(ini != NULL);
+  assert((char *)ini >= arena && (char *)ini < arena + sizeof(arena));
+  assert(strcmp(ini_get_string(ini, "s4", "key", "wrong"), "value") == 0);
+  assert(ini_get_int(ini, "s4", "key2", -1) == 42);
+  ini_free(ini);
+
+  /* The caller-supplied arena is too small for this file */
+  options.arena_size = 1024;
+  ini = ini_load_ex("inis/test_many_keys.ini", &options);
+  assert(ini == NULL);
+
+  printf("SUCCESS\n");
+}
+
+void test_zero_copy() {
+  ini_file *ini;
+  ini_options options = {0};
+  printf("test_zero_copy()...");
+
+  options.flags = INI_LOAD_ZERO_COPY;
+  ini = ini_load_ex("inis/test_keys_without_section.ini", &options);
+  assert(ini != NULL);
+  assert(ini_has_section(ini, ""));
+  assert(ini_get_int(ini, "", "key1", 1337) == 1);
+  assert(strcmp(ini_get_string(ini, "", "key2", "wrong"), "no section") == 0);
+  assert(ini_get_int(ini, "", "key", 1337) == -1);
+  ini_free(ini);
+
+  options.flags = INI_LOAD_ZERO_COPY | INI_LOAD_ARENA;
+  ini = ini_load_ex("inis/test_multiple_sections.ini", &options);
+  assert(ini != NULL);
+  assert(ini_num_sections(ini) == 4);
+  assert(ini_has_section(ini, "s3"));
+  assert(strcmp(ini_get_string(ini, "s1", "test", "wrong"), "test") == 0);
+  assert(strcmp(ini_get_string(ini, "s4", "key", "wrong"), "value") == 0);
+  assert(ini_get_int(ini, "s4", "key2", -1) == 42);
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+void test_load_mem() {
+  ini_file *ini;
+  ini_options options = {0};
+  /* Only the first 26 bytes are INI data, nothing NUL-terminates them */
+  const char data[] = {'[', 's', ']', '\n', 'a', '=', '1', '\n', 'b', ' ',
+                       '=', ' ', '"', 'x', ' ', 'y', '"', '\n', 'c', '=',
+                       'p', 'a', 't', 'h', '\r', '\n', '[', '['};
+  printf("test_load_mem()...");
+
+  ini = ini_load_mem(data, 26);
+  assert(ini != NULL);
+  assert(ini_num_sections(ini) == 1);
+  assert(ini_get_int(ini, "s", "a", -1) == 1);
+  assert(strcmp(ini_get_string(ini, "s", "b", "wrong"), "x y") == 0);
+  assert(strcmp(ini_get_string(ini, "s", "c", "wrong"), "path") == 0);
+  ini_free(ini);
+
+  /* The data that follows is bad syntax */
+  ini = ini_load_mem(data, sizeof(data));
+  assert(ini == NULL);
+
+  options.flags = INI_LOAD_ZERO_COPY | INI_LOAD_ARENA;
+  ini = ini_load_mem_ex(data, 26, &options);
+  assert(ini != NULL);
+  assert(strcmp(ini_get_string(ini, "s", "c", "wrong"), "path") == 0);
+  assert(data[24] == '\r');
+  ini_free(ini);
+
+  ini = ini_load_mem("", 0);
+  assert(ini != NULL);
+  assert(ini_num_sections(ini) == 0);
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+void test_long_values() {
+  ini_file *ini;
+  char data[512];
+  char value[128];
+  size_t n, len;
+  printf("test_long_values()...");
+
+  /* Values and comments of every length around the vector widths, with the
+   * character that ends them at every position of a vector */
+  for (n = 0; n < 100; n++) {
+    memset(value, 'v', n);
+    value[n] = '\0';
+    len = sprintf(data, "; comment %s = [x]\n[s]\nk = x%s\r\nq = \"%s\"\n", value,
+                  value, value);
+    ini = ini_load_mem(data, len);
+    assert(ini != NULL);
+    assert(ini_num_keys(ini, "s") == 2);
+    assert(strlen(ini_get_string(ini, "s", "k", "")) == n + 1);
+    assert(strcmp(ini_get_string(ini, "s", "q", "wrong"), value) == 0);
+    ini_free(ini);
+
+    /* An unquoted value must not contain a bracket */
+    len = sprintf(data, "k = %s]\n", value);
+    ini = ini_load_mem(data, len);
+    assert(ini == NULL);
+  }
+
+  printf("SUCCESS\n");
+}
+
+void test_parallel() {
+  ini_file *ini, *ref;
+  ini_options options = {0};
+  static char data[1 << 16];
+  size_t len = 0;
+  int s, k;
+  printf("test_parallel()...");
+
+  len += sprintf(data + len, "top = 1\n");
+  for (s = 0; s < 100; s++) {
+    /* Sections and keys repeat, the last values must win */
+    len += sprintf(data + len, "[s%d]\n", s % 30);
+    for (k = 0; k < 10; k++) {
+      len += sprintf(data + len, "k%d = %d\nq%d = \"v%d\"\n", k % 6,
+                     s * 100 + k, k, s);
+    }
+    len += sprintf(data + len, "; [not a section]\n  [s%d]\n", s);
+  }
+
+  ref = ini_load_mem(data, len);
+  assert(ref != NULL);
+  options.flags = INI_LOAD_PARALLEL;
+  for (options.num_threads = 1; options.num_threads < 12;
+       options.num_threads++) {
+    ini = ini_load_mem_ex(data, len, &options);
+    assert(ini != NULL);
+    assert(ini_files_equal(ini, ref));
+    assert(ini_get_int(ini, "s3", "k2", -1) == 9308);
+    assert(ini_get_int(ini, "", "top", -1) == 1);
+    ini_free(ini);
+  }
+  ini_free(ref);
+
+  /* Bad syntax in the last chunk fails the whole load */
+  len += sprintf(data + len, "[bad\n");
+  options.num_threads = 4;
+  ini = ini_load_mem_ex(data, len, &options);
+  assert(ini == NULL);
+
+  options.flags = INI_LOAD_PARALLEL | INI_LOAD_ZERO_COPY;
+  ini = ini_load_ex("inis/test_many_keys.ini", &options);
+  ref = ini_load("inis/test_many_keys.ini");
+  assert(ini != NULL && ref != NULL);
+  assert(ini_files_equal(ini, ref));
+  ini_free(ini);
+  ini_free(ref);
+
+  printf("SUCCESS\n");
+}
+
+void test_lazy() {
+  ini_file *ini;
+  ini_options options = {0};
+  static const char data[] = "i = 0x10\nf = 2.5\ns = text\nq = \"7\"\n"
+                             "[numbers]\nn = 5\nm = 6\n";
+  printf("test_lazy()...");
+
+  options.flags = INI_LOAD_LAZY;
+  ini = ini_load_mem_ex(data, sizeof(data) - 1, &options);
+  assert(ini != NULL);
+  assert(ini->ptr_sections[0].ptr_keys[0].type == INI_KEY_LAZY);
+  assert(ini->ptr_sections[0].ptr_keys[3].type == INI_KEY_STRING);
+  /* A getter of the wrong type still caches the conversion */
+  assert(strcmp(ini_get_string(ini, "", "i", "wrong"), "wrong") == 0);
+  assert(ini->ptr_sections[0].ptr_keys[0].type == INI_KEY_INT);
+  assert(ini_get_int(ini, "", "i", -1) == 16);
+  assert(ini_get_float(ini, "", "f", -1.0f) == 2.5f);
+  assert(strcmp(ini_get_string(ini, "", "s", "wrong"), "text") == 0);
+  assert(strcmp(ini_get_string(ini, "", "q", "wrong"), "7") == 0);
+  assert(ini_get_int(ini, "numbers", "n", -1) == 5);
+  /* Keys that were not read stay unconverted */
+  assert(ini->ptr_sections[1].ptr_keys[1].type == INI_KEY_LAZY);
+  ini_free(ini);
+
+  options.flags = INI_LOAD_LAZY | INI_LOAD_ZERO_COPY | INI_LOAD_ARENA;
+  ini = ini_load_ex("inis/test_multiple_sections.ini", &options);
+  assert(ini != NULL);
+  assert(strcmp(ini_get_string(ini, "s1", "test", "wrong"), "test") == 0);
+  assert(strcmp(ini_get_string(ini, "s4", "key", "wrong"), "value") == 0);
+  assert(ini_get_int(ini, "s4", "key2", -1) == 42);
+  assert(ini_get_int(ini, "s4", "key2", -1) == 42);
+  ini_free(ini);
+
+  options.flags = INI_LOAD_LAZY | INI_LOAD_PARALLEL;
+  options.num_threads = 3;
+  ini = ini_load_ex("inis/test_many_keys.ini", &options);
+  assert(ini != NULL);
+  assert(ini_get_int(ini, "section2", "key17", -1) == 2017);
+  assert(ini_get_int(ini, "section3", "key249", -1) == 3249);
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+void test_handles() {
+  ini_file *ini;
+  ini_key_handle key, missing;
+  ini_options options = {0};
+  int i;
+  printf("test_handles()...");
+
+  ini = ini_load("inis/test_multiple_sections.ini");
+  assert(ini != NULL);
+  key = ini_lookup(ini, "s4", "key2");
+  assert(key != NULL);
+  for (i = 0; i < 3; i++) {
+    assert(ini_get_int_h(ini, key, -1) == 42);
+  }
+  assert(ini_get_float_h(ini, key, -1.0f) == -1.0f);
+  assert(strcmp(ini_get_string_h(ini, key, "wrong"), "wrong") == 0);
+  key = ini_lookup(ini, "s1", "test");
+  assert(strcmp(ini_get_string_h(ini, key, "wrong"), "test") == 0);
+  missing = ini_lookup(ini, "s2", "test");
+  assert(missing == NULL);
+  assert(ini_get_int_h(ini, missing, 1337) == 1337);
+  assert(ini_get_float_h(ini, missing, 1.5f) == 1.5f);
+  assert(strcmp(ini_get_string_h(ini, missing, "none"), "none") == 0);
+  assert(ini_lookup(ini, "none", "test") == NULL);
+  ini_free(ini);
+
+  /* Handles of lazy keys convert them on the first read */
+  options.flags = INI_LOAD_LAZY;
+  ini = ini_load_ex("inis/test_many_keys.ini", &options);
+  assert(ini != NULL);
+  key = ini_lookup(ini, "section1", "key42");
+  assert(key->type == INI_KEY_LAZY);
+  assert(ini_get_int_h(ini, key, -1) == 1042);
+  assert(key->type == INI_KEY_INT);
+  assert(ini_get_int(ini, "section1", "key42", -1) == 1042);
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+/* Checks that the key filter lets every key of the index through, returns
+ * how many of 10000 missing keys also get through */
+size_t filter_passes(ini_file *ini) {
+  unsigned long section_hash = __ini_hash(INILOAD_HASH_SEED, "section1");
+  char name[32];
+  size_t i, passes = 0;
+  for (i = 0; i < ini->cap_key_index; i++) {
+    if (ini->key_index[i].section != 0) {
+      assert(__ini_filter_test(ini, ini->key_index[i].hash));
+    }
+  }
+  for (i = 0; i < 10000; i++) {
+    sprintf(name, "absent%lu", (unsigned long)i);
+    passes += __ini_filter_test(ini, __ini_hash_key(section_hash, name));
+  }
+  return passes;
+}
+
+void test_filter() {
+  ini_options options = {0};
+  ini_file *ini;
+  char name[32];
+  int i, mode, ok;
+  printf("test_filter()...");
+
+  for (mode = 0; mode < 3; mode++) {
+    options.flags = (mode == 0   ? 0
+                     : mode == 1 ? INI_LOAD_ARENA
+                                 : INI_LOAD_PARALLEL);
+    ini = ini_load_ex("inis/test_many_keys.ini", &options);
+    assert(ini != NULL && ini->key_filter != NULL);
+    assert(ini->cap_key_filter == __ini_filter_size(ini->cap_key_index));
+    /* A few percent of the misses probe the index */
+    assert(filter_passes(ini) < 300);
+    for (i = 0; i < 250; i++) {
+      sprintf(name, "key%d", i);
+      assert(ini_get_int(ini, "section1", name, -1) == 1000 + i);
+      sprintf(name, "absent%d", i);
+      assert(ini_get_int(ini, "section1", name, -1) == -1);
+      assert(ini_lookup(ini, "section1", name) == NULL);
+    }
+
+    /* The filter follows the index when it is rebuilt or grows */
+    ok = ini_freeze(ini);
+    assert(ok);
+    assert(ini->cap_key_filter == __ini_filter_size(ini->cap_key_index));
+    assert(filter_passes(ini) < 300);
+    assert(ini_get_int(ini, "section3", "key249", -1) == 3249);
+    for (i = 0; i < 2000; i++) {
+      sprintf(name, "new%d", i);
+      ok = ini_set_int(ini, "section1", name, i);
+      assert(ok);
+    }
+    assert(filter_passes(ini) < 300);
+    assert(ini_get_int(ini, "section1", "new1999", -1) == 1999);
+    assert(ini_get_int(ini, "section1", "key249", -1) == 1249);
+    ini_free(ini);
+  }
+
+  printf("SUCCESS\n");
+}
+
+void test_iterate() {
+  ini_file *ini;
+  ini_key_handle key;
+  ini_options options = {0};
+  size_t s, k, num_keys = 0;
+  printf("test_iterate()...");
+
+  ini = ini_load("inis/test_multiple_sections.ini");
+  assert(strcmp(ini_section_at(ini, 0), "s1") == 0);
+  assert(strcmp(ini_section_at(ini, 3), "s4") == 0);
+  assert(ini_section_at(ini, 4) == NULL);
+  assert(ini_num_keys_at(ini, 0) == 1 && ini_num_keys_at(ini, 1) == 0);
+  assert(ini_num_keys_at(ini, 3) == 2 && ini_num_keys_at(ini, 4) == 0);
+  key = ini_key_at(ini, 3, 1);
+  assert(strcmp(ini_get_name_h(ini, key), "key2") == 0);
+  assert(ini_get_int_h(ini, key, 0) == 42);
+  assert(strcmp(ini_get_string_h(ini, ini_key_at(ini, 3, 0), ""), "value") ==
+         0);
+  assert(ini_key_at(ini, 3, 2) == NULL && ini_key_at(ini, 1, 0) == NULL);
+  assert(ini_key_at(ini, 4, 0) == NULL);
+  ini_free(ini);
+
+  /* One pass meets every key where the lookup by name finds it */
+  options.flags = INI_LOAD_LAZY;
+  ini = ini_load_ex("inis/test_many_keys.ini", &options);
+  for (s = 0; s < ini_num_sections(ini); s++) {
+    for (k = 0; k < ini_num_keys_at(ini, s); k++) {
+      key = ini_key_at(ini, s, k);
+      assert(key == ini_lookup(ini, ini_section_at(ini, s),
+                               ini_get_name_h(ini, key)));
+      assert(ini_get_type_h(ini, key) == INI_KEY_INT);
+      num_keys++;
+    }
+  }
+  assert(num_keys == 1000);
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+void test_batch() {
+  struct {
+    int key2;
+    char *test;
+    char *key;
+    int missing;
+    float wrong_type;
+    int lazy[3];
+  } config = {0, NULL, NULL, 7, 2.5f, {-1, -1, -1}};
+  ini_batch_key keys[] = {
+      {"s4", "key2", INI_KEY_INT, NULL},
+      {NULL, "key", INI_KEY_STRING, NULL},
+      {"s1", "test", INI_KEY_STRING, NULL},
+      {NULL, "missing", INI_KEY_INT, NULL},
+      {"s1", "test", INI_KEY_FLOAT, NULL},
+      {"none", "key2", INI_KEY_INT, NULL}};
+  ini_batch_key lazy_keys[] = {{"section0", "key0", INI_KEY_INT, NULL},
+                               {NULL, "key5", INI_KEY_INT, NULL},
+                               {"section1", "key0", INI_KEY_INT, NULL}};
+  char section[] = "s1";
+  ini_options options = {0};
+  ini_file *ini;
+  size_t found;
+  printf("test_batch()...");
+
+  keys[0].out = &config.key2;
+  keys[1].out = &config.key;
+  keys[2].out = &config.test;
+  keys[3].out = &config.missing;
+  keys[4].out = &config.wrong_type;
+  keys[5].out = &config.missing;
+  ini = ini_load("inis/test_multiple_sections.ini");
+  found = ini_get_batch(ini, keys, 6);
+  assert(found == 3);
+  assert(config.key2 == 42 && strcmp(config.key, "value") == 0);
+  assert(strcmp(config.test, "test") == 0);
+  assert(config.missing == 7 && config.wrong_type == 2.5f);
+
+  /* Equal names in different strings are the same section */
+  keys[4].section_name = section;
+  keys[4].type = INI_KEY_STRING;
+  keys[4].out = &config.key;
+  found = ini_get_batch(ini, keys + 2, 3);
+  assert(found == 2);
+  assert(strcmp(config.key, "test") == 0);
+  found = ini_get_batch(ini, keys, 0);
+  assert(found == 0);
+  ini_free(ini);
+
+  options.flags = INI_LOAD_LAZY;
+  ini = ini_load_ex("inis/test_many_keys.ini", &options);
+  lazy_keys[0].out = &config.lazy[0];
+  lazy_keys[1].out = &config.lazy[1];
+  lazy_keys[2].out = &config.lazy[2];
+  found = ini_get_batch(ini, lazy_keys, 3);
+  assert(found == 3);
+  assert(config.lazy[0] == ini_get_int(ini, "section0", "key0", -2));
+  assert(config.lazy[1] == ini_get_int(ini, "section0", "key5", -2));
+  assert(config.lazy[2] == ini_get_int(ini, "section1", "key0", -2));
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+void test_stats() {
+  ini_stats stats;
+  ini_key_stats hot[3];
+  ini_batch_key keys[2];
+  ini_key_handle key;
+  ini_file *ini;
+  size_t found;
+  int i, value, ok;
+  printf("test_stats()...");
+
+  ini = ini_load("inis/test_many_keys.ini");
+  assert(ini != NULL);
+  ok = ini_get_stats(ini, &stats);
+  assert(ok == 1);
+  assert(stats.bytes_read > 0 && stats.read_seconds >= 0.0);
+  assert(stats.parse_seconds >= 0.0);
+  assert(stats.num_sections == ini_num_sections(ini));
+  assert(stats.num_keys == 1000);
+  /* Every section and the index grew while the keys were added */
+  assert(stats.num_allocs > stats.num_grows && stats.num_grows > 0);
+  assert(stats.alloc_bytes > stats.bytes_read);
+  assert(stats.lookup_calls == 0 && stats.get_int_calls == 0);
+  found = ini_hot_keys(ini, hot, 3);
+  assert(found == 0);
+
+  for (i = 0; i < 5; i++) {
+    assert(ini_get_int(ini, "section1", "key42", -1) == 1042);
+  }
+  assert(ini_get_int(ini, "section0", "key3", -1) == 3);
+  assert(ini_get_int(ini, "section0", "missing", -1) == -1);
+  assert(ini_get_float(ini, "section0", "key3", -1.0f) == -1.0f);
+  assert(ini_get_float(ini, "none", "key3", -1.0f) == -1.0f);
+  assert(strcmp(ini_get_string(ini, "section0", "key3", "x"), "x") == 0);
+  key = ini_lookup(ini, "section0", "key4");
+  assert(key != NULL && ini_lookup(ini, "section0", "none") == NULL);
+  for (i = 0; i < 4; i++) {
+    assert(ini_get_int_h(ini, key, -1) == 4);
+  }
+  keys[0].section_name = "section0";
+  keys[0].key_name = "key4";
+  keys[0].type = INI_KEY_INT;
+  keys[0].out = &value;
+  keys[1].section_name = "none";
+  keys[1].key_name = "key4";
+  keys[1].type = INI_KEY_INT;
+  keys[1].out = &value;
+  found = ini_get_batch(ini, keys, 2);
+  assert(found == 1);
+
+  ini_get_stats(ini, &stats);
+  assert(stats.get_int_calls == 7 && stats.get_int_misses == 1);
+  assert(stats.get_float_calls == 2 && stats.get_float_misses == 1);
+  assert(stats.get_string_calls == 1 && stats.get_string_misses == 0);
+  assert(stats.lookup_calls == 4 && stats.lookup_misses == 2);
+
+  /* Reads through handles are not lookups */
+  found = ini_hot_keys(ini, hot, 3);
+  assert(found == 3);
+  assert(strcmp(hot[0].section_name, "section1") == 0);
+  assert(strcmp(hot[0].key_name, "key42") == 0 && hot[0].lookups == 5);
+  assert(strcmp(hot[1].key_name, "key3") == 0 && hot[1].lookups == 3);
+  assert(strcmp(hot[2].key_name, "key4") == 0 && hot[2].lookups == 2);
+  found = ini_hot_keys(ini, hot, 1);
+  assert(found == 1 && hot[0].lookups == 5);
+  found = ini_hot_keys(ini, hot, 0);
+  assert(found == 0);
+  ini_free(ini);
+
+  ini = ini_load_mem("[a]\nb = 1\n", 10);
+  ini_get_stats(ini, &stats);
+  assert(stats.bytes_read == 10 && stats.num_sections == 1);
+  assert(stats.num_keys == 1 && stats.num_allocs > 0);
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+void test_freeze() {
+  ini_file *ini, *ref;
+  ini_options options = {0};
+  char text[16384];
+  size_t len = 0;
+  int i, j, ok;
+  printf("test_freeze()...");
+
+  ref = ini_load("inis/test_many_keys.ini");
+  ini = ini_load("inis/test_many_keys.ini");
+  ok = ini_freeze(ini);
+  assert(ok && ini->frozen != NULL);
+  assert(ini_files_equal(ini, ref));
+  assert(ini->ptr_sections[1].ptr_keys ==
+         ini->ptr_sections[0].ptr_keys + ini->ptr_sections[0].num_keys);
+  assert(ini->cap_sections == ini->num_sections);
+  assert(ini->cap_pool == ini->size_pool + 1);
+  assert(ini_get_int(ini, "section1", "key42", -1) == 1042);
+  assert(ini_get_int(ini, "section1", "key1000", -1) == -1);
+  ok = ini_freeze(ini);
+  assert(ok && ini_files_equal(ini, ref));
+  ini = ini_reload(ini, "inis/test_many_keys.ini");
+  assert(ini != NULL && ini->frozen == NULL && ini_files_equal(ini, ref));
+  ini_free(ini);
+  ini_free(ref);
+
+  /* Sections of every size, the index shrinks to fit after a reload */
+  for (i = 0; i < 40; i++) {
+    len += (size_t)sprintf(text + len, "[s%d]\n", i);
+    for (j = 0; j < i; j++) {
+      len += (size_t)sprintf(text + len, "k%d = %d\n", j, i * 100 + j);
+    }
+  }
+  ref = ini_load_mem(text, len);
+  ini = ini_reload_mem(NULL, text, len);
+  ini = ini_reload_mem(ini, text, (size_t)(strstr(text, "[s30]") - text));
+  assert(ini != NULL);
+  ok = ini_freeze(ini);
+  assert(ok);
+  assert(ini->cap_key_index < ref->cap_key_index);
+  ini_free(ini);
+  ini = ini_load_mem(text, len);
+  ok = ini_freeze(ini);
+  assert(ok && ini_files_equal(ini, ref));
+  for (i = 0; i < 40; i++) {
+    sprintf(text, "s%d", i);
+    for (j = 0; j <= i; j++) {
+      sprintf(text + 16, "k%d", j);
+      assert(ini_get_int(ini, text, text + 16, -1) ==
+             (j < i ? i * 100 + j : -1));
+    }
+  }
+  ini_free(ini);
+  ini_free(ref);
+
+  options.flags = INI_LOAD_ARENA | INI_LOAD_LAZY;
+  ini = ini_load_ex("inis/test_multiple_sections.ini", &options);
+  ok = ini_freeze(ini);
+  assert(ok);
+  assert(ini_get_int(ini, "s4", "key2", -1) == 42);
+  assert(strcmp(ini_get_string(ini, "s1", "test", ""), "test") == 0);
+  ini_free(ini);
+
+  ini = ini_load("inis/test_empty.ini");
+  ok = ini_freeze(ini);
+  assert(ok && ini_get_int(ini, "", "a", -1) == -1);
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+void test_presize() {
+  const char *text = "x = 1\ny = 2\n[a]\n; k = 0\nk = 1\n  l=\"2\"\n\n"
+                     "[empty]\n[a]\nm = 3\n# n = 4\nn = 5\n";
+  ini_options options = {0};
+  ini_file *ini;
+  size_t *counts;
+  char data[4096];
+  size_t len = 4;
+  int i;
+  printf("test_presize()...");
+
+  assert(__ini_count_keys(text, strlen(text), &counts) == 4);
+  assert(counts[0] == 2 && counts[1] == 2 && counts[2] == 0 && counts[3] == 2);
+  INILOAD_FREE(counts);
+  assert(__ini_count_keys("", 0, &counts) == 1 && counts[0] == 0);
+  INILOAD_FREE(counts);
+
+  /* Every section gets room for exactly its keys */
+  ini = ini_load_mem(text, strlen(text));
+  assert(ini != NULL && ini_num_sections(ini) == 3);
+  assert(ini->ptr_sections[0].cap_keys == 2);
+  assert(ini->ptr_sections[1].cap_keys == 4);
+  assert(ini->ptr_sections[2].cap_keys == 1);
+  assert(ini->cap_key_index == __ini_index_size(6));
+  assert(ini_get_int(ini, "a", "n", 0) == 5);
+  ini_free(ini);
+
+  memcpy(data, "[s]\n", 4);
+  for (i = 0; i < 100; i++) {
+    len += (size_t)sprintf(data + len, "k%d = %d\n", i, i);
+  }
+  ini = ini_load_mem(data, len);
+  assert(ini->ptr_sections[0].cap_keys == 100);
+  ini_free(ini);
+
+  /* Hints replace the counting */
+  options.num_sections_hint = 1;
+  options.num_keys_hint = 100;
+  ini = ini_load_mem_ex(data, len, &options);
+  assert(ini->ptr_sections[0].cap_keys == 101);
+  assert(ini->cap_key_index == __ini_index_size(100));
+  ini_free(ini);
+  options.num_keys_hint = 10;
+  ini = ini_load_mem_ex(data, len, &options);
+  assert(ini_get_int(ini, "s", "k99", 0) == 99);
+  assert(ini->ptr_sections[0].cap_keys >= 100);
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+void test_save() {
+  static const float floats[] = {0.1f, 1.0f, -2.5f, 1.0f / 3.0f, 100000.0f,
+                                 16777216.0f, 3.4e38f, 1e-30f, 1.17549435e-38f,
+                                 123456.7f, 1e-40f, -0.00012f, 999999999.0f};
+  static const char *paths[] = {"inis/test_spaces.ini",
+                                "inis/test_multiple_sections.ini",
+                                "inis/test_keys_without_section.ini",
+                                "inis/test_many_keys.ini",
+                                "inis/test_many_empty_sections.ini"};
+  ini_options options = {0};
+  ini_file *ini, *loaded;
+  char text[256];
+  char *str;
+  char key[16];
+  size_t len, written, i;
+  int ok;
+  printf("test_save()...");
+
+  ini = ini_create();
+  assert(ini != NULL);
+  len = ini_save_mem(ini, text, sizeof(text));
+  assert(len == 0 && text[0] == '\0');
+  ok = ini_set_int(ini, "net", "port", 8080);
+  assert(ok);
+  ok = ini_set_string(ini, "net", "host", "localhost");
+  assert(ok);
+  ok = ini_set_float(ini, "audio", "volume", 0.1f);
+  assert(ok);
+  ok = ini_set_string(ini, "", "path", "/usr/share/x \"y\"");
+  assert(ok);
+  ok = ini_set_string(ini, "", "num", "42");
+  assert(ok);
+  ok = ini_set_string(ini, "", "empty", "");
+  assert(ok);
+  ok = ini_set_int(ini, "net", "port", -2147483647 - 1);
+  assert(ok);
+  ok = ini_set_float(ini, "audio", "gain", 2.0f);
+  assert(ok);
+  assert(ini_get_int(ini, "net", "port", 0) == -2147483647 - 1);
+  assert(ini_get_type_h(ini, ini_lookup(ini, "", "num")) == INI_KEY_STRING);
+
+  /* What can not be read back is refused */
+  ok = ini_set_string(ini, "net", "host", "two\nlines");
+  assert(!ok);
+  ok = ini_set_string(ini, "net", "host", "\"quoted\"");
+  assert(!ok);
+  ok = ini_set_string(ini, "net", "host", "a=\"b\"");
+  assert(!ok);
+  ok = ini_set_int(ini, "net", "a key", 1);
+  assert(!ok);
+  ok = ini_set_int(ini, "net", ";key", 1);
+  assert(!ok);
+  ok = ini_set_int(ini, "", "", 1);
+  assert(!ok);
+  ok = ini_set_int(ini, "[net]", "key", 1);
+  assert(!ok);
+  ok = ini_set_int(ini, "net;", "key", 1);
+  assert(!ok);
+  ok = ini_set_int(ini, "net", "key_name_longer_than_thirty_chars", 1);
+  assert(!ok);
+  assert(strcmp(ini_get_string(ini, "net", "host", ""), "localhost") == 0);
+
+  len = ini_save_mem(ini, NULL, 0);
+  written = ini_save_mem(ini, text, sizeof(text));
+  assert(written == len);
+  assert(strcmp(text, "[net]\nport = -2147483648\nhost = localhost\n\n"
+                      "[audio]\nvolume = 0.1\ngain = 2.0\n\n"
+                      "[]\npath = /usr/share/x \"y\"\nnum = \"42\"\n"
+                      "empty = \"\"\n") == 0);
+  written = ini_save_mem(ini, text, 10);
+  assert(written == len && strcmp(text, "[net]\npor") == 0);
+  loaded = ini_load_mem(text, ini_save_mem(ini, text, sizeof(text)));
+  assert(loaded != NULL && ini_files_equal(ini, loaded));
+  ini_free(loaded);
+  ini_free(ini);
+
+  /* Floats read back exactly with the fewest digits */
+  ini = ini_create();
+  for (i = 0; i < sizeof(floats) / sizeof(floats[0]); i++) {
+    sprintf(key, "f%d", (int)i);
+    ok = ini_set_float(ini, "f", key, floats[i]);
+    assert(ok);
+    assert(ini_get_float(ini, "f", key, 0.0f) == floats[i]);
+  }
+  len = ini_save_mem(ini, text, sizeof(text));
+  assert(strstr(text, "f0 = 0.1\n") && strstr(text, "f1 = 1.0\n"));
+  assert(strstr(text, "f4 = 100000.0\n") && strstr(text, "f9 = 123456.7\n"));
+  assert(strstr(text, "f10 = 1e-40\n") && strstr(text, "f11 = -0.00012\n"));
+  loaded = ini_load_mem(text, len);
+  assert(ini_files_equal(ini, loaded));
+  ini_free(loaded);
+  ini_free(ini);
+
+  /* An empty section without a name keeps its header */
+  ini = ini_load_mem("[]\n[a]\n", 8);
+  len = ini_save_mem(ini, text, sizeof(text));
+  assert(strcmp(text, "[]\n\n[a]\n") == 0);
+  loaded = ini_load_mem(text, len);
+  assert(loaded != NULL && ini_files_equal(ini, loaded));
+  ini_free(loaded);
+  ini_free(ini);
+
+  /* Loaded files are written back to the same contents */
+  for (i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+    ini = ini_load(paths[i]);
+    ok = ini_save(ini, "save.ini");
+    assert(ok);
+    loaded = ini_load("save.ini");
+    assert(loaded != NULL && ini_files_equal(ini, loaded));
+    ini_free(loaded);
+    ini_freeze(ini);
+    ok = ini_set_string(ini, "s1", "added", "x");
+    assert(ok);
+    ok = ini_set_int(ini, "new", "key", 1);
+    assert(ok);
+    assert(strcmp(ini_get_string(ini, "s1", "added", ""), "x") == 0);
+    assert(ini_get_int(ini, "new", "key", 0) == 1);
+    ini_free(ini);
+  }
+
+  /* Zero-copy and lazy files take new strings into their pool */
+  options.flags = INI_LOAD_ZERO_COPY | INI_LOAD_LAZY;
+  ini = ini_load_ex("inis/test_multiple_sections.ini", &options);
+  str = ini_get_string(ini, "s1", "test", "");
+  ok = ini_set_string(ini, "s4", "copy", str);
+  assert(ok);
+  for (i = 0; i < 100; i++) {
+    sprintf(key, "k%d", (int)i);
+    str = ini_get_string(ini, "s4", "copy", "");
+    ok = ini_set_string(ini, "s2", key, str);
+    assert(ok);
+  }
+  assert(strcmp(ini_get_string(ini, "s2", "k99", ""), "test") == 0);
+  assert(strcmp(ini_get_string(ini, "s4", "key", ""), "value") == 0);
+  assert(ini_get_int(ini, "s4", "key2", 0) == 42);
+  ok = ini_save(ini, "save.ini");
+  assert(ok);
+  loaded = ini_load("save.ini");
+  assert(ini_get_int(loaded, "s4", "key2", 0) == 42);
+  assert(strcmp(ini_get_string(loaded, "s2", "k50", ""), "test") == 0);
+  ini_free(loaded);
+  ini_free(ini);
+  remove("save.ini");
+
+  printf("SUCCESS\n");
+}
+
+void test_stack() {
+  const char *base_text = "[net]\nport = 80\nhost = base\n[log]\nlevel = 1\n";
+  const char *prod_text = "[net]\nport = 443\n[db]\nname = prod\n";
+  const char *local_text = "[net]\nhost = localhost\n";
+  ini_file *files[3];
+  ini_file *found, *many, *replaced;
+  ini_key_handle key;
+  ini_stack *stack;
+  ini_options options = {0};
+  char name[16];
+  int i, ok;
+  printf("test_stack()...");
+
+  options.flags = INI_LOAD_LAZY;
+  files[0] = ini_load_mem(base_text, strlen(base_text));
+  files[1] = ini_load_mem_ex(prod_text, strlen(prod_text), &options);
+  files[2] = NULL;
+  stack = ini_stack_create(files, 3);
+  assert(stack != NULL);
+  assert(ini_stack_get_int(stack, "net", "port", 0) == 443);
+  assert(strcmp(ini_stack_get_string(stack, "net", "host", ""), "base") == 0);
+  assert(ini_stack_get_int(stack, "log", "level", 0) == 1);
+  assert(strcmp(ini_stack_get_string(stack, "db", "name", ""), "prod") == 0);
+  assert(ini_stack_get_int(stack, "net", "missing", -1) == -1);
+  assert(ini_stack_get_int(stack, "missing", "port", -1) == -1);
+  assert(ini_stack_get_float(stack, "net", "port", 2.0f) == 2.0f);
+  key = ini_stack_lookup(stack, "net", "port", &found);
+  assert(key != NULL && found == files[1]);
+  key = ini_stack_lookup(stack, "net", "nope", &found);
+  assert(key == NULL && found == NULL);
+  /* Cached lookups give the same keys */
+  assert(ini_stack_lookup(stack, "net", "port", NULL) ==
+         ini_lookup(files[1], "net", "port"));
+  assert(ini_stack_lookup(stack, "net", "host", NULL) ==
+         ini_lookup(files[0], "net", "host"));
+
+  /* An overlay swapped in or given new keys overrides what was cached */
+  files[2] = ini_load_mem(local_text, strlen(local_text));
+  replaced = ini_stack_replace(stack, 2, files[2]);
+  assert(replaced == NULL);
+  assert(strcmp(ini_stack_get_string(stack, "net", "host", ""), "localhost") ==
+         0);
+  ok = ini_set_int(files[2], "log", "level", 3);
+  assert(ok);
+  assert(ini_stack_get_int(stack, "log", "level", 0) == 3);
+  replaced = ini_stack_replace(stack, 1, NULL);
+  assert(replaced == files[1]);
+  assert(ini_stack_get_int(stack, "net", "port", 0) == 80);
+  assert(!ini_stack_get_string(stack, "db", "name", NULL));
+  ini_free(files[1]);
+
+  /* The cache grows with the keys that are looked up */
+  many = ini_load("inis/test_many_keys.ini");
+  replaced = ini_stack_replace(stack, 1, many);
+  assert(replaced == NULL);
+  for (i = 0; i < (int)many->ptr_sections[0].num_keys; i++) {
+    sprintf(name, "key%d", i);
+    key = ini_stack_lookup(stack, "section0", name, &found);
+    assert(key == &many->ptr_sections[0].ptr_keys[i] && found == many);
+  }
+  assert(stack->num_cache > 100);
+  ini_freeze(many);
+  assert(ini_stack_lookup(stack, "section0", name, NULL) ==
+         &many->ptr_sections[0].ptr_keys[i - 1]);
+  ini_stack_free(stack);
+  ini_free(many);
+  ini_free(files[2]);
+  ini_free(files[0]);
+
+  stack = ini_stack_create(NULL, 0);
+  assert(ini_stack_get_int(stack, "", "x", 5) == 5);
+  ini_stack_free(stack);
+
+  printf("SUCCESS\n");
+}
+
+void test_reload() {
+  ini_file *ini, *ref, *failed;
+  ini_key *keys_b;
+  ini_index_entry *index;
+  static const char v1[] = "top = 1\n[a]\nx = 1\n[b]\ny = \"b\"\nz = 2\n"
+                           "  [c]\nw = 3.5\n[e]\nq = 9\n";
+  static const char v2[] = "top = 1\n[a]\nx = 2\n[b]\ny = \"b\"\nz = 2\n"
+                           "[d]\n[e]\nq = 9\n  [c]\nw = 3.5\n";
+  static const char v3[] = "top = 1\n[a]\nx = 2\n[b]\ny = \"b\"\nz = 2\n"
+                           "[d]\n[e]\nq = 9\n  [c]\nw = 3.5\n[a]\nx = 5\n";
+  static const char bad[] = "top = 1\n[a]\nx = 1\n[b]\ny = \"b\"\nz = 2\n"
+                            "[c\n";
+  char data[128];
+  char expected[16];
+  size_t max_pool = 0;
+  int i, len, kept = 0;
+  printf("test_reload()...");
+
+  ini = ini_reload_mem(NULL, v1, sizeof(v1) - 1);
+  ref = ini_load_mem(v1, sizeof(v1) - 1);
+  assert(ini != NULL && ref != NULL);
+  assert(ini_files_equal(ini, ref));
+  ini_free(ref);
+  keys_b = ini->ptr_sections[2].ptr_keys;
+
+  /* [a] changed, [d] is new and the rest moved around */
+  ini = ini_reload_mem(ini, v2, sizeof(v2) - 1);
+  ref = ini_load_mem(v2, sizeof(v2) - 1);
+  assert(ini != NULL && ref != NULL);
+  assert(ini_files_equal(ini, ref));
+  assert(ini->ptr_sections[2].ptr_keys == keys_b);
+  assert(ini_get_int(ini, "a", "x", -1) == 2);
+  assert(ini_get_int(ini, "b", "y", -1) == -1);
+  assert(ini_get_float(ini, "c", "w", -1.0f) == 3.5f);
+
+  /* A failed reload leaves the previous version alone */
+  failed = ini_reload_mem(ini, bad, sizeof(bad) - 1);
+  assert(failed == NULL);
+  assert(ini_files_equal(ini, ref));
+
+  /* A repeated header adds to the earlier section, also when reloading */
+  ini = ini_reload_mem(ini, v3, sizeof(v3) - 1);
+  assert(ini != NULL);
+  assert(ini_get_int(ini, "a", "x", -1) == 5);
+  assert(ini_num_sections(ini) == ini_num_sections(ref));
+  ini = ini_reload_mem(ini, v2, sizeof(v2) - 1);
+  assert(ini != NULL);
+  assert(ini_files_equal(ini, ref));
+  ini_free(ref);
+
+  /* Changing everything does not grow the pool forever */
+  for (i = 0; i < 100; i++) {
+    len = sprintf(data, "[a]\nx = \"%d\"\n[b]\ny = \"%d\"\n", i, i % 7);
+    ini = ini_reload_mem(ini, data, (size_t)len);
+    assert(ini != NULL);
+    sprintf(expected, "%d", i % 7);
+    assert(strcmp(ini_get_string(ini, "b", "y", ""), expected) == 0);
+    max_pool = (ini->size_pool > max_pool ? ini->size_pool : max_pool);
+  }
+  assert(max_pool < 128);
+  ini_free(ini);
+
+  /* While no section moves the key index is kept and only the keys of the
+   * edited section are replaced in it */
+  len = sprintf(data, "[a]\nk0 = 0\n[b]\ny = 1\n");
+  ini = ini_reload_mem(NULL, data, (size_t)len);
+  for (i = 1; i < 100; i++) {
+    index = ini->key_index;
+    len = sprintf(data, "[a]\nk%d = %d\n[b]\ny = 1\n", i, i);
+    ini = ini_reload_mem(ini, data, (size_t)len);
+    assert(ini != NULL && ini->num_key_index == 2);
+    kept += (ini->key_index == index);
+    sprintf(expected, "k%d", i);
+    assert(ini_get_int(ini, "a", expected, -1) == i);
+    sprintf(expected, "k%d", i - 1);
+    assert(ini_lookup(ini, "a", expected) == NULL);
+    assert(ini_get_int(ini, "b", "y", -1) == 1);
+  }
+  assert(kept > 50);
+  ini_free(ini);
+
+  /* Files that were not loaded by a reload are parsed in full */
+  ini = ini_load("inis/test_many_keys.ini");
+  assert(ini != NULL);
+  ini = ini_reload(ini, "inis/test_many_keys.ini");
+  assert(ini != NULL);
+  keys_b = ini->ptr_sections[3].ptr_keys;
+  ini = ini_reload(ini, "inis/test_many_keys.ini");
+  ref = ini_load("inis/test_many_keys.ini");
+  assert(ini != NULL && ref != NULL);
+  assert(ini->ptr_sections[3].ptr_keys == keys_b);
+  assert(ini_files_equal(ini, ref));
+  failed = ini_reload(ini, "inis/none.ini");
+  assert(failed == NULL);
+  ini_free(ini);
+  ini_free(ref);
+
+  printf("SUCCESS\n");
+}
+
+/* Checks that the fast classifier agrees with strtol and strtod */
+/* Text written back from the callbacks of a streaming parser */
+typedef struct stream_text {
+  char buf[16384];
+  size_t len;
+  int num_keys;
+} stream_text;
+
+int stream_section(void *user, const char *section) {
+  stream_text *text = (stream_text *)user;
+  text->len += sprintf(text->buf + text->len, "[%s]\n", section);
+  return 1;
+}
+
+int stream_key(void *user, const char *section, const char *key,
+               const char *value, int quoted) {
+  stream_text *text = (stream_text *)user;
+  text->len += sprintf(text->buf + text->len,
+                       quoted ? "%s=\"%s\"\n" : "%s=%s\n", key, value);
+  text->num_keys++;
+  return text->num_keys < 1000;
+}
+
+int stream_chunks(ini_parser *parser, const char *data, size_t len,
+                  size_t chunk) {
+  size_t i;
+  int ok = 1;
+  for (i = 0; i < len && ok; i += chunk) {
+    ok = ini_parser_feed(parser, data + i, len - i < chunk ? len - i : chunk);
+  }
+  return ini_parser_finish(parser) && ok;
+}
+
+void test_streaming() {
+  const char *good[] = {"inis/test_empty.ini",
+                        "inis/test_empty_section.ini",
+                        "inis/test_many_empty_sections.ini",
+                        "inis/test_keys_without_section.ini",
+                        "inis/test_multiple_sections.ini",
+                        "inis/test_large_section.ini",
+                        "inis/test_spaces.ini"};
+  char bad[] = "inis/test_bad_syntax_0.ini";
+  char data[16384];
+  const char *overlay = "a=1\r\n[s]\nb = \"x=[y]\"\n[s]\nb=2 ;c\n# [t]\nc=3";
+  stream_text text, whole;
+  ini_parser *parser;
+  ini_file *ini, *ref;
+  FILE *file;
+  size_t f, len, chunk;
+  int ok;
+  printf("test_streaming()...");
+
+  parser = ini_parser_create(stream_section, stream_key, &text);
+  assert(parser != NULL);
+
+  for (f = 0; f < sizeof(good) / sizeof(good[0]); f++) {
+    file = fopen(good[f], "rb");
+    assert(file != NULL);
+    len = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    ref = ini_load(good[f]);
+    assert(ref != NULL);
+
+    whole.len = 0;
+    whole.num_keys = 0;
+    parser->user = &whole;
+    ok = stream_chunks(parser, data, len, len + 1);
+    assert(ok);
+    whole.buf[whole.len] = '\0';
+    ini = ini_load_mem(whole.buf, whole.len);
+    assert(ini != NULL && ini_files_equal(ini, ref));
+    ini_free(ini);
+    ini_free(ref);
+
+    /* Every split gives the same sections and keys */
+    parser->user = &text;
+    for (chunk = 1; chunk < 64 && chunk < len; chunk++) {
+      text.len = 0;
+      text.num_keys = 0;
+      ok = stream_chunks(parser, data, len, chunk);
+      assert(ok);
+      assert(text.len == whole.len &&
+             memcmp(text.buf, whole.buf, text.len) == 0);
+    }
+  }
+
+  /* Keys before the first header, repeated sections and keys, CRLF */
+  len = strlen(overlay);
+  for (chunk = 1; chunk <= len; chunk++) {
+    text.len = 0;
+    text.num_keys = 0;
+    ok = stream_chunks(parser, overlay, len, chunk);
+    assert(ok);
+    text.buf[text.len] = '\0';
+    assert(strcmp(text.buf, "[]\na=1\n[s]\nb=\"x=[y]\"\n[s]\nb=2 ;c\nc=3\n") ==
+           0);
+  }
+  ini = ini_load_mem(overlay, len);
+  ref = ini_load_mem(text.buf, text.len);
+  assert(ini != NULL && ref != NULL && ini_files_equal(ini, ref));
+  ini_free(ini);
+  ini_free(ref);
+
+  /* Errors, the parser is reset for the next text */
+  for (f = 1; f <= 8; f++) {
+    bad[21] = (char)('0' + f);
+    file = fopen(bad, "rb");
+    assert(file != NULL);
+    len = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    ok = stream_chunks(parser, data, len, 1);
+    assert(!ok);
+    ok = stream_chunks(parser, data, len, len);
+    assert(!ok);
+  }
+  file = fopen("inis/test_long_key_name.ini", "rb");
+  len = fread(data, 1, sizeof(data), file);
+  fclose(file);
+  ok = stream_chunks(parser, data, len, 7);
+  assert(!ok);
+  ok = ini_parser_feed(parser, data, len);
+  assert(!ok);
+  ok = ini_parser_feed(parser, "", 0);
+  assert(!ok);
+  ok = ini_parser_finish(parser);
+  assert(!ok);
+  ok = stream_chunks(parser, "k=v", 3, 1);
+  assert(ok);
+
+  /* A callback stops the parser */
+  text.num_keys = 0;
+  file = fopen("inis/test_many_keys.ini", "rb");
+  len = fread(data, 1, sizeof(data), file);
+  fclose(file);
+  text.len = 0;
+  text.num_keys = 990;
+  ok = stream_chunks(parser, data, len, 100);
+  assert(!ok);
+  assert(text.num_keys == 1000);
+
+  ini_parser_free(parser);
+
+  printf("SUCCESS\n");
+}
+
+void check_classify(const char *str) {
+  ini_int64 int_fast = 0, int_slow = 0;
+  double float_fast = 0.0, float_slow = 0.0;
+  ini_key_type fast, slow;
+  fast = __ini_classify(str, &int_fast, &float_fast);
+  slow = __ini_classify_slow(str, &int_slow, &float_slow);
+  if (fast != slow || (fast == INI_KEY_INT && int_fast != int_slow) ||
+      (fast == INI_KEY_FLOAT && float_fast != float_slow &&
+       float_slow == float_slow)) {
+    printf("\n\"%s\" classified differently\n", str);
+    assert(0);
+  }
+}
+
+void test_classify() {
+  static const char *values[] = {
+      "0", "-0", "+0", "7", "-42", "+42", "010", "-010", "08", "0009", "019.5",
+      "0x", "0x1A", "-0X1a", "0xg", "0x1.8p3", "0x.8", "0x7fffffff",
+      "0xffffffffffffffffffff", "2147483648", "-2147483649",
+      "9223372036854775807", "9223372036854775808", "-9223372036854775808",
+      "-9223372036854775809", "99999999999999999999999",
+      "07777777777777777777777777",
+      "1.", ".5", "-.5", ".", "-.", "+", "-", "", "1e", "1e+", "1e-5", "1E5",
+      "1e5x", "2.5e-3", "1.7976931348623157e308", "1e309", "4.9e-324",
+      "1e-400", "123456789012345", "1234567890123456", "0.1", "0.000001",
+      "3.14159265358979323846", "1e22", "1e23", "12345e-22", "inf", "-inf",
+      "Infinity", "info", "nan", "NaN", "nan(123)", "nano", "5 ", " 5", "5\r",
+      "\t5", "1.2.3", "192.168.0.1", "1,5", "true", "abc", "e5", "--5",
+      "+-5", "5-", "1_000", "0b101", "00", "0.0e0", "-0.0"};
+  char buf[64];
+  size_t i;
+  int n;
+  printf("test_classify()...");
+  for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    check_classify(values[i]);
+  }
+  srand(1);
+  for (n = 0; n < 100000; n++) {
+    /* Random strings made of characters that appear in numbers */
+    static const char chars[] = "0123456789012345678901234567.eE+-xX";
+    int len = 1 + rand() % 20;
+    for (i = 0; i < (size_t)len; i++) {
+      buf[i] = chars[rand() % (sizeof(chars) - 1)];
+    }
+    buf[len] = '\0';
+    check_classify(buf);
+    sprintf(buf, "%.*fe%d", rand() % 17, (double)rand() / RAND_MAX * 1000.0,
+            rand() % 60 - 30);
+    check_classify(buf);
+  }
+  printf("SUCCESS\n");
+}
+
+void test_wide_values() {
+  static const char text[] = "[sizes]\n"
+                             "small = 2147483647\n"
+                             "bytes = 17179869184\n"
+                             "negative = -2147483649\n"
+                             "max = 0x7fffffffffffffff\n"
+                             "clamped = -99999999999999999999\n"
+                             "[times]\n"
+                             "ratio = 0.1\n"
+                             "precise = 0.123456789012345\n"
+                             "huge = 1e300\n"
+                             "tiny = -1e-300\n"
+                             "infinite = inf\n"
+                             "[limits]\n"
+                             "max = 3.4028235e38\n"
+                             "exact = 3.40282347e+38\n"
+                             "min = -3.40282347e+38\n"
+                             "over = 3.5e38\n"
+                             "beyond = 1e400\n"
+                             "under = 1e-46\n";
+  ini_int64 big = (ini_int64)17179869184.0;
+  ini_int64 max = (ini_int64)(~(ini_uint64)0 >> 1);
+  ini_int64 wide = 0, small = 0;
+  double precise = 0.0;
+  ini_batch_key keys[] = {{"sizes", "bytes", INI_KEY_INT64, NULL},
+                          {NULL, "small", INI_KEY_INT64, NULL},
+                          {"times", "huge", INI_KEY_FLOAT, NULL},
+                          {NULL, "precise", INI_KEY_DOUBLE, NULL}};
+  ini_options options = {0};
+  ini_file *ini, *saved;
+  float narrow = 2.5f;
+  char buf[512];
+  size_t n;
+  int pass, ok;
+  printf("test_wide_values()...");
+
+  keys[0].out = &wide;
+  keys[1].out = &small;
+  keys[2].out = &narrow;
+  keys[3].out = &precise;
+  for (pass = 0; pass < 2; pass++) {
+    options.flags = (pass == 0 ? 0 : INI_LOAD_LAZY);
+    ini = ini_load_mem_ex(text, sizeof(text) - 1, &options);
+    assert(ini != NULL);
+
+    /* Integers get the wide type only if they do not fit into an int */
+    assert(ini_get_type_h(ini, ini_lookup(ini, "sizes", "small")) ==
+           INI_KEY_INT);
+    assert(ini_get_type_h(ini, ini_lookup(ini, "sizes", "bytes")) ==
+           INI_KEY_INT64);
+    assert(ini_get_int(ini, "sizes", "small", 0) == 2147483647);
+    assert(ini_get_int(ini, "sizes", "bytes", -1) == -1);
+    assert(ini_get_int64(ini, "sizes", "small", 0) == 2147483647);
+    assert(ini_get_int64(ini, "sizes", "bytes", 0) == big);
+    assert(ini_get_int64(ini, "sizes", "negative", 0) ==
+           -(ini_int64)2147483649.0);
+    assert(ini_get_int64(ini, "sizes", "max", 0) == max);
+    assert(ini_get_int64(ini, "sizes", "clamped", 0) == -max - 1);
+    assert(ini_get_int64(ini, "times", "ratio", 7) == 7);
+
+    /* Floating point numbers keep their double precision */
+    assert(ini_get_type_h(ini, ini_lookup(ini, "times", "ratio")) ==
+           INI_KEY_FLOAT);
+    assert(ini_get_type_h(ini, ini_lookup(ini, "times", "huge")) ==
+           INI_KEY_DOUBLE);
+    assert(ini_get_type_h(ini, ini_lookup(ini, "times", "infinite")) ==
+           INI_KEY_FLOAT);
+    assert(ini_get_float(ini, "times", "ratio", 0.0f) == 0.1f);
+    assert(ini_get_double(ini, "times", "ratio", 0.0) == 0.1);
+    assert(ini_get_double(ini, "times", "precise", 0.0) ==
+           0.123456789012345);
+    assert(ini_get_float(ini, "times", "huge", 1.0f) == 1.0f);
+    assert(ini_get_double(ini, "times", "huge", 0.0) == 1e300);
+    assert(ini_get_double(ini, "times", "tiny", 0.0) == -1e-300);
+    assert(ini_get_double(ini, "sizes", "small", 0.5) == 0.5);
+    assert(ini_get_double_h(ini, NULL, 0.5) == 0.5);
+    assert(ini_get_int64_h(ini, NULL, 5) == 5);
+
+    /* Numbers that round to FLT_MAX are floats, larger finite ones are not */
+    assert(ini_get_float(ini, "limits", "max", 0.0f) == FLT_MAX);
+    assert(ini_get_float(ini, "limits", "exact", 0.0f) == FLT_MAX);
+    assert(ini_get_float(ini, "limits", "min", 0.0f) == -FLT_MAX);
+    assert(ini_get_type_h(ini, ini_lookup(ini, "limits", "over")) ==
+           INI_KEY_DOUBLE);
+    assert(ini_get_float(ini, "limits", "over", 1.0f) == 1.0f);
+    assert(ini_get_double(ini, "limits", "over", 0.0) == 3.5e38);
+    assert(ini_get_type_h(ini, ini_lookup(ini, "limits", "beyond")) ==
+           INI_KEY_FLOAT);
+    assert(ini_get_float(ini, "limits", "beyond", 0.0f) > FLT_MAX);
+    assert(ini_get_float(ini, "limits", "under", 1.0f) == 0.0f);
+    assert(ini_get_double(ini, "limits", "under", 0.0) == 1e-46);
+
+    /* The wide types of a batch also take the narrow values */
+    wide = 0;
+    small = 0;
+    n = ini_get_batch(ini, keys, 4);
+    assert(n == 3);
+    assert(wide == ini_get_int64(ini, "sizes", "bytes", 0));
+    assert(small == 2147483647 && narrow == 2.5f);
+    assert(precise == 0.123456789012345);
+
+    /* Saved values load back at full width */
+    n = ini_save_mem(ini, buf, sizeof(buf));
+    assert(n < sizeof(buf));
+    saved = ini_load_mem(buf, strlen(buf));
+    assert(saved != NULL && ini_files_equal(saved, ini));
+    ini_free(saved);
+    ini_free(ini);
+  }
+
+  ini = ini_create();
+  ok = ini_set_int64(ini, "s", "a", max) && ini_set_int64(ini, "s", "b", 3);
+  assert(ok);
+  ok = ini_set_double(ini, "s", "c", 1e-310) &&
+       ini_set_double(ini, "s", "d", 0.3);
+  assert(ok);
+  ok = ini_set_float(ini, "s", "e", 0.1f);
+  assert(ok);
+  ok = ini_set_float(ini, "s", "f", FLT_MAX) &&
+       ini_set_float(ini, "s", "g", -FLT_MAX);
+  assert(ok);
+  assert(ini_get_type_h(ini, ini_lookup(ini, "s", "a")) == INI_KEY_INT64);
+  assert(ini_get_type_h(ini, ini_lookup(ini, "s", "b")) == INI_KEY_INT);
+  assert(ini_get_type_h(ini, ini_lookup(ini, "s", "c")) == INI_KEY_FLOAT);
+  assert(ini_get_float(ini, "s", "f", 0.0f) == FLT_MAX);
+  assert(ini_get_float(ini, "s", "g", 0.0f) == -FLT_MAX);
+  assert(ini_get_int64(ini, "s", "a", 0) == max);
+  assert(ini_get_double(ini, "s", "c", 0.0) == 1e-310);
+  assert(ini_get_double(ini, "s", "d", 0.0) == 0.3);
+  /* A float is kept as the decimal it is written as */
+  assert(ini_get_double(ini, "s", "e", 0.0) == 0.1);
+  ini_save_mem(ini, buf, sizeof(buf));
+  saved = ini_load_mem(buf, strlen(buf));
+  assert(saved != NULL);
+  assert(ini_get_float(saved, "s", "f", 0.0f) == FLT_MAX);
+  assert(ini_get_float(saved, "s", "g", 0.0f) == -FLT_MAX);
+  ini_free(saved);
+  assert(strcmp(buf, "[s]\na = 9223372036854775807\nb = 3\nc = 1e-310\n"
+                     "d = 0.3\ne = 0.1\nf = 3.4028235e+38\n"
+                     "g = -3.4028235e+38\n") == 0);
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+#ifdef INILOAD_POSIX
+/* Reads a live file until told to stop, every version has a == b */
+void *live_reader(void *arg) {
+  ini_live *live = (ini_live *)arg;
+  ini_file *ini;
+  size_t slot;
+  int a, b;
+  for (;;) {
+    ini = ini_live_acquire(live, &slot);
+    a = ini_get_int(ini, "version", "a", -1);
+    b = ini_get_int(ini, "version", "b", -2);
+    assert(a == b);
+    ini_live_release(live, slot);
+    if (a < 0) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+void test_live() {
+  ini_live *live;
+  ini_file *ini;
+  ini_options options = {0};
+  pthread_t threads[4];
+  char data[64];
+  size_t slot;
+  int i, t, len, ok;
+  printf("test_live()...");
+
+  live = ini_live_create("inis/none.ini", NULL);
+  assert(live == NULL);
+  options.flags = INI_LOAD_LAZY;
+  live = ini_live_create("inis/test_multiple_sections.ini", &options);
+  assert(live != NULL);
+  ini = ini_live_acquire(live, &slot);
+  assert(ini_get_int(ini, "s4", "key2", -1) == 42);
+  ini_live_release(live, slot);
+  ok = ini_live_reload(live);
+  assert(ok);
+  ini = ini_live_acquire(live, &slot);
+  assert(strcmp(ini_get_string(ini, "s1", "test", "wrong"), "test") == 0);
+  ini_live_release(live, slot);
+
+  for (i = 0; i < 2000; i++) {
+    if (i == 1) {
+      for (t = 0; t < 4; t++) {
+        ok = pthread_create(&threads[t], NULL, live_reader, live);
+        assert(ok == 0);
+      }
+    }
+    /* The last version tells the readers to stop */
+    len = sprintf(data, "[version]\na = %d\nb = %d\n", i < 1999 ? i : -1,
+                  i < 1999 ? i : -1);
+    ini = ini_load_mem_ex(data, (size_t)len, &options);
+    assert(ini != NULL);
+    ini_live_publish(live, ini);
+  }
+  for (t = 0; t < 4; t++) {
+    pthread_join(threads[t], NULL);
+  }
+  ini_live_free(live);
+
+  printf("SUCCESS\n");
+}
+
+void test_load_fd() {
+  ini_file *ini;
+  int fd;
+  printf("test_load_fd()...");
+
+  fd = open("inis/test_many_keys.ini", O_RDONLY);
+  assert(fd >= 0);
+  ini = ini_load_fd(fd);
+  close(fd);
+  assert(ini != NULL);
+  assert(ini_num_sections(ini) == 4);
+  assert(ini_get_int(ini, "section1", "key249", -1) == 1249);
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+void test_mmap() {
+  ini_file *ini;
+  ini_options options = {0};
+  printf("test_mmap()...");
+
+  options.flags = INI_LOAD_MMAP | INI_LOAD_ZERO_COPY;
+  ini = ini_load_ex("inis/test_many_keys.ini", &options);
+  assert(ini != NULL);
+  assert(ini_num_sections(ini) == 4);
+  assert(ini_get_int(ini, "section3", "key0", -1) == 3000);
+  ini_free(ini);
+
+  ini = ini_load_ex("inis/test_empty.ini", &options);
+  assert(ini != NULL);
+  assert(ini_num_sections(ini) == 0);
+  ini_free(ini);
+
+  ini = ini_load_ex("inis/test_bad_syntax_8.ini", &options);
+  assert(ini == NULL);
+
+  ini = ini_load_ex("inis/does_not_exist.ini", &options);
+  assert(ini == NULL);
+
+  printf("SUCCESS\n");
+}
+
+void test_shared() {
+  ini_file *ini, *ref, *old;
+  ini_shared *shared;
+  char name[64];
+  int i, n, status;
+  pid_t pid, done;
+  printf("test_shared()...");
+
+  sprintf(name, "/iniload_test_%lu", (unsigned long)getpid());
+  ini = ini_attach(name);
+  assert(ini == NULL);
+  ref = ini_load("inis/test_many_keys.ini");
+  shared = ini_share(ref, name);
+  assert(shared != NULL);
+
+  /* Another process reads the segment in place */
+  pid = fork();
+  if (pid == 0) {
+    ini = ini_attach(name);
+    _exit(ini != NULL && ini->image != NULL && ini_files_equal(ini, ref) ? 0
+                                                                          : 1);
+  }
+  assert(pid > 0);
+  done = waitpid(pid, &status, 0);
+  assert(done == pid);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  /* Processes that attached keep the previous segment */
+  old = ini_attach(name);
+  assert(old != NULL && ini_files_equal(old, ref));
+  ini_free(ref);
+  ref = ini_load("inis/test_multiple_sections.ini");
+  ini_unshare(shared);
+  ini = ini_attach(name);
+  assert(ini == NULL);
+  shared = ini_share(ref, name);
+  assert(shared != NULL);
+  ini = ini_attach(name);
+  assert(ini != NULL && ini_files_equal(ini, ref));
+  assert(ini_get_int(ini, "s4", "key2", 0) == 42);
+  assert(ini_get_int(old, "section0", "key3", 0) == 3);
+  ini_free(ini);
+  ini_free(old);
+
+  /* Processes sharing under the same name at once all succeed */
+  for (i = 0; i < 4; i++) {
+    if (fork() == 0) {
+      for (n = 0; n < 50 && ini_share(ref, name) != NULL; n++) {
+      }
+      _exit(n == 50 ? 0 : 1);
+    }
+  }
+  for (i = 0; i < 4; i++) {
+    done = wait(&status);
+    assert(done > 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  ini = ini_attach(name);
+  assert(ini != NULL && ini_files_equal(ini, ref));
+  ini_free(ini);
+  ini_free(ref);
+  ini_unshare(shared);
+
+  printf("SUCCESS\n");
+}
+
+void write_file(const char *path, const char *data, size_t len) {
+  FILE *file = fopen(path, "wb");
+  size_t written;
+  assert(file != NULL);
+  written = fwrite(data, 1, len, file);
+  assert(written == len);
+  fclose(file);
+}
+
+void test_snapshot() {
+  ini_file *ini, *ref;
+  ini_options options = {0};
+  const char *text = "[a]\nx = 1\ny = \"one\"\n[b]\nz = 1.5\n";
+  char data[16384];
+  char bad[16384];
+  ini_image hdr;
+  ini_key key;
+  ini_index_entry entry;
+  FILE *file;
+  size_t len, off;
+  int i, ok;
+  printf("test_snapshot()...");
+
+  remove("snapshot.bin");
+  file = fopen("inis/test_many_keys.ini", "rb");
+  len = fread(data, 1, sizeof(data), file);
+  fclose(file);
+  write_file("snapshot.ini", data, len);
+  ref = ini_load("snapshot.ini");
+
+  /* The first load parses the file and saves the snapshot */
+  ini = ini_load_snapshot("snapshot.ini", "snapshot.bin");
+  assert(ini != NULL && ini->image == NULL && ini_files_equal(ini, ref));
+  ini_free(ini);
+  ini = ini_load_snapshot("snapshot.ini", "snapshot.bin");
+  assert(ini != NULL && ini->image != NULL && ini_files_equal(ini, ref));
+  assert(ini_get_int_h(ini, ini_lookup(ini, "section0", "key3"), 0) == 3);
+  assert(!ini_has_key(ini, "s1", "none") && !ini_has_section(ini, "none"));
+  ini = ini_reload(ini, "snapshot.ini");
+  assert(ini != NULL && ini->image == NULL && ini_files_equal(ini, ref));
+  ok = ini_freeze(ini);
+  assert(ok);
+  ok = ini_save_snapshot(ini, "snapshot.ini", "snapshot.bin");
+  assert(ok);
+  ini_free(ini);
+  ini = ini_load_snapshot("snapshot.ini", "snapshot.bin");
+  assert(ini != NULL && ini->image != NULL && ini_files_equal(ini, ref));
+  ok = ini_freeze(ini);
+  assert(ok && ini->frozen == NULL);
+  ini_free(ini);
+  ini_free(ref);
+
+  /* A change of the text is noticed even when the size stays the same */
+  len = strlen(text);
+  write_file("snapshot.ini", text, len);
+  ref = ini_load("snapshot.ini");
+  ok = ini_save_snapshot(ref, "snapshot.ini", "snapshot.bin");
+  assert(ok);
+  ini_free(ref);
+  write_file("snapshot.ini", "[a]\nx = 2\ny = \"one\"\n[b]\nz = 1.5\n", len);
+  ini = ini_load_snapshot("snapshot.ini", "snapshot.bin");
+  assert(ini != NULL && ini->image == NULL);
+  assert(ini_get_int(ini, "a", "x", 0) == 2);
+  ini_free(ini);
+  ini = ini_load_snapshot("snapshot.ini", "snapshot.bin");
+  assert(ini != NULL && ini->image != NULL);
+  assert(ini_get_int(ini, "a", "x", 0) == 2);
+  ini_free(ini);
+
+  /* Lazy keys are converted, truncated snapshots are not used */
+  write_file("snapshot.ini", text, len);
+  options.flags = INI_LOAD_LAZY | INI_LOAD_ARENA;
+  ini = ini_load_ex("snapshot.ini", &options);
+  ok = ini_save_snapshot(ini, "snapshot.ini", "snapshot.bin");
+  assert(ok);
+  ini_free(ini);
+  ref = ini_load("snapshot.ini");
+  ini = ini_load_snapshot("snapshot.ini", "snapshot.bin");
+  assert(ini != NULL && ini->image != NULL && ini_files_equal(ini, ref));
+  assert(strcmp(ini_get_string(ini, "a", "y", ""), "one") == 0);
+  ini_free(ini);
+  file = fopen("snapshot.bin", "rb");
+  len = fread(data, 1, sizeof(data), file);
+  fclose(file);
+  write_file("snapshot.bin", data, len / 2);
+  ini = ini_load_snapshot("snapshot.ini", "snapshot.bin");
+  assert(ini != NULL && ini->image == NULL && ini_files_equal(ini, ref));
+  ini_free(ini);
+
+  /* Nor are snapshots whose offsets or positions point outside of them */
+  memcpy(&hdr, data, sizeof(ini_image));
+  for (i = 0; i < 5; i++) {
+    memcpy(bad, data, len);
+    /* y = "one" is the second key, the first entries are taken from the
+     * first used slots */
+    off = hdr.keys_off + sizeof(ini_key) * (i == 0 ? 1 : 0);
+    memcpy(&key, bad + off, sizeof(ini_key));
+    if (i == 0) {
+      assert(key.type == INI_KEY_STRING);
+      key.value.string_off = 100000000;
+    } else if (i == 1) {
+      key.name_len = hdr.size_pool + 1;
+    }
+    memcpy(bad + off, &key, sizeof(ini_key));
+    off = (i == 2 ? hdr.key_index_off : hdr.section_index_off);
+    do {
+      memcpy(&entry, bad + off, sizeof(ini_index_entry));
+      off += sizeof(ini_index_entry);
+    } while (entry.section == 0);
+    off -= sizeof(ini_index_entry);
+    if (i == 2) {
+      entry.key = 1000;
+    } else if (i == 3) {
+      entry.section = hdr.num_sections + 1;
+    }
+    memcpy(bad + off, &entry, sizeof(ini_index_entry));
+    if (i == 4) {
+      /* No free slot to end a lookup at */
+      hdr.num_section_index = hdr.cap_section_index;
+      memcpy(bad, &hdr, sizeof(ini_image));
+      memcpy(&hdr, data, sizeof(ini_image));
+    }
+    write_file("snapshot.bin", bad, len);
+    ini = ini_load_snapshot("snapshot.ini", "snapshot.bin");
+    assert(ini != NULL && ini->image == NULL && ini_files_equal(ini, ref));
+    assert(strcmp(ini_get_string(ini, "a", "y", ""), "one") == 0);
+    ini_free(ini);
+  }
+  ini_free(ref);
+
+  write_file("snapshot.ini", "", 0);
+  ini = ini_load_snapshot("snapshot.ini", "snapshot.bin");
+  assert(ini != NULL && ini_num_sections(ini) == 0);
+  ini_free(ini);
+  ini = ini_load_snapshot("snapshot.ini", "snapshot.bin");
+  assert(ini != NULL && ini->image != NULL && ini_num_sections(ini) == 0);
+  ini_free(ini);
+
+  remove("snapshot.ini");
+  ini = ini_load_snapshot("snapshot.ini", "snapshot.bin");
+  assert(ini == NULL);
+  remove("snapshot.bin");
+
+  printf("SUCCESS\n");
+}
+
+/* Counts the files of an asynchronous load, called on the workers */
+void async_loaded(void *user, size_t index, ini_file *ini) {
+  volatile long *loaded = (volatile long *)user;
+  __ini_atomic_add(&loaded[index], ini != NULL ? 1 : 100);
+}
+
+void test_async() {
+  const char *paths[] = {"inis/test_spaces.ini",
+                         "inis/test_multiple_sections.ini",
+                         "inis/test_missing.ini",
+                         "inis/test_many_keys.ini",
+                         "inis/test_keys_without_section.ini",
+                         "inis/test_bad_syntax_1.ini",
+                         "inis/test_large_section.ini",
+                         "inis/test_empty.ini"};
+  volatile long loaded[8] = {0};
+  ini_options options = {0};
+  ini_async *async;
+  ini_file *ini, *ref;
+  char c;
+  size_t i;
+  ssize_t n;
+  printf("test_async()...");
+
+  options.num_threads = 3;
+  async = ini_load_async(paths, 8, &options, async_loaded, (void *)loaded);
+  assert(async != NULL);
+  /* The descriptor becomes readable once everything is loaded */
+  n = read(ini_async_fd(async), &c, 1);
+  assert(n == 1 && ini_async_done(async));
+  for (i = 0; i < 8; i++) {
+    ini = ini_async_result(async, i);
+    ref = ini_load(paths[i]);
+    assert((ini == NULL) == (ref == NULL));
+    assert(loaded[i] == (ini != NULL ? 1 : 100));
+    if (ini != NULL) {
+      assert(ini_files_equal(ini, ref));
+      ini_free(ini);
+      ini_free(ref);
+    }
+  }
+  assert(ini_async_result(async, 8) == NULL);
+  ini_async_free(async);
+
+  /* Without a callback and with more threads than files */
+  options.num_threads = 16;
+  options.flags = INI_LOAD_LAZY | INI_LOAD_MMAP;
+  async = ini_load_async(paths, 2, &options, NULL, NULL);
+  ini_async_wait(async);
+  assert(ini_async_done(async));
+  assert(ini_get_int(ini_async_result(async, 1), "s4", "key2", 0) == 42);
+  ini_free(ini_async_result(async, 0));
+  ini_free(ini_async_result(async, 1));
+  ini_async_free(async);
+
+  async = ini_load_async(paths, 0, NULL, NULL, NULL);
+  assert(ini_async_done(async));
+  n = read(ini_async_fd(async), &c, 1);
+  assert(n == 1);
+  ini_async_free(async);
+  options.arena_buf = &c;
+  async = ini_load_async(paths, 1, &options, NULL, NULL);
+  assert(async == NULL);
+
+  printf("SUCCESS\n");
+}
+#endif
+
 void test_long_section_name() {
   ini_file *ini;
   printf("test_long_section_name()...");
@@ -172,7 +1972,36 @@ int main(int argc, char *argv[]) {
   test_keys_without_section();
   test_multiple_sections();
   test_large_section();
+  test_duplicates();
+  test_many_keys();
   test_spaces();
+  test_arena();
+  test_zero_copy();
+  test_load_mem();
+  test_long_values();
+  test_parallel();
+  test_classify();
+  test_wide_values();
+  test_lazy();
+  test_handles();
+  test_filter();
+  test_iterate();
+  test_batch();
+  test_stats();
+  test_freeze();
+  test_presize();
+  test_save();
+  test_stack();
+  test_reload();
+  test_streaming();
+#ifdef INILOAD_POSIX
+  test_load_fd();
+  test_mmap();
+  test_live();
+  test_snapshot();
+  test_shared();
+  test_async();
+#endif
   test_long_section_name();
   test_long_key_name();
   test_bad_syntax();
@@ -0,0 +1,114 @@
+#define INILOAD_IMPLEMENTATION
+#include "iniload.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+struct config {
+  int key2;
+  const char *key;
+  const char *test;
+  float missing;
+  int wrong_type;
+};
+
+void test_schema() {
+  constexpr auto schema = iniload::make_schema(
+      iniload::key("s4", "key2", &config::key2, -1),
+      iniload::key("s4", "key", &config::key, "none"),
+      iniload::key("s1", "test", &config::test, "none"),
+      iniload::key("s1", "missing", &config::missing, 0.5f),
+      iniload::key("s1", "test", &config::wrong_type, 3));
+  /* The hashes are constants */
+  static_assert(iniload::key_hash("s4", "key2") ==
+                    iniload::hash("key2", iniload::hash("s4]")),
+                "key hashes continue the section hash");
+  config cfg;
+  ini_file *ini;
+  printf("test_schema()...");
+
+  assert(iniload::key_hash("s4", "key2") ==
+         __ini_hash_key(__ini_hash(INILOAD_HASH_SEED, "s4"), "key2"));
+  ini = ini_load("inis/test_multiple_sections.ini");
+  assert(ini != NULL);
+  auto report = schema.bind(ini, cfg);
+  assert(report.num_found == 3);
+  assert(cfg.key2 == 42 && strcmp(cfg.key, "value") == 0);
+  assert(strcmp(cfg.test, "test") == 0);
+  assert(cfg.missing == 0.5f && cfg.wrong_type == 3);
+  assert(!report.ok() && report.num_mismatches == 1);
+  assert(strcmp(report.mismatches[0].key_name, "test") == 0);
+  assert(report.mismatches[0].expected == INI_KEY_INT &&
+         report.mismatches[0].found == INI_KEY_STRING);
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+void test_schema_lazy() {
+  constexpr auto schema = iniload::make_schema(
+      iniload::key("", "key1", &config::key2, -1),
+      iniload::key("", "key2", &config::key, "none"),
+      iniload::key("", "key", &config::missing, 0.5f),
+      iniload::key("", "key", &config::wrong_type, 3));
+  ini_options options = {0};
+  config cfg;
+  ini_file *ini;
+  printf("test_schema_lazy()...");
+
+  options.flags = INI_LOAD_LAZY;
+  ini = ini_load_ex("inis/test_keys_without_section.ini", &options);
+  assert(ini != NULL);
+  auto report = schema.bind(ini, cfg);
+  assert(report.num_found == 3 && report.num_mismatches == 1);
+  assert(cfg.key2 == 1 && strcmp(cfg.key, "no section") == 0);
+  assert(cfg.missing == 0.5f && cfg.wrong_type == -1);
+  assert(report.mismatches[0].found == INI_KEY_INT);
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+struct limits {
+  ini_int64 bytes;
+  ini_int64 count;
+  double ratio;
+  double huge;
+  float narrow;
+};
+
+void test_schema_wide() {
+  constexpr auto schema = iniload::make_schema(
+      iniload::key("", "bytes", &limits::bytes, ini_int64(-1)),
+      iniload::key("", "count", &limits::count, ini_int64(-1)),
+      iniload::key("", "ratio", &limits::ratio, -1.0),
+      iniload::key("", "huge", &limits::huge, -1.0),
+      iniload::key("", "huge", &limits::narrow, -1.0f));
+  const char text[] = "bytes = 1099511627776\ncount = 3\nratio = 0.1\n"
+                      "huge = 1e100\n";
+  limits cfg;
+  ini_file *ini;
+  printf("test_schema_wide()...");
+
+  ini = ini_load_mem(text, sizeof(text) - 1);
+  assert(ini != NULL);
+  auto report = schema.bind(ini, cfg);
+  /* Wide members take the values of the narrow types */
+  assert(report.num_found == 4 && report.num_mismatches == 1);
+  assert(cfg.bytes == ini_int64(1) << 40 && cfg.count == 3);
+  assert(cfg.ratio == 0.1 && cfg.huge == 1e100 && cfg.narrow == -1.0f);
+  assert(report.mismatches[0].expected == INI_KEY_FLOAT &&
+         report.mismatches[0].found == INI_KEY_DOUBLE);
+  ini_free(ini);
+
+  printf("SUCCESS\n");
+}
+
+int main() {
+  test_schema();
+  test_schema_lazy();
+  test_schema_wide();
+
+  return 0;
+}